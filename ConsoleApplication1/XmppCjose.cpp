@@ -109,15 +109,28 @@ bool CXmppCjose::DecryptCiphertext(std::string ciphertext, std::string key, std:
 		m_jweContent = cjose_jwe_import(cstrJweContent, strlen(cstrJweContent), &err);
 	}
 
-	// decrypt the imported jwe
-	uint8_t *cstrContent = NULL;
+	// decrypt the imported jwe straight into the return value
 	size_t cstrContentLen = 0;
-	cstrContent = cjose_jwe_decrypt(m_jweContent, m_jwkContentKey, &cstrContentLen, &err);
+	if (cjose_jwe_decrypt_into(m_jweContent, NULL, NULL, 0, &cstrContentLen, &err))
+	{
+		// empty content must still be decrypted (and authenticated), so it
+		// needs a buffer too
+		uint8_t none = 0;
+		plaintext.resize(cstrContentLen);
+		if (cjose_jwe_decrypt_into(m_jweContent, m_jwkContentKey,
+				plaintext.empty() ? &none : (uint8_t*)&plaintext[0], plaintext.size(), &cstrContentLen, &err))
+		{
+			plaintext.resize(cstrContentLen);
+		}
+		else
+		{
+			plaintext.clear();
+		}
+	}
 
 	// set return value
 	if (CJOSE_ERR_NONE == err.code)
 	{
-		plaintext = std::string((char*)cstrContent, cstrContentLen);
 		return true;
 	}
 	else
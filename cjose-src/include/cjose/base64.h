@@ -9,8 +9,10 @@
  * \brief
  * Functions for encoding to and decoding from base64 and base64url.
  *
- * \b NOTE: When successful, the output of each function MUST be
- * released by calling free(), even if the output is of 0 length.
+ * \b NOTE: When successful, the output of each allocating function MUST be
+ * released by calling free(), even if the output is of 0 length.  The
+ * <tt>*_into()</tt> variants write to a caller-provided buffer instead, and
+ * never allocate.
  */
 
 #ifndef CJOSE_BASE64_H
@@ -78,6 +80,304 @@ bool cjose_base64_decode(const char *input, const size_t inlen, uint8_t **output
  */
 bool cjose_base64url_decode(const char *input, const size_t inlen, uint8_t **output, size_t *outlen, cjose_err *err);
 
+/**
+ * Computes the exact length of the Base64 encoding (with padding) of an
+ * octet string.
+ *
+ * \param inlen The length of the octet string to encode.
+ * \returns The number of characters produced by encoding <tt>inlen</tt>
+ *          octets (not including any terminating NULL).
+ */
+size_t cjose_base64_encoded_len(size_t inlen);
+/**
+ * Computes the exact length of the URL-safe Base64 encoding (without
+ * padding) of an octet string.
+ *
+ * \param inlen The length of the octet string to encode.
+ * \returns The number of characters produced by encoding <tt>inlen</tt>
+ *          octets (not including any terminating NULL).
+ */
+size_t cjose_base64url_encoded_len(size_t inlen);
+
+/**
+ * Computes the maximum decoded length of a Base64 string.  The actual
+ * length may be shorter if the input is padded.
+ *
+ * \param inlen The length of the text string to decode.
+ * \returns The largest number of octets <tt>inlen</tt> characters can
+ *          decode to.
+ */
+size_t cjose_base64_decoded_max_len(size_t inlen);
+/**
+ * Computes the maximum decoded length of a URL-safe Base64 string.  This
+ * is exact for valid unpadded input.
+ *
+ * \param inlen The length of the text string to decode.
+ * \returns The largest number of octets <tt>inlen</tt> characters can
+ *          decode to.
+ */
+size_t cjose_base64url_decoded_max_len(size_t inlen);
+
+/**
+ * Encodes the given octet string to Base64, into a caller-provided buffer.
+ *
+ * \b NOTE: <tt>output</tt> is \b NOT NULL-terminated.
+ *
+ * \param input The octet string to encode.
+ * \param inlen The length of <tt>input</tt>.
+ * \param output The buffer to write the encoded text to.
+ * \param outcap The capacity of <tt>output</tt>; it must be at least
+ *               cjose_base64_encoded_len(<tt>inlen</tt>).
+ * \param outlen [out] The number of characters written to <tt>output</tt>.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ */
+bool cjose_base64_encode_into(const uint8_t *input, size_t inlen, char *output, size_t outcap, size_t *outlen, cjose_err *err);
+/**
+ * Encodes the given octet string to URL-safe Base64, into a caller-provided
+ * buffer.
+ *
+ * \b NOTE: <tt>output</tt> is \b NOT NULL-terminated.
+ *
+ * \param input The octet string to encode.
+ * \param inlen The length of <tt>input</tt>.
+ * \param output The buffer to write the encoded text to.
+ * \param outcap The capacity of <tt>output</tt>; it must be at least
+ *               cjose_base64url_encoded_len(<tt>inlen</tt>).
+ * \param outlen [out] The number of characters written to <tt>output</tt>.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ */
+bool cjose_base64url_encode_into(const uint8_t *input, size_t inlen, char *output, size_t outcap, size_t *outlen, cjose_err *err);
+
+/**
+ * Decodes the given string from Base64, into a caller-provided buffer.
+ *
+ * Fails with CJOSE_ERR_INVALID_ARG if the decoded octets do not fit in
+ * <tt>outcap</tt>; a capacity of cjose_base64_decoded_max_len(<tt>inlen</tt>)
+ * is always sufficient.  The contents of <tt>output</tt> are unspecified
+ * after a failure.
+ *
+ * \param input The text string to decode.
+ * \param inlen The length of <tt>input</tt>.
+ * \param output The buffer to write the decoded octets to.
+ * \param outcap The capacity of <tt>output</tt>.
+ * \param outlen [out] The number of octets written to <tt>output</tt>.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ */
+bool cjose_base64_decode_into(const char *input, size_t inlen, uint8_t *output, size_t outcap, size_t *outlen, cjose_err *err);
+/**
+ * Decodes the given string from URL-Safe Base64, into a caller-provided
+ * buffer.
+ *
+ * Fails with CJOSE_ERR_INVALID_ARG if the decoded octets do not fit in
+ * <tt>outcap</tt>; a capacity of
+ * cjose_base64url_decoded_max_len(<tt>inlen</tt>) is always sufficient.
+ * The contents of <tt>output</tt> are unspecified after a failure.
+ *
+ * \param input The text string to decode.
+ * \param inlen The length of <tt>input</tt>.
+ * \param output The buffer to write the decoded octets to.
+ * \param outcap The capacity of <tt>output</tt>.
+ * \param outlen [out] The number of octets written to <tt>output</tt>.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ */
+bool cjose_base64url_decode_into(const char *input, size_t inlen, uint8_t *output, size_t outcap, size_t *outlen, cjose_err *err);
+
+/**
+ * Decodes the given URL-safe Base64 string in place, overwriting it with
+ * the decoded octets.  Decoding always writes behind the characters still
+ * to be read, so no scratch buffer is needed.
+ *
+ * On success the first <tt>*outlen</tt> bytes of <tt>buf</tt> hold the
+ * decoded octets and the remainder is unspecified.  The contents of
+ * <tt>buf</tt> are unspecified after a failure.
+ *
+ * \param buf The text string to decode, which receives the decoded octets.
+ * \param len The length of <tt>buf</tt>.
+ * \param outlen [out] The number of octets written to <tt>buf</tt>.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ */
+bool cjose_base64url_decode_inplace(char *buf, size_t len, size_t *outlen, cjose_err *err);
+
+/**
+ * Inputs shorter than this many bytes are never split across threads by
+ * cjose_base64url_encode_parallel() or cjose_base64url_decode_parallel().
+ */
+#define CJOSE_BASE64_PARALLEL_MIN (1024 * 1024)
+
+/**
+ * Encodes the given octet string to URL-safe Base64, splitting inputs of at
+ * least CJOSE_BASE64_PARALLEL_MIN octets on 3-octet boundaries and encoding
+ * the slices on separate threads.  The result is identical to
+ * cjose_base64url_encode(), which is used for smaller inputs.
+ *
+ * \param input The octet string to encode.
+ * \param inlen The length of <tt>input</tt>.
+ * \param output [out] The encoded text string.
+ * \param outlen [out] The length of <tt>output</tt>
+ * \param threads The most threads to use, or 0 for one per processor.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ */
+bool cjose_base64url_encode_parallel(const uint8_t *input, size_t inlen, char **output, size_t *outlen, size_t threads, cjose_err *err);
+/**
+ * Encodes the given octet string to URL-safe Base64, into a caller-provided
+ * buffer, splitting large inputs across threads as
+ * cjose_base64url_encode_parallel() does.
+ *
+ * \b NOTE: <tt>output</tt> is \b NOT NULL-terminated.
+ *
+ * \param input The octet string to encode.
+ * \param inlen The length of <tt>input</tt>.
+ * \param output The buffer to write the encoded text to.
+ * \param outcap The capacity of <tt>output</tt>; it must be at least
+ *               cjose_base64url_encoded_len(<tt>inlen</tt>).
+ * \param outlen [out] The number of characters written to <tt>output</tt>.
+ * \param threads The most threads to use, or 0 for one per processor.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ */
+bool cjose_base64url_encode_parallel_into(const uint8_t *input, size_t inlen, char *output, size_t outcap, size_t *outlen, size_t threads, cjose_err *err);
+/**
+ * Decodes the given string from URL-safe Base64, splitting inputs of at
+ * least CJOSE_BASE64_PARALLEL_MIN characters on 4-character boundaries and
+ * decoding the slices on separate threads.  The result is identical to
+ * cjose_base64url_decode(), which is used for smaller inputs.
+ *
+ * \param input The text string to decode.
+ * \param inlen The length of <tt>input</tt>.
+ * \param output [out] The decoded octet string.
+ * \param outlen [out] The length of <tt>output</tt>.
+ * \param threads The most threads to use, or 0 for one per processor.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ */
+bool cjose_base64url_decode_parallel(const char *input, size_t inlen, uint8_t **output, size_t *outlen, size_t threads, cjose_err *err);
+
+/**
+ * Sets how many threads cjose itself uses to encode and decode large JWS
+ * payloads and JWE parts (see cjose_base64url_encode_parallel()).  The
+ * default of 1 keeps this work on the calling thread; 0 uses one thread
+ * per processor.  This is a process-wide setting, meant to be made once at
+ * startup.
+ *
+ * \param threads The most threads to use.
+ */
+void cjose_base64_set_parallel_threads(size_t threads);
+/**
+ * Returns the setting made by cjose_base64_set_parallel_threads().
+ *
+ * \returns The most threads cjose uses to encode or decode a large payload.
+ */
+size_t cjose_base64_get_parallel_threads();
+
+/**
+ * State for encoding to URL-safe Base64 incrementally.  The caller
+ * allocates it (e.g. on the stack) and sets it up with
+ * cjose_base64url_encoder_init(); the fields are internal.
+ */
+typedef struct
+{
+    /** Input octets carried over to the next call */
+    uint8_t         pending[2];
+    /** Length of <tt>pending</tt> */
+    size_t          pending_len;
+} cjose_base64url_encoder_t;
+
+/**
+ * State for decoding from URL-safe Base64 incrementally.  The caller
+ * allocates it (e.g. on the stack) and sets it up with
+ * cjose_base64url_decoder_init(); the fields are internal.
+ */
+typedef struct
+{
+    /** Input characters carried over to the next call */
+    char            pending[3];
+    /** Length of <tt>pending</tt> */
+    size_t          pending_len;
+} cjose_base64url_decoder_t;
+
+/**
+ * Initializes (or resets) an incremental URL-safe Base64 encoder.
+ *
+ * \param enc The encoder state to initialize.
+ */
+void cjose_base64url_encoder_init(cjose_base64url_encoder_t *enc);
+
+/**
+ * Encodes the next chunk of an octet string.  Only whole 3-octet groups
+ * are written; the 0-2 octets left over are carried to the next call.
+ *
+ * \b NOTE: <tt>output</tt> is \b NOT NULL-terminated.
+ *
+ * \param enc The encoder state.
+ * \param input The next chunk of octets to encode.
+ * \param inlen The length of <tt>input</tt>.
+ * \param output The buffer to write the encoded text to.
+ * \param outcap The capacity of <tt>output</tt>; a capacity of
+ *               cjose_base64_encoded_len(<tt>inlen</tt>) is always
+ *               sufficient.
+ * \param outlen [out] The number of characters written to <tt>output</tt>.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ */
+bool cjose_base64url_encoder_update(cjose_base64url_encoder_t *enc, const uint8_t *input, size_t inlen, char *output, size_t outcap, size_t *outlen, cjose_err *err);
+
+/**
+ * Encodes the octets left over from previous updates, and resets the
+ * encoder.
+ *
+ * \param enc The encoder state.
+ * \param output The buffer to write the encoded text to.
+ * \param outcap The capacity of <tt>output</tt>; 3 is always sufficient.
+ * \param outlen [out] The number of characters written to <tt>output</tt>.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ */
+bool cjose_base64url_encoder_final(cjose_base64url_encoder_t *enc, char *output, size_t outcap, size_t *outlen, cjose_err *err);
+
+/**
+ * Initializes (or resets) an incremental URL-safe Base64 decoder.
+ *
+ * \param dec The decoder state to initialize.
+ */
+void cjose_base64url_decoder_init(cjose_base64url_decoder_t *dec);
+
+/**
+ * Decodes the next chunk of a URL-safe Base64 string.  Only whole
+ * 4-character groups are written; the 1-3 characters left over are carried
+ * to the next call.  Unlike cjose_base64url_decode(), padding characters
+ * are rejected.
+ *
+ * \param dec The decoder state.
+ * \param input The next chunk of text to decode.
+ * \param inlen The length of <tt>input</tt>.
+ * \param output The buffer to write the decoded octets to.
+ * \param outcap The capacity of <tt>output</tt>; a capacity of
+ *               cjose_base64url_decoded_max_len(<tt>inlen</tt> + 3) is
+ *               always sufficient.
+ * \param outlen [out] The number of octets written to <tt>output</tt>.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ */
+bool cjose_base64url_decoder_update(cjose_base64url_decoder_t *dec, const char *input, size_t inlen, uint8_t *output, size_t outcap, size_t *outlen, cjose_err *err);
+
+/**
+ * Decodes the characters left over from previous updates, and resets the
+ * decoder.  Fails if a single character is left over.
+ *
+ * \param dec The decoder state.
+ * \param output The buffer to write the decoded octets to.
+ * \param outcap The capacity of <tt>output</tt>; 2 is always sufficient.
+ * \param outlen [out] The number of octets written to <tt>output</tt>.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ */
+bool cjose_base64url_decoder_final(cjose_base64url_decoder_t *dec, uint8_t *output, size_t outcap, size_t *outlen, cjose_err *err);
 
 #ifdef __cplusplus
 }
@@ -37,6 +37,12 @@ extern const char *CJOSE_HDR_CTY;
 /** The Jose "kid" header attribute. */
 extern const char *CJOSE_HDR_KID;
 
+/** The JWS "b64" header attribute (RFC 7797). */
+extern const char *CJOSE_HDR_B64;
+
+/** The Jose "crit" header attribute. */
+extern const char *CJOSE_HDR_CRIT;
+
 /** The JWE algorithm attribute value for RSA-OAEP. */
 extern const char *CJOSE_HDR_ALG_RSA_OAEP;
 
@@ -46,6 +52,24 @@ extern const char *CJOSE_HDR_ALG_PS256;
 /** The JWE algorithm attribute value for RS256. */
 extern const char *CJOSE_HDR_ALG_RS256;
 
+/** The JWS algorithm attribute value for ES256. */
+extern const char *CJOSE_HDR_ALG_ES256;
+
+/** The JWS algorithm attribute value for ES384. */
+extern const char *CJOSE_HDR_ALG_ES384;
+
+/** The JWS algorithm attribute value for ES512. */
+extern const char *CJOSE_HDR_ALG_ES512;
+
+/** The JWS algorithm attribute value for HS256. */
+extern const char *CJOSE_HDR_ALG_HS256;
+
+/** The JWS algorithm attribute value for HS384. */
+extern const char *CJOSE_HDR_ALG_HS384;
+
+/** The JWS algorithm attribute value for HS512. */
+extern const char *CJOSE_HDR_ALG_HS512;
+
 /** The JWE algorithm attribute value for "dir". */
 extern const char *CJOSE_HDR_ALG_DIR;
 
@@ -115,6 +139,24 @@ const char *cjose_header_get(
         cjose_err *err);
 
 
+/**
+ * Sets the "b64" header attribute of a JWS (RFC 7797), and lists it as
+ * critical in the "crit" attribute.  A JWS whose "b64" is false signs its
+ * payload as it is, without base64url encoding it, and is serialized with
+ * a detached payload (see cjose_jws_set_detached_payload()).
+ *
+ * \param header[in] a previously instantated header object.
+ * \param b64[in] whether the JWS payload is base64url encoded.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if header is successfully set.
+ */
+bool cjose_header_set_b64(
+        cjose_header_t *header,
+        bool b64,
+        cjose_err *err);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -60,6 +60,43 @@ cjose_jwe_t *cjose_jwe_encrypt(
         cjose_err *err);
 
 
+/**
+ * Creates a new, empty JWE object, to be encrypted into with
+ * cjose_jwe_encrypt_into().
+ *
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a newly allocated JWE object.
+ */
+cjose_jwe_t *cjose_jwe_new(
+        cjose_err *err);
+
+
+/**
+ * Encrypts the given plaintext into an existing JWE object, as
+ * cjose_jwe_encrypt() would into a new one.  The JWE is first reset (see
+ * cjose_jwe_reset()), and the buffers it keeps are reused, so that a
+ * long-lived JWE encrypting payloads of similar sizes seldom allocates.
+ *
+ * \param jwe [in] the JWE object to encrypt into.
+ * \param jwk [in] the key to use for encrypting the JWE.
+ * \param header [in] additional header values to include in the JWE header.
+ * \param plaintext [in] the plaintext to be encrypted in the JWE payload.
+ * \param plaintext_len [in] the length of the plaintext.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the JWE was encrypted.  After a failure the JWE can still
+ *        be encrypted into again, or released.
+ */
+bool cjose_jwe_encrypt_into(
+        cjose_jwe_t *jwe,
+        const cjose_jwk_t *jwk,
+        cjose_header_t *header,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err);
+
+
 /**
  * Creates a serialization of the given JWE object.
  *
@@ -78,6 +115,31 @@ char *cjose_jwe_export(
         cjose_jwe_t *jwe,
         cjose_err *err);
 
+
+/**
+ * Writes the compact serialization of the given JWE object into a buffer
+ * supplied by the caller, such as a send buffer.
+ *
+ * \param jwe [in] The JWE object to be serialized.
+ * \param buf [out] the buffer to write the serialization to, or NULL to
+ *        only compute its length.
+ * \param buf_len [in] the size of the buffer.
+ * \param ser_len [out] the length of the serialization, whether or not it
+ *        was written.  It is not NULL-terminated.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the serialization (or its length) is successfully
+ *        returned; false with CJOSE_ERR_INVALID_ARG if the buffer is too
+ *        small, in which case ser_len has the size needed.
+ */
+bool cjose_jwe_export_into(
+        cjose_jwe_t *jwe,
+        char *buf,
+        size_t buf_len,
+        size_t *ser_len,
+        cjose_err *err);
+
+
 /**
  * Creates a new JWE object from the given JWE compact serialization.
  *
@@ -95,6 +157,50 @@ cjose_jwe_t *cjose_jwe_import(
         size_t compact_len,
         cjose_err *err);
 
+/**
+ * Creates a new JWE object from the given JWE compact serialization, decoding
+ * it in place to avoid copying each part.  This is cjose_jwe_import() for
+ * callers that no longer need the serialization afterwards.
+ *
+ * The encoded header is left intact, as it is needed for decryption; the
+ * remaining parts are decoded over their own characters.
+ * The buffer is therefore overwritten, and the JWE object refers to it
+ * rather than owning copies: it must remain valid and must not be modified
+ * until the JWE object is released.  Its contents are unspecified after a
+ * failure.
+ *
+ * \param compact [in, out] a JWE in serialized form, which is consumed.
+ * \param compact_len [in] the length of the compact serialization.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a newly generated JWE object from the given JWE serialization.
+ */
+cjose_jwe_t *cjose_jwe_import_consume(
+        char *compact,
+        size_t compact_len,
+        cjose_err *err);
+
+/**
+ * Creates a new JWE object from the given JWE compact serialization without
+ * copying it.  This is cjose_jwe_import() for callers that keep the
+ * serialization for as long as the JWE object.
+ *
+ * The JWE object refers to the encoded parts in the buffer rather than
+ * owning copies, and decodes all of them into a single allocation.  The
+ * buffer is not modified, but it must remain valid and must not be modified
+ * until the JWE object is released or reset.
+ *
+ * \param compact [in] a JWE in serialized form.
+ * \param compact_len [in] the length of the compact serialization.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a newly generated JWE object from the given JWE serialization.
+ */
+cjose_jwe_t *cjose_jwe_import_view(
+        const char *compact,
+        size_t compact_len,
+        cjose_err *err);
+
 /**
  * Decrypts the JWE object using the given JWK.  Returns the plaintext data of 
  * the JWE payload.
@@ -115,6 +221,44 @@ uint8_t *cjose_jwe_decrypt(
         cjose_err *err);
 
 
+/**
+ * Decrypts the JWE object using the given JWK into a buffer supplied by the
+ * caller.  The buffer is never left holding content that fails to
+ * authenticate.
+ *
+ * \param jwe [in] the JWE object to decrypt.
+ * \param jwk [in] the key to use for decrypting, or NULL if buf is NULL.
+ * \param buf [out] the buffer to write the decrypted content to, or NULL to
+ *        only compute the size it needs.
+ * \param buf_len [in] the size of the buffer.
+ * \param content_len [out] the number of bytes of decrypted content, or the
+ *        size the buffer needs if none was written.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the content (or the size it needs) is successfully
+ *        returned; false with CJOSE_ERR_INVALID_ARG if the buffer is too
+ *        small, in which case content_len has the size needed.
+ */
+bool cjose_jwe_decrypt_into(
+        cjose_jwe_t *jwe,
+        const cjose_jwk_t *jwk,
+        uint8_t *buf,
+        size_t buf_len,
+        size_t *content_len,
+        cjose_err *err);
+
+
+/**
+ * Empties the given JWE object for reuse, keeping the buffers it allocated
+ * itself (but not those it borrowed from a caller) so that the next JWE
+ * encrypted into it need not allocate them again.  The content-encryption
+ * key is cleared.
+ *
+ * \param jwe the JWE to be reset.  If null, this is a no-op.
+ */
+void cjose_jwe_reset(cjose_jwe_t *jwe);
+
+
 /**
  * Releases the given JWE object.
  *
@@ -122,6 +266,145 @@ uint8_t *cjose_jwe_decrypt(
  */
 void cjose_jwe_release(cjose_jwe_t *jwe);
 
+
+/**
+ * An instance of a JWE being encrypted or decrypted a piece at a time, so
+ * that large content need not be held in memory all at once.
+ */
+typedef struct _cjose_jwe_stream_int cjose_jwe_stream_t;
+
+
+/**
+ * Begins encrypting a JWE whose content is given a piece at a time, with
+ * cjose_jwe_encrypt_update() and then cjose_jwe_encrypt_final().  Each of
+ * those returns the next piece of the JWE compact serialization, so the
+ * content, its ciphertext and the serialization are never held in full.
+ *
+ * \param jwk [in] the key to use for encrypting the JWE.
+ * \param header [in] additional header values to include in the JWE header.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a new stream, to be released with cjose_jwe_stream_release().
+ */
+cjose_jwe_stream_t *cjose_jwe_encrypt_init(
+        const cjose_jwk_t *jwk,
+        cjose_header_t *header,
+        cjose_err *err);
+
+
+/**
+ * Encrypts the next piece of the content of a JWE begun with
+ * cjose_jwe_encrypt_init().  The pieces may be of any length.
+ *
+ * \param stream [in] the stream encrypting the JWE.
+ * \param plaintext [in] the next piece of the content.
+ * \param plaintext_len [in] the length of this piece.
+ * \param ser [out] pointer to the text to append to the compact serialization
+ *        so far.  The text is owned by the stream, is \b NOT NULL-terminated,
+ *        and is only valid until the next call on the stream.
+ * \param ser_len [out] the length of the text, which may be 0.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the piece was encrypted.  After a failure the stream can
+ *        only be released.
+ */
+bool cjose_jwe_encrypt_update(
+        cjose_jwe_stream_t *stream,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        const char **ser,
+        size_t *ser_len,
+        cjose_err *err);
+
+
+/**
+ * Finishes encrypting a JWE begun with cjose_jwe_encrypt_init(), returning
+ * the end of its compact serialization, authentication tag included.
+ *
+ * \param stream [in] the stream encrypting the JWE.
+ * \param ser [out] pointer to the text that completes the compact
+ *        serialization.  The text is owned by the stream, is \b NOT
+ *        NULL-terminated, and is valid until the stream is released.
+ * \param ser_len [out] the length of the text.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the JWE was encrypted.
+ */
+bool cjose_jwe_encrypt_final(
+        cjose_jwe_stream_t *stream,
+        const char **ser,
+        size_t *ser_len,
+        cjose_err *err);
+
+
+/**
+ * Begins decrypting a JWE compact serialization that is given a piece at a
+ * time, with cjose_jwe_decrypt_update() and then cjose_jwe_decrypt_final().
+ *
+ * \param jwk [in] the key to use for decrypting.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a new stream, to be released with cjose_jwe_stream_release().
+ */
+cjose_jwe_stream_t *cjose_jwe_decrypt_init(
+        const cjose_jwk_t *jwk,
+        cjose_err *err);
+
+
+/**
+ * Reads the next piece of the compact serialization of a JWE begun with
+ * cjose_jwe_decrypt_init(), returning the content decrypted from it.  The
+ * pieces may be split anywhere.
+ *
+ * \b NOTE: the content is returned before the authentication tag has been
+ * checked, and is \b UNAUTHENTICATED: it must not be trusted or acted on
+ * (only held, e.g. in a temporary file) until cjose_jwe_decrypt_final()
+ * succeeds, and must be discarded if it fails.
+ *
+ * \param stream [in] the stream decrypting the JWE.
+ * \param ser [in] the next piece of the compact serialization.
+ * \param ser_len [in] the length of this piece.
+ * \param plaintext [out] pointer to the content decrypted from this piece.
+ *        The buffer is owned by the stream, and is only valid until the next
+ *        call on the stream.
+ * \param plaintext_len [out] the length of the content, which may be 0.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the piece was read.  After a failure the stream can only
+ *        be released.
+ */
+bool cjose_jwe_decrypt_update(
+        cjose_jwe_stream_t *stream,
+        const char *ser,
+        size_t ser_len,
+        const uint8_t **plaintext,
+        size_t *plaintext_len,
+        cjose_err *err);
+
+
+/**
+ * Finishes decrypting a JWE begun with cjose_jwe_decrypt_init(), once all
+ * of its compact serialization has been read, by checking its
+ * authentication tag.
+ *
+ * \param stream [in] the stream decrypting the JWE.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the content returned by cjose_jwe_decrypt_update() is
+ *        authentic.
+ */
+bool cjose_jwe_decrypt_final(
+        cjose_jwe_stream_t *stream,
+        cjose_err *err);
+
+
+/**
+ * Releases the given JWE stream.
+ *
+ * \param stream the stream to be released.  If null, this is a no-op.
+ */
+void cjose_jwe_stream_release(cjose_jwe_stream_t *stream);
+
 #ifdef __cplusplus
 }
 #endif
@@ -198,6 +198,25 @@ cjose_jwk_t *cjose_jwk_create_RSA_random(
 cjose_jwk_t *cjose_jwk_create_RSA_spec(
         const cjose_jwk_rsa_keyspec *spec, cjose_err *err);
 
+/**
+ * Sets whether RSA keys are warmed up as they are created or imported.
+ * A warmed up key has its Montgomery contexts and blinding built up front,
+ * instead of on its first use under OpenSSL's global RSA lock, so that a
+ * key rotated in under load does not stall the threads using it.  Creating
+ * or importing a key costs more with this set.  It is off by default, and
+ * is a process-wide setting, meant to be made once at startup.
+ *
+ * \param warmup <tt>true</tt> to warm up RSA keys from now on.
+ */
+void cjose_jwk_set_RSA_warmup(bool warmup);
+
+/**
+ * Returns the setting made by cjose_jwk_set_RSA_warmup().
+ *
+ * \returns <tt>true</tt> if RSA keys are warmed up.
+ */
+bool cjose_jwk_get_RSA_warmup();
+
 /** Enumeration of supported Elliptic-Curve types */
 typedef enum
 {
@@ -37,6 +37,11 @@ typedef struct _cjose_jws_int cjose_jws_t;
  * Creates a new JWS by signing the given plaintext within the given header
  * and JWK.
  *
+ * If the header's "b64" attribute is false (see cjose_header_set_b64()), the
+ * plaintext is signed as it is rather than base64url encoded (RFC 7797), and
+ * the JWS is serialized with a detached payload: its payload segment is
+ * empty, and the plaintext is conveyed separately.
+ *
  * \param jwk [in] the key to use for signing the JWS.
  * \param header [in] header values to include in the JWS header.
  * \param plaintext [in] the plaintext to be signed as the JWS payload.
@@ -53,6 +58,125 @@ cjose_jws_t *cjose_jws_sign(
         cjose_err *err);
 
 
+/**
+ * Creates a new, empty JWS object, to be signed into with
+ * cjose_jws_sign_into() or cjose_jws_sign_with_template_into().
+ *
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a newly allocated JWS object.
+ */
+cjose_jws_t *cjose_jws_new(
+        cjose_err *err);
+
+
+/**
+ * Signs the given plaintext into an existing JWS object, as
+ * cjose_jws_sign() would into a new one.  The JWS is first reset (see
+ * cjose_jws_reset()), and the buffers it keeps are reused, so that a
+ * long-lived JWS signing payloads of similar sizes seldom allocates.
+ *
+ * \param jws [in] the JWS object to sign into.
+ * \param jwk [in] the key to use for signing the JWS.
+ * \param header [in] header values to include in the JWS header.
+ * \param plaintext [in] the plaintext to be signed as the JWS payload.
+ * \param plaintext_len [in] the length of the plaintext.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the JWS was signed.  After a failure the JWS can still be
+ *        signed into again, or released.
+ */
+bool cjose_jws_sign_into(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        cjose_header_t *header,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err);
+
+
+/**
+ * An instance of a JWS header frozen for signing many payloads.
+ */
+typedef struct _cjose_jws_template_int cjose_jws_template_t;
+
+
+/**
+ * Creates a template for signing many payloads with the same header.  The
+ * header is copied, serialized and encoded, and its algorithm looked up,
+ * once here instead of on every cjose_jws_sign(); later changes to the
+ * given header do not affect the template.
+ *
+ * \param header [in] header values to include in each JWS header.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a newly generated template, or NULL if the header does not name
+ *        a supported algorithm.
+ */
+cjose_jws_template_t *cjose_jws_template_new(
+        cjose_header_t *header,
+        cjose_err *err);
+
+
+/**
+ * Releases the given template.  Every JWS signed with the template must be
+ * released first.
+ *
+ * \param tmpl the template to be released.  If null, this is a no-op.
+ */
+void cjose_jws_template_release(cjose_jws_template_t *tmpl);
+
+
+/**
+ * Creates a new JWS by signing the given plaintext within the header of the
+ * given template, and with the given JWK.  The result is the same as that of
+ * cjose_jws_sign() with the template's header.
+ *
+ * The JWS refers to the template's header rather than copying it, so the
+ * template must remain valid until the JWS is released.  A template is not
+ * modified by signing, and may be used from several threads at once.
+ *
+ * \param jwk [in] the key to use for signing the JWS.
+ * \param tmpl [in] the template holding the JWS header.
+ * \param plaintext [in] the plaintext to be signed as the JWS payload.
+ * \param plaintext_len [in] the length of the plaintext.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a newly generated JWS with the given plaintext as the payload.
+ */
+cjose_jws_t *cjose_jws_sign_with_template(
+        const cjose_jwk_t *jwk,
+        const cjose_jws_template_t *tmpl,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err);
+
+
+/**
+ * Signs the given plaintext into an existing JWS object, within the header
+ * of the given template, reusing the buffers the JWS keeps as
+ * cjose_jws_sign_into() does.  The template must remain valid until the JWS
+ * is next reset or released.
+ *
+ * \param jws [in] the JWS object to sign into.
+ * \param jwk [in] the key to use for signing the JWS.
+ * \param tmpl [in] the template holding the JWS header.
+ * \param plaintext [in] the plaintext to be signed as the JWS payload.
+ * \param plaintext_len [in] the length of the plaintext.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the JWS was signed.  After a failure the JWS can still be
+ *        signed into again, or released.
+ */
+bool cjose_jws_sign_with_template_into(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        const cjose_jws_template_t *tmpl,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err);
+
+
 /**
  * Creates a serialization of the given JWS object.
  *
@@ -74,6 +198,31 @@ bool cjose_jws_export(
         cjose_err *err);
 
 
+/**
+ * Writes the compact serialization of the given JWS object into a buffer
+ * supplied by the caller, such as a send buffer, without keeping a copy in
+ * the JWS.
+ *
+ * \param jws [in] the JWS object to be serialized.
+ * \param buf [out] the buffer to write the serialization to, or NULL to
+ *        only compute its length.
+ * \param buf_len [in] the size of the buffer.
+ * \param ser_len [out] the length of the serialization, whether or not it
+ *        was written.  It is not NULL-terminated.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the serialization (or its length) is successfully
+ *        returned; false with CJOSE_ERR_INVALID_ARG if the buffer is too
+ *        small, in which case ser_len has the size needed.
+ */
+bool cjose_jws_export_into(
+        cjose_jws_t *jws,
+        char *buf,
+        size_t buf_len,
+        size_t *ser_len,
+        cjose_err *err);
+
+
 /**
  * Creates a new JWS object from the given JWS compact serialization.
  *
@@ -92,6 +241,75 @@ cjose_jws_t *cjose_jws_import(
         cjose_err *err);
 
 
+/**
+ * Creates a new JWS object from the given JWS compact serialization without
+ * copying it.  This is cjose_jws_import() for callers that keep the
+ * serialization around for as long as the JWS object.
+ *
+ * The JWS object refers to the encoded header, payload and signature where
+ * they are in <tt>compact</tt>, which is never modified; it must remain
+ * valid and unchanged until the JWS object is released.
+ *
+ * \param compact [in] a JWS in serialized form.
+ * \param compact_len [in] the length of the compact serialization.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a newly generated JWS object from the given JWS serialization.
+ */
+cjose_jws_t *cjose_jws_import_view(
+        const char *compact,
+        size_t compact_len,
+        cjose_err *err);
+
+
+/**
+ * Creates a new JWS object from the given JWS compact serialization, decoding
+ * it in place to avoid copying each part.  This is cjose_jws_import() for
+ * callers that no longer need the serialization afterwards.
+ *
+ * The encoded header and payload are left intact, as they are needed for
+ * verification; the signature is decoded over its own characters.
+ * The buffer is therefore overwritten, and the JWS object refers to it
+ * rather than owning copies: it must remain valid and must not be modified
+ * until the JWS object is released.  Its contents are unspecified after a
+ * failure.
+ *
+ * \param compact [in, out] a JWS in serialized form, which is consumed.
+ * \param compact_len [in] the length of the compact serialization.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a newly generated JWS object from the given JWS serialization.
+ */
+cjose_jws_t *cjose_jws_import_consume(
+        char *compact,
+        size_t compact_len,
+        cjose_err *err);
+
+
+/**
+ * Supplies the detached payload of an imported JWS, whose serialization has
+ * an empty payload segment, before it is verified.  This is required for a
+ * JWS whose "b64" header attribute is false (RFC 7797), and allows any
+ * other JWS to be verified against a payload conveyed separately (RFC 7515
+ * appendix F).
+ *
+ * The JWS refers to the given plaintext rather than copying it; it must
+ * remain valid and unchanged until the JWS object is released.
+ *
+ * \param jws [in] the imported JWS object.
+ * \param plaintext [in] the payload of the JWS.
+ * \param plaintext_len [in] the length of the payload.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the payload was supplied.
+ */
+bool cjose_jws_set_detached_payload(
+        cjose_jws_t *jws,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err);
+
+
 /**
  * Verifies the JWS object using the given JWK.  
  *
@@ -107,9 +325,133 @@ bool cjose_jws_verify(
         cjose_err *err);
 
 
+/**
+ * Verifies a JWS compact serialization using the given JWK, without
+ * creating a JWS object: the signing input is hashed where it lies in the
+ * serialization, and the payload is decoded into the caller's buffer only
+ * once the signature has verified.  A JWS with a detached, unencoded
+ * payload cannot be verified this way.
+ *
+ * \param compact [in] a JWS in serialized form.
+ * \param compact_len [in] the length of the compact serialization.
+ * \param jwk [in] the key to use for verification.
+ * \param payload_out [out] the buffer to decode the payload into, or NULL
+ *        to only verify.
+ * \param payload_len [in, out] the size of payload_out; on return, the
+ *        length of the payload.  If payload_out is NULL, or too small for
+ *        the payload, it is set to the size needed instead.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if verification was successful; false with
+ *        CJOSE_ERR_INVALID_ARG, before verifying, if payload_out is too
+ *        small.
+ */
+bool cjose_jws_verify_compact(
+        const char *compact,
+        size_t compact_len,
+        const cjose_jwk_t *jwk,
+        uint8_t *payload_out,
+        size_t *payload_len,
+        cjose_err *err);
+
+
+/**
+ * Verifies several JWS objects at once, spreading the work across threads
+ * (see cjose_jws_set_batch_threads()).  jws[i] is verified with keys[i],
+ * and the outcome written to results[i], in the order given.
+ *
+ * Unlike cjose_jws_verify(), a JWS that fails verification is not released;
+ * the caller keeps ownership of every JWS in the batch.  A JWS may appear
+ * only once in a batch, while a key may be shared by any number of them.
+ * With OpenSSL 1.0.x the application must have set up OpenSSL's locking
+ * callbacks before verifying a batch on several threads.
+ *
+ * \param jws [in] the JWS objects to verify.
+ * \param keys [in] the key to verify each JWS object with.
+ * \param n [in] the number of JWS objects (and keys, results and errors).
+ * \param results [out] set to whether each JWS object verified.
+ * \param errs [out] An optional array of n error objects, each of which can
+ *        be used to get additional information on why the JWS object of the
+ *        same index did not verify.
+ * \returns true if every JWS object in the batch verified.
+ */
+bool cjose_jws_verify_batch(
+        cjose_jws_t **jws,
+        const cjose_jwk_t **keys,
+        size_t n,
+        bool *results,
+        cjose_err *errs);
+
+
+/**
+ * Sets how many threads cjose_jws_verify_batch() spreads a batch across.
+ * The default of 0 uses one thread per processor; 1 does all the work on
+ * the calling thread.  This is a process-wide setting, meant to be made once
+ * at startup.
+ *
+ * \param threads The most threads to use for one batch.
+ */
+void cjose_jws_set_batch_threads(size_t threads);
+
+
+/**
+ * Returns the setting made by cjose_jws_set_batch_threads().
+ *
+ * \returns The most threads used for one batch.
+ */
+size_t cjose_jws_get_batch_threads();
+
+
+/**
+ * Sets how many threads cjose_jws_multi_sign() spreads the signatures of a
+ * JWS across.  The default of 1 signs on the calling thread; 0 uses one
+ * thread per processor.  This is a process-wide setting, meant to be made
+ * once at startup.
+ *
+ * \param threads The most threads to use for one JWS.
+ */
+void cjose_jws_set_sign_threads(size_t threads);
+
+
+/**
+ * Returns the setting made by cjose_jws_set_sign_threads().
+ *
+ * \returns The most threads used for one JWS.
+ */
+size_t cjose_jws_get_sign_threads();
+
+
+/**
+ * Enables a process-wide cache of verified signatures, so that verifying a
+ * token again with the same key (as when a client resends a bearer token)
+ * costs a hash and a lookup instead of a public key operation.  Entries are
+ * keyed by a hash of the signing input and signature, and by the key they
+ * verified with; a key's entries are dropped when it is released.  When the
+ * cache is full, entries that have not been looked up recently are replaced.
+ *
+ * Only RSA and EC signatures are cached; an HMAC is cheaper to check than to
+ * look up.  The cache is disabled by default, and is safe to use from many
+ * threads at once.  Like the other process-wide settings, it is meant to be
+ * set once at startup, before any other thread verifies a JWS.
+ *
+ * \param entries [in] the number of signatures to hold (rounded up to a
+ *        whole number of sets), or 0 to disable and free the cache.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the cache was set up (or disabled).
+ */
+bool cjose_jws_set_verify_cache(size_t entries, cjose_err *err);
+
+
 /**
  * Returns the plaintext data of the JWS payload.
  *
+ * The payload of an imported JWS is not decoded until it is first requested
+ * here, and is then kept with the JWS for later calls.  Decoding a payload
+ * that is not valid base64url fails here rather than on import.  Despite
+ * the const JWS, that first call modifies it, so it must not be made from
+ * two threads at once; later calls only read.
+ *
  * \param jws [in] the JWS object for which the plaintext is requested.
  * \param plaintext [out] pointer to the plaintext of this JWS.  Note
  *        the returned buffer is owned by the JWS, the caller should
@@ -128,6 +470,17 @@ bool cjose_jws_get_plaintext(
         cjose_err *err);
 
 
+/**
+ * Empties the given JWS object for reuse, keeping the buffers it allocated
+ * itself (but not those it borrowed from a caller or template) so that the
+ * next JWS signed into it need not allocate them again.  Any serialization
+ * or plaintext previously returned from the JWS is no longer valid.
+ *
+ * \param jws the JWS to be reset.  If null, this is a no-op.
+ */
+void cjose_jws_reset(cjose_jws_t *jws);
+
+
 /**
  * Releases the given JWS object.
  *
@@ -135,6 +488,282 @@ bool cjose_jws_get_plaintext(
  */
 void cjose_jws_release(cjose_jws_t *jws);
 
+
+/**
+ * An instance of a JWS being signed or verified a piece at a time, so that
+ * a large payload need not be held in memory all at once.
+ */
+typedef struct _cjose_jws_stream_int cjose_jws_stream_t;
+
+
+/**
+ * Begins signing a JWS whose payload is given a piece at a time, with
+ * cjose_jws_sign_update() and then cjose_jws_sign_final().  Each of those
+ * returns the next piece of the JWS compact serialization, so the payload,
+ * its encoding and the serialization are never held in full.  If the
+ * header's "b64" attribute is false, the payload is signed as it is and
+ * detached, and the pieces are just the header and signature.
+ *
+ * \param jwk [in] the key to use for signing the JWS.
+ * \param header [in] header values to include in the JWS header.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a new stream, to be released with cjose_jws_stream_release().
+ */
+cjose_jws_stream_t *cjose_jws_sign_init(
+        const cjose_jwk_t *jwk,
+        cjose_header_t *header,
+        cjose_err *err);
+
+
+/**
+ * Signs the next piece of the payload of a JWS begun with
+ * cjose_jws_sign_init().  The pieces may be of any length.
+ *
+ * \param stream [in] the stream signing the JWS.
+ * \param plaintext [in] the next piece of the payload.
+ * \param plaintext_len [in] the length of this piece.
+ * \param ser [out] pointer to the text to append to the compact serialization
+ *        so far.  The text is owned by the stream, is \b NOT NULL-terminated,
+ *        and is only valid until the next call on the stream.
+ * \param ser_len [out] the length of the text, which may be 0.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the piece was signed.  After a failure the stream can only
+ *        be released.
+ */
+bool cjose_jws_sign_update(
+        cjose_jws_stream_t *stream,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        const char **ser,
+        size_t *ser_len,
+        cjose_err *err);
+
+
+/**
+ * Finishes signing a JWS begun with cjose_jws_sign_init(), returning the end
+ * of its compact serialization, signature included.
+ *
+ * \param stream [in] the stream signing the JWS.
+ * \param ser [out] pointer to the text that completes the compact
+ *        serialization.  The text is owned by the stream, is \b NOT
+ *        NULL-terminated, and is valid until the stream is released.
+ * \param ser_len [out] the length of the text.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the JWS was signed.
+ */
+bool cjose_jws_sign_final(
+        cjose_jws_stream_t *stream,
+        const char **ser,
+        size_t *ser_len,
+        cjose_err *err);
+
+
+/**
+ * Begins verifying a JWS compact serialization that is given a piece at a
+ * time, with cjose_jws_verify_update() and then cjose_jws_verify_final().
+ *
+ * \param jwk [in] the key to use for verification.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a new stream, to be released with cjose_jws_stream_release().
+ */
+cjose_jws_stream_t *cjose_jws_verify_init(
+        const cjose_jwk_t *jwk,
+        cjose_err *err);
+
+
+/**
+ * Reads the next piece of the compact serialization of a JWS begun with
+ * cjose_jws_verify_init(), returning the payload decoded from it.  The
+ * pieces may be split anywhere.
+ *
+ * \b NOTE: the payload is returned before the signature has been checked;
+ * it must not be trusted until cjose_jws_verify_final() succeeds.
+ *
+ * \param stream [in] the stream verifying the JWS.
+ * \param ser [in] the next piece of the compact serialization.
+ * \param ser_len [in] the length of this piece.
+ * \param plaintext [out] pointer to the payload decoded from this piece.  The
+ *        buffer is owned by the stream, and is only valid until the next call
+ *        on the stream.
+ * \param plaintext_len [out] the length of the payload, which may be 0.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the piece was read.  After a failure the stream can only
+ *        be released.
+ */
+bool cjose_jws_verify_update(
+        cjose_jws_stream_t *stream,
+        const char *ser,
+        size_t ser_len,
+        const uint8_t **plaintext,
+        size_t *plaintext_len,
+        cjose_err *err);
+
+
+/**
+ * Reads the next piece of the detached payload of a JWS begun with
+ * cjose_jws_verify_init(), once its compact serialization (whose payload
+ * segment is empty) has been read up to the signature.  A JWS whose "b64"
+ * header attribute is false must have its payload given this way, even if
+ * it is empty.
+ *
+ * \param stream [in] the stream verifying the JWS.
+ * \param plaintext [in] the next piece of the payload.
+ * \param plaintext_len [in] the length of this piece.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the piece was read.  After a failure the stream can only
+ *        be released.
+ */
+bool cjose_jws_verify_update_detached(
+        cjose_jws_stream_t *stream,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err);
+
+
+/**
+ * Finishes verifying a JWS begun with cjose_jws_verify_init(), once all of
+ * its compact serialization (and any detached payload) has been read.
+ *
+ * \param stream [in] the stream verifying the JWS.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if verification was successful.
+ */
+bool cjose_jws_verify_final(
+        cjose_jws_stream_t *stream,
+        cjose_err *err);
+
+
+/**
+ * Releases the given JWS stream.
+ *
+ * \param stream the stream to be released.  If null, this is a no-op.
+ */
+void cjose_jws_stream_release(cjose_jws_stream_t *stream);
+
+
+/**
+ * An instance of a JWS object with one or more signatures over a single
+ * payload, in the JWS JSON Serialization (RFC 7515 section 7.2).
+ */
+typedef struct _cjose_jws_multi_int cjose_jws_multi_t;
+
+
+/**
+ * Creates a new JWS object by signing the given plaintext with each of the
+ * given keys.  The payload is base64url encoded once, and the signatures may
+ * be computed in parallel (see cjose_jws_set_sign_threads()).  Each header
+ * becomes the protected header of its signature, and must not set the "b64"
+ * header attribute to false.
+ * With OpenSSL 1.0.x the application must have set up OpenSSL's locking
+ * callbacks before signing on several threads.
+ *
+ * \param jwks [in] the keys to sign with.
+ * \param headers [in] the protected header to sign with each key.
+ * \param count [in] the number of signatures (keys and headers).
+ * \param plaintext [in] the plaintext to sign as the JWS payload.
+ * \param plaintext_len [in] the length of the plaintext.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a newly generated JWS with the given plaintext as its payload and
+ *        a signature for each key.
+ */
+cjose_jws_multi_t *cjose_jws_multi_sign(
+        const cjose_jwk_t **jwks,
+        cjose_header_t **headers,
+        size_t count,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err);
+
+
+/**
+ * Creates a JSON serialization of the given JWS object.
+ *
+ * \param jws [in] The JWS object to be serialized.
+ * \param flattened [in] whether to use the flattened syntax, which is only
+ *        possible for a JWS with a single signature.
+ * \param ser [out] pointer to a JSON serialization of this JWS.  The buffer
+ *        is owned by the JWS, and is valid until it is exported again or
+ *        released.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the serialization is successfully returned.
+ */
+bool cjose_jws_multi_export(
+        cjose_jws_multi_t *jws,
+        bool flattened,
+        const char **ser,
+        cjose_err *err);
+
+
+/**
+ * Creates a new JWS object from the given JSON serialization, in either the
+ * general or the flattened syntax.
+ *
+ * \param ser [in] A JSON serialization of a JWS.
+ * \param ser_len [in] The length of the serialization.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns a newly created JWS object.
+ */
+cjose_jws_multi_t *cjose_jws_multi_import(
+        const char *ser,
+        size_t ser_len,
+        cjose_err *err);
+
+
+/**
+ * Verifies a signature of the JWS object using the given JWK.  Given a kid,
+ * only the signatures whose protected or unprotected header has that "kid"
+ * are verified; otherwise each signature is tried in turn.
+ *
+ * \param jws [in] the JWS object to verify.
+ * \param jwk [in] the key to use for verification.
+ * \param kid [in] the kid of the signature to verify, or NULL for any.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if a signature verified.  Unlike cjose_jws_verify(), the JWS
+ *        is not released if none did.
+ */
+bool cjose_jws_multi_verify(
+        cjose_jws_multi_t *jws,
+        const cjose_jwk_t *jwk,
+        const char *kid,
+        cjose_err *err);
+
+
+/**
+ * Returns the plaintext data of the JWS payload.
+ *
+ * \param jws [in] the JWS object for which the plaintext is requested.
+ * \param plaintext [out] pointer to the plaintext of this JWS.  The buffer
+ *        is owned by the JWS.
+ * \param plaintext_len [out] length of the plaintext.
+ * \param err [out] An optional error object which can be used to get additional
+ *        information in the event of an error.
+ * \returns true if the plaintext is successfully returned.
+ */
+bool cjose_jws_multi_get_plaintext(
+        const cjose_jws_multi_t *jws,
+        uint8_t **plaintext,
+        size_t *plaintext_len,
+        cjose_err *err);
+
+
+/**
+ * Releases the given JWS object.
+ *
+ * \param jws the JWS to be released.  If null, this is a no-op.
+ */
+void cjose_jws_multi_release(cjose_jws_multi_t *jws);
+
 #ifdef __cplusplus
 }
 #endif
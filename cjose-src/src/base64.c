@@ -11,6 +11,24 @@
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include "include/thread_int.h"
+
+// SIMD code paths are only built for x86/x64 with a compiler that can emit
+// SSSE3/AVX2 code per-function; define CJOSE_NO_SIMD to disable them.
+#if !defined(CJOSE_NO_SIMD) && \
+    (defined(__x86_64__) || defined(__i386__) || \
+     defined(_M_X64) || defined(_M_IX86)) && \
+    (defined(_MSC_VER) || defined(__clang__) || (__GNUC__ >= 5))
+#  define CJOSE_B64_SIMD 1
+#  include <immintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#    define CJOSE_B64_TARGET(t)
+#  else
+#    include <cpuid.h>
+#    define CJOSE_B64_TARGET(t) __attribute__((target(t)))
+#  endif
+#endif
 
 // defines
 #define B64_BYTE1(ptr) (((*ptr) & 0xfc)>>2)
@@ -58,53 +76,414 @@ static const uint8_t TEBAHPLA_B64[] = {
     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
 };
 
-// internal functions
+// SIMD support
 
-static inline bool _decode(const char *input, size_t inlen,
-                           uint8_t **output, size_t *outlen,
-                           bool url, cjose_err *err)
+#ifdef CJOSE_B64_SIMD
+
+#define CJOSE_CPU_SSSE3     0x01
+#define CJOSE_CPU_AVX2      0x02
+
+static int _cpu_features = -1;
+
+static int _cjose_cpu_features()
 {
-    if ((NULL == input) || (NULL == output) || (NULL == outlen))
+    unsigned int    regs[4] = { 0, 0, 0, 0 };
+    unsigned int    max_leaf = 0;
+    unsigned long long xcr0 = 0;
+    int             features = 0;
+
+#if defined(_MSC_VER)
+    __cpuid((int *)regs, 0);
+    max_leaf = regs[0];
+    if (1 > max_leaf)
+    {
+        return 0;
+    }
+    __cpuid((int *)regs, 1);
+#else
+    max_leaf = __get_cpuid_max(0, NULL);
+    if (1 > max_leaf)
+    {
+        return 0;
+    }
+    __cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+#endif
+
+    // SSSE3 is ECX bit 9 of leaf 1
+    if (regs[2] & (1 << 9))
+    {
+        features |= CJOSE_CPU_SSSE3;
+    }
+
+    // AVX2 needs OSXSAVE (ECX bit 27) with the OS saving YMM state,
+    // and AVX2 itself (EBX bit 5 of leaf 7)
+    if ((regs[2] & (1 << 27)) && 7 <= max_leaf)
+    {
+#if defined(_MSC_VER)
+        xcr0 = _xgetbv(0);
+        __cpuidex((int *)regs, 7, 0);
+#else
+        unsigned int xcr0_lo = 0, xcr0_hi = 0;
+        __asm__ __volatile__ ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        xcr0 = ((unsigned long long)xcr0_hi << 32) | xcr0_lo;
+        __cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        if (0x06 == (xcr0 & 0x06) && (regs[1] & (1 << 5)))
+        {
+            features |= CJOSE_CPU_AVX2;
+        }
+    }
+
+    return features;
+}
+
+static inline int _get_cpu_features()
+{
+    // detection is idempotent, so a racing first call is harmless
+    if (0 > _cpu_features)
+    {
+        _cpu_features = _cjose_cpu_features();
+    }
+    return _cpu_features;
+}
+
+// Translates 6-bit values (one per byte) to base64 or base64url characters,
+// by adding a per-range offset to each value (Mula's method).
+CJOSE_B64_TARGET("ssse3")
+static inline __m128i _encode_lookup_ssse3(__m128i indices, bool url)
+{
+    const __m128i offsets = url ?
+        _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0) :
+        _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+    // 0..25 => 13, 26..51 => 0, 52..61 => 1..10, 62 => 11, 63 => 12
+    __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, result), indices);
+}
+
+// Splits each 3-byte group (spread over 4 bytes) into four 6-bit values.
+CJOSE_B64_TARGET("ssse3")
+static inline __m128i _encode_unpack_ssse3(__m128i in)
+{
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(
+            10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+
+    return _mm_or_si128(t1, t3);
+}
+
+CJOSE_B64_TARGET("ssse3")
+static size_t _encode_ssse3(const uint8_t *input, size_t inlen,
+                            char *output, bool url)
+{
+    size_t  idx = 0, pos = 0;
+
+    // 12 bytes in, 16 characters out; each load reads 16 bytes
+    while ((idx + 16) <= inlen)
+    {
+        __m128i in = _mm_loadu_si128((const __m128i *)(input + idx));
+        __m128i out = _encode_lookup_ssse3(_encode_unpack_ssse3(in), url);
+        _mm_storeu_si128((__m128i *)(output + pos), out);
+        idx += 12;
+        pos += 16;
+    }
+
+    return idx;
+}
+
+CJOSE_B64_TARGET("avx2")
+static size_t _encode_avx2(const uint8_t *input, size_t inlen,
+                           char *output, bool url)
+{
+    size_t  idx = 0, pos = 0;
+
+    const __m256i offsets = url ?
+        _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0,
+                         'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0) :
+        _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                         'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    const __m256i shuf = _mm256_setr_epi8(
+            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+
+    // 24 bytes in, 32 characters out; each lane takes 12 bytes, and the
+    // upper lane's load reads up to input[idx + 28]
+    while ((idx + 28) <= inlen)
+    {
+        __m256i in = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(
+                        _mm_loadu_si128((const __m128i *)(input + idx))),
+                _mm_loadu_si128((const __m128i *)(input + idx + 12)), 1);
+        in = _mm256_shuffle_epi8(in, shuf);
+
+        const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+        const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+        const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(t1, t3);
+
+        __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        result = _mm256_or_si256(result,
+                _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        result = _mm256_add_epi8(
+                _mm256_shuffle_epi8(offsets, result), indices);
+
+        _mm256_storeu_si256((__m256i *)(output + pos), result);
+        idx += 24;
+        pos += 32;
+    }
+
+    // finish what we can with 128-bit registers
+    return idx + _encode_ssse3(input + idx, inlen - idx, output + pos, url);
+}
+
+// Validates 16 characters and translates them to their 6-bit values.
+// Returns false if any character is outside of the alphabet ('=' included).
+CJOSE_B64_TARGET("ssse3")
+static inline bool _decode_lookup_ssse3(__m128i in, bool url, __m128i *out)
+{
+    const __m128i c62 = _mm_set1_epi8(url ? '-' : '+');
+    const __m128i c63 = _mm_set1_epi8(url ? '_' : '/');
+
+    // (signed compares also reject anything >= 0x80)
+    const __m128i upper = _mm_and_si128(
+            _mm_cmpgt_epi8(in, _mm_set1_epi8('A' - 1)),
+            _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), in));
+    const __m128i lower = _mm_and_si128(
+            _mm_cmpgt_epi8(in, _mm_set1_epi8('a' - 1)),
+            _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), in));
+    const __m128i digit = _mm_and_si128(
+            _mm_cmpgt_epi8(in, _mm_set1_epi8('0' - 1)),
+            _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), in));
+    const __m128i is62 = _mm_cmpeq_epi8(in, c62);
+    const __m128i is63 = _mm_cmpeq_epi8(in, c63);
+
+    const __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower),
+            _mm_or_si128(digit, _mm_or_si128(is62, is63)));
+    if (0xffff != _mm_movemask_epi8(valid))
     {
-        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
         return false;
     }
 
-    // return empty string on 0 length input
-    if (0 == inlen)
+    __m128i offset = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+    offset = _mm_or_si128(offset,
+            _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+    offset = _mm_or_si128(offset,
+            _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+    offset = _mm_or_si128(offset,
+            _mm_and_si128(is62, _mm_sub_epi8(_mm_set1_epi8(62), c62)));
+    offset = _mm_or_si128(offset,
+            _mm_and_si128(is63, _mm_sub_epi8(_mm_set1_epi8(63), c63)));
+
+    *out = _mm_add_epi8(in, offset);
+    return true;
+}
+
+CJOSE_B64_TARGET("ssse3")
+static size_t _decode_ssse3(const char *input, size_t inlen,
+                            uint8_t *output, size_t outcap, bool url)
+{
+    size_t  idx = 0, pos = 0;
+
+    // 16 characters in, 12 bytes out; each store writes 16 bytes
+    while ((idx + 16) <= inlen && (pos + 16) <= outcap)
     {
-        uint8_t *retVal = (uint8_t *)malloc(sizeof(uint8_t));
-        if (NULL == retVal)
+        __m128i values;
+        __m128i in = _mm_loadu_si128((const __m128i *)(input + idx));
+        if (!_decode_lookup_ssse3(in, url, &values))
         {
-            CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
-            return false;
+            break;
         }
 
-        retVal[0] = 0;
-        *output = retVal;
-        *outlen = 0;
-        return true;
+        // pack four 6-bit values into 24 bits, then drop the padding byte
+        values = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        values = _mm_madd_epi16(values, _mm_set1_epi32(0x00011000));
+        values = _mm_shuffle_epi8(values, _mm_setr_epi8(
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+        _mm_storeu_si128((__m128i *)(output + pos), values);
+        idx += 16;
+        pos += 12;
     }
 
-    // extra validation -- inlen is a multiple of 4
-    if ((!url && 0 != (inlen % 4)) || (inlen%4 == 1))
+    return idx;
+}
+
+CJOSE_B64_TARGET("avx2")
+static size_t _decode_avx2(const char *input, size_t inlen,
+                           uint8_t *output, size_t outcap, bool url)
+{
+    size_t  idx = 0, pos = 0;
+
+    const __m256i c62 = _mm256_set1_epi8(url ? '-' : '+');
+    const __m256i c63 = _mm256_set1_epi8(url ? '_' : '/');
+    const __m256i shuf = _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    // 32 characters in, 24 bytes out; each store writes 32 bytes
+    while ((idx + 32) <= inlen && (pos + 32) <= outcap)
+    {
+        const __m256i in = _mm256_loadu_si256((const __m256i *)(input + idx));
+
+        const __m256i upper = _mm256_and_si256(
+                _mm256_cmpgt_epi8(in, _mm256_set1_epi8('A' - 1)),
+                _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), in));
+        const __m256i lower = _mm256_and_si256(
+                _mm256_cmpgt_epi8(in, _mm256_set1_epi8('a' - 1)),
+                _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), in));
+        const __m256i digit = _mm256_and_si256(
+                _mm256_cmpgt_epi8(in, _mm256_set1_epi8('0' - 1)),
+                _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), in));
+        const __m256i is62 = _mm256_cmpeq_epi8(in, c62);
+        const __m256i is63 = _mm256_cmpeq_epi8(in, c63);
+
+        const __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower),
+                _mm256_or_si256(digit, _mm256_or_si256(is62, is63)));
+        if (-1 != _mm256_movemask_epi8(valid))
+        {
+            break;
+        }
+
+        __m256i offset = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+        offset = _mm256_or_si256(offset,
+                _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+        offset = _mm256_or_si256(offset,
+                _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+        offset = _mm256_or_si256(offset, _mm256_and_si256(
+                is62, _mm256_sub_epi8(_mm256_set1_epi8(62), c62)));
+        offset = _mm256_or_si256(offset, _mm256_and_si256(
+                is63, _mm256_sub_epi8(_mm256_set1_epi8(63), c63)));
+        __m256i values = _mm256_add_epi8(in, offset);
+
+        // pack 6-bit values into 24-bit groups, 12 bytes at the bottom of
+        // each lane, then move them together
+        values = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        values = _mm256_madd_epi16(values, _mm256_set1_epi32(0x00011000));
+        values = _mm256_shuffle_epi8(values, shuf);
+        values = _mm256_permutevar8x32_epi32(values,
+                _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+
+        _mm256_storeu_si256((__m256i *)(output + pos), values);
+        idx += 32;
+        pos += 24;
+    }
+
+    // finish what we can with 128-bit registers
+    return idx + _decode_ssse3(
+            input + idx, inlen - idx, output + pos, outcap - pos, url);
+}
+
+#endif // CJOSE_B64_SIMD
+
+// Encodes as many whole 3-byte groups as the available vector unit can
+// handle, returning the number of input bytes consumed (a multiple of 3).
+// The caller encodes the remainder with the scalar loop.
+static inline size_t _encode_blocks(const uint8_t *input, size_t inlen,
+                                    char *output, bool url)
+{
+#ifdef CJOSE_B64_SIMD
+    const int features = _get_cpu_features();
+    if (features & CJOSE_CPU_AVX2)
+    {
+        return _encode_avx2(input, inlen, output, url);
+    }
+    if (features & CJOSE_CPU_SSSE3)
+    {
+        return _encode_ssse3(input, inlen, output, url);
+    }
+#endif
+    return 0;
+}
+
+// Decodes as many whole 4-character groups as the available vector unit
+// can handle, returning the number of characters consumed (a multiple of 4).
+// Vector stores may write past the decoded bytes, but never past outcap.
+// Decoding stops short of any block containing a character outside of the
+// alphabet (including padding); the scalar loop picks up from there and
+// reports errors exactly as if it had decoded everything itself.
+static inline size_t _decode_blocks(const char *input, size_t inlen,
+                                    uint8_t *output, size_t outcap, bool url)
+{
+#ifdef CJOSE_B64_SIMD
+    const int features = _get_cpu_features();
+    if (features & CJOSE_CPU_AVX2)
+    {
+        return _decode_avx2(input, inlen, output, outcap, url);
+    }
+    if (features & CJOSE_CPU_SSSE3)
+    {
+        return _decode_ssse3(input, inlen, output, outcap, url);
+    }
+#endif
+    return 0;
+}
+
+// internal functions
+
+static inline size_t _encoded_len(size_t inlen, bool url)
+{
+    if (url)
+    {
+        // no padding: 2 chars for 1 remaining byte, 3 chars for 2
+        return ((inlen / 3) << 2) + ((inlen % 3) ? (inlen % 3) + 1 : 0);
+    }
+    return ((inlen + 2) / 3) << 2;
+}
+
+static inline size_t _decoded_max_len(size_t inlen)
+{
+    // exact for unpadded input; padding only makes the result shorter
+    return ((inlen >> 2) * 3) + ((inlen % 4) ? (inlen % 4) - 1 : 0);
+}
+
+static inline bool _decode_into(const char *input, size_t inlen,
+                                uint8_t *output, size_t outcap,
+                                size_t *outlen, bool url, cjose_err *err)
+{
+    if ((NULL == input) || (NULL == outlen) ||
+        (NULL == output && 0 < outcap))
     {
         CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
         return false;
     }
 
-    // rlen takes a best guess on size;
-    // might be too large for base64url, but never too small.
-    size_t  rlen = ((inlen * 3) >> 2) + 3;
-    uint8_t *buffer = malloc(sizeof(uint8_t) * rlen);
-    if (NULL == buffer)
+    // nothing to write on 0 length input
+    if (0 == inlen)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        *outlen = 0;
+        return true;
+    }
+
+    // extra validation -- inlen is a multiple of 4
+    if ((!url && 0 != (inlen % 4)) || (inlen%4 == 1))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
         return false;
     }
 
-    size_t      idx = 0;
-    size_t      pos = 0;
+    size_t      idx = _decode_blocks(input, inlen, output, outcap, url);
+    size_t      pos = (idx >> 2) * 3;
     size_t      shift = 0;
     uint32_t    packed = 0;
     while (inlen > idx)
@@ -118,19 +497,18 @@ static inline bool _decode(const char *input, size_t inlen,
         else if (url && ('+' == val || '/' == val))
         {
             CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-            goto b64_decode_failed;
+            return false;
         }
         else if (!url && ('-' == val || '_' == val))
         {
             CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-            goto b64_decode_failed;
+            return false;
         }
 
         val = TEBAHPLA_B64[val];
         if (0xff == val)
         {
             CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-            free(buffer);
             return false;
         }
         idx++;
@@ -138,9 +516,14 @@ static inline bool _decode(const char *input, size_t inlen,
         packed = packed | (val << (18 - (6 * shift++)));
         if (4 == shift)
         {
-            buffer[pos++] = (packed >> 16) & 0xff;
-            buffer[pos++] = (packed >> 8) & 0xff;
-            buffer[pos++] = packed & 0xff;
+            if ((pos + 3) > outcap)
+            {
+                CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+                return false;
+            }
+            output[pos++] = (packed >> 16) & 0xff;
+            output[pos++] = (packed >> 8) & 0xff;
+            output[pos++] = packed & 0xff;
             shift = 0;
             packed = 0;
         }
@@ -149,67 +532,99 @@ static inline bool _decode(const char *input, size_t inlen,
     assert(shift != 1);
     assert(shift != 4);
 
+    if ((shift > 1) && (pos + shift - 1) > outcap)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
     if (shift == 3)
     {
-        buffer[pos++] = (packed >> 16) & 0xff;
-        buffer[pos++] = (packed >> 8) & 0xff;
+        output[pos++] = (packed >> 16) & 0xff;
+        output[pos++] = (packed >> 8) & 0xff;
     }
 
     if (shift == 2)
     {
-        buffer[pos++] = (packed >> 16) & 0xff;
+        output[pos++] = (packed >> 16) & 0xff;
     }
 
-    *output = buffer;
     *outlen = pos;
-    assert(*outlen <= rlen);
     return true;
-
-    b64_decode_failed:
-    if (NULL != buffer)
-    {
-        free(buffer);
-    }
-    return false;
 }
 
-static inline bool _encode(const uint8_t *input, size_t inlen,
-                         char **output, size_t *outlen,
-                         const char *alphabet, cjose_err *err)
+static inline bool _decode(const char *input, size_t inlen,
+                           uint8_t **output, size_t *outlen,
+                           bool url, cjose_err *err)
 {
-    if ((inlen > 0 && NULL == input) || (NULL == output) || (NULL == outlen))
+    if ((NULL == input) || (NULL == output) || (NULL == outlen))
     {
         CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
         return false;
     }
 
     // return empty string on 0 length input
-    if (!inlen)
+    if (0 == inlen)
     {
-        char * retVal = (char *)malloc(sizeof(char));
-        if (!retVal)
+        uint8_t *retVal = (uint8_t *)malloc(sizeof(uint8_t));
+        if (NULL == retVal)
         {
             CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
             return false;
         }
-        retVal[0] = '\0';
+
+        retVal[0] = 0;
         *output = retVal;
         *outlen = 0;
         return true;
     }
 
-    const bool      padit = (ALPHABET_B64 == alphabet);
-    size_t          rlen = (((inlen + 2) / 3) << 2);
-    char            *base;
+    // extra validation -- inlen is a multiple of 4
+    if ((!url && 0 != (inlen % 4)) || (inlen%4 == 1))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
 
-    base = (char *)malloc(sizeof(char) * (rlen+1));
-    if (NULL == base)
+    // rlen is exact for base64url, and never too small for base64
+    size_t  rlen = _decoded_max_len(inlen);
+    uint8_t *buffer = malloc(sizeof(uint8_t) * rlen);
+    if (NULL == buffer)
     {
         CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
         return false;
     }
 
-    size_t  pos = 0, idx = 0;
+    if (!_decode_into(input, inlen, buffer, rlen, outlen, url, err))
+    {
+        free(buffer);
+        return false;
+    }
+
+    *output = buffer;
+    assert(*outlen <= rlen);
+    return true;
+}
+
+static inline bool _encode_into(const uint8_t *input, size_t inlen,
+                                char *output, size_t outcap,
+                                size_t *outlen, bool url, cjose_err *err)
+{
+    const size_t    rlen = _encoded_len(inlen, url);
+
+    if ((inlen > 0 && NULL == input) || (NULL == outlen) ||
+        (NULL == output && 0 < rlen) || (outcap < rlen))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    const char      *alphabet = url ? ALPHABET_B64U : ALPHABET_B64;
+    const bool      padit = !url;
+    char            *base = output;
+
+    size_t  idx = _encode_blocks(input, inlen, base, url);
+    size_t  pos = (idx / 3) << 2;
     while ((idx + 2) < inlen)
     {
         base[pos++] = alphabet[0x3f & (input[idx] >> 2)];
@@ -241,12 +656,56 @@ static inline bool _encode(const uint8_t *input, size_t inlen,
                 base[pos++] = '=';
             }
         }
-        rlen = pos;
+    }
+    assert(pos == rlen);
+
+    *outlen = rlen;
+    return true;
+}
+
+static inline bool _encode(const uint8_t *input, size_t inlen,
+                         char **output, size_t *outlen,
+                         bool url, cjose_err *err)
+{
+    if ((inlen > 0 && NULL == input) || (NULL == output) || (NULL == outlen))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // return empty string on 0 length input
+    if (!inlen)
+    {
+        char * retVal = (char *)malloc(sizeof(char));
+        if (!retVal)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+            return false;
+        }
+        retVal[0] = '\0';
+        *output = retVal;
+        *outlen = 0;
+        return true;
+    }
+
+    size_t          rlen = _encoded_len(inlen, url);
+    char            *base;
+
+    base = (char *)malloc(sizeof(char) * (rlen+1));
+    if (NULL == base)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return false;
+    }
+
+    if (!_encode_into(input, inlen, base, rlen, outlen, url, err))
+    {
+        free(base);
+        return false;
     }
     base[rlen] = '\0';
 
     *output = base;
-    *outlen = rlen;
     return true;
 }
 
@@ -255,12 +714,12 @@ static inline bool _encode(const uint8_t *input, size_t inlen,
 bool cjose_base64_encode(const uint8_t *input, size_t inlen,
                          char **output, size_t *outlen, cjose_err *err)
 {
-    return _encode(input, inlen, output, outlen, ALPHABET_B64, err);
+    return _encode(input, inlen, output, outlen, false, err);
 }
 bool cjose_base64url_encode(const uint8_t *input, size_t inlen,
                             char **output, size_t *outlen, cjose_err *err)
 {
-    return _encode(input, inlen, output, outlen, ALPHABET_B64U, err);
+    return _encode(input, inlen, output, outlen, true, err);
 }
 
 bool cjose_base64_decode(const char *input, size_t inlen,
@@ -273,3 +732,440 @@ bool cjose_base64url_decode(const char *input, size_t inlen,
 {
     return _decode(input, inlen, output, outlen, true, err);
 }
+
+size_t cjose_base64_encoded_len(size_t inlen)
+{
+    return _encoded_len(inlen, false);
+}
+size_t cjose_base64url_encoded_len(size_t inlen)
+{
+    return _encoded_len(inlen, true);
+}
+
+size_t cjose_base64_decoded_max_len(size_t inlen)
+{
+    return _decoded_max_len(inlen);
+}
+size_t cjose_base64url_decoded_max_len(size_t inlen)
+{
+    return _decoded_max_len(inlen);
+}
+
+bool cjose_base64_encode_into(const uint8_t *input, size_t inlen,
+                              char *output, size_t outcap,
+                              size_t *outlen, cjose_err *err)
+{
+    return _encode_into(input, inlen, output, outcap, outlen, false, err);
+}
+bool cjose_base64url_encode_into(const uint8_t *input, size_t inlen,
+                                 char *output, size_t outcap,
+                                 size_t *outlen, cjose_err *err)
+{
+    return _encode_into(input, inlen, output, outcap, outlen, true, err);
+}
+
+bool cjose_base64_decode_into(const char *input, size_t inlen,
+                              uint8_t *output, size_t outcap,
+                              size_t *outlen, cjose_err *err)
+{
+    return _decode_into(input, inlen, output, outcap, outlen, false, err);
+}
+bool cjose_base64url_decode_into(const char *input, size_t inlen,
+                                 uint8_t *output, size_t outcap,
+                                 size_t *outlen, cjose_err *err)
+{
+    return _decode_into(input, inlen, output, outcap, outlen, true, err);
+}
+
+bool cjose_base64url_decode_inplace(char *buf, size_t len, size_t *outlen,
+                                    cjose_err *err)
+{
+    // every decoder loads a block before storing it, and the write position
+    // (3 bytes per 4 characters) never passes the next unread character, so
+    // the output may alias the input
+    return _decode_into(buf, len, (uint8_t *)buf, len, outlen, true, err);
+}
+
+// threads used for large payloads by the library's own encode/decode calls
+static size_t _parallel_threads = 1;
+
+void cjose_base64_set_parallel_threads(size_t threads)
+{
+    _parallel_threads = threads;
+}
+
+size_t cjose_base64_get_parallel_threads()
+{
+    return _parallel_threads;
+}
+
+// number of slices to split len bytes of input into, for the given thread
+// count (0 = one per processor); slices are kept to at least a quarter of
+// CJOSE_BASE64_PARALLEL_MIN so that the threads pay for themselves
+static size_t _parallel_slices(size_t len, size_t threads)
+{
+    if (len < CJOSE_BASE64_PARALLEL_MIN)
+    {
+        return 1;
+    }
+    if (0 == threads || CJOSE_PARALLEL_MAX < threads)
+    {
+        threads = (0 == threads) ? _cjose_cpu_count() : CJOSE_PARALLEL_MAX;
+    }
+
+    const size_t    most = len / (CJOSE_BASE64_PARALLEL_MIN / 4);
+    return (threads < most) ? threads : most;
+}
+
+typedef struct
+{
+    const uint8_t   *input;
+    size_t          inlen;
+    char            *output;
+    size_t          slice;      // input octets per slice, a multiple of 3
+} _b64_encode_job;
+
+static void _encode_slice(void *arg, size_t idx)
+{
+    _b64_encode_job *job = (_b64_encode_job *)arg;
+    const size_t    off = idx * job->slice;
+    const size_t    len = (job->inlen - off < job->slice) ?
+                          job->inlen - off : job->slice;
+    size_t          outlen = 0;
+
+    // only the final slice can end in a partial group
+    _encode_into(job->input + off, len, job->output + (off / 3) * 4,
+                 _encoded_len(len, true), &outlen, true, NULL);
+}
+
+bool cjose_base64url_encode_parallel_into(const uint8_t *input, size_t inlen,
+                                          char *output, size_t outcap,
+                                          size_t *outlen, size_t threads,
+                                          cjose_err *err)
+{
+    size_t  slices = _parallel_slices(inlen, threads);
+    if (1 >= slices)
+    {
+        return _encode_into(input, inlen, output, outcap, outlen, true, err);
+    }
+
+    const size_t    rlen = _encoded_len(inlen, true);
+    if ((NULL == input) || (NULL == output) || (NULL == outlen) ||
+        (outcap < rlen))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    _b64_encode_job job;
+    job.input = input;
+    job.inlen = inlen;
+    job.output = output;
+    job.slice = (inlen / slices + 2) / 3 * 3;
+    slices = (inlen + job.slice - 1) / job.slice;
+
+    _cjose_parallel_run(slices, _encode_slice, &job);
+
+    *outlen = rlen;
+    return true;
+}
+
+bool cjose_base64url_encode_parallel(const uint8_t *input, size_t inlen,
+                                     char **output, size_t *outlen,
+                                     size_t threads, cjose_err *err)
+{
+    size_t  slices = _parallel_slices(inlen, threads);
+    if (1 >= slices)
+    {
+        return _encode(input, inlen, output, outlen, true, err);
+    }
+    if ((NULL == input) || (NULL == output) || (NULL == outlen))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    const size_t    rlen = _encoded_len(inlen, true);
+    char            *result = (char *)malloc(sizeof(char) * (rlen + 1));
+    if (NULL == result)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return false;
+    }
+
+    if (!cjose_base64url_encode_parallel_into(input, inlen, result, rlen,
+                                              outlen, threads, err))
+    {
+        free(result);
+        return false;
+    }
+    result[rlen] = '\0';
+
+    *output = result;
+    return true;
+}
+
+typedef struct
+{
+    const char      *input;
+    size_t          inlen;
+    uint8_t         *output;
+    size_t          slice;      // input characters per slice, a multiple of 4
+    bool            ok[CJOSE_PARALLEL_MAX];
+    size_t          outlen[CJOSE_PARALLEL_MAX];
+} _b64_decode_job;
+
+static void _decode_slice(void *arg, size_t idx)
+{
+    _b64_decode_job *job = (_b64_decode_job *)arg;
+    const size_t    off = idx * job->slice;
+    const size_t    len = (job->inlen - off < job->slice) ?
+                          job->inlen - off : job->slice;
+
+    job->ok[idx] = _decode_into(job->input + off, len,
+                                job->output + (off / 4) * 3,
+                                _decoded_max_len(len), &job->outlen[idx],
+                                true, NULL);
+}
+
+bool cjose_base64url_decode_parallel(const char *input, size_t inlen,
+                                     uint8_t **output, size_t *outlen,
+                                     size_t threads, cjose_err *err)
+{
+    size_t  slices = _parallel_slices(inlen, threads);
+    if (1 >= slices)
+    {
+        return _decode(input, inlen, output, outlen, true, err);
+    }
+    if ((NULL == input) || (NULL == output) || (NULL == outlen) ||
+        (1 == inlen % 4))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    _b64_decode_job job;
+    job.input = input;
+    job.inlen = inlen;
+    job.slice = (inlen / slices + 3) / 4 * 4;
+    slices = (inlen + job.slice - 1) / job.slice;
+
+    job.output = (uint8_t *)malloc(sizeof(uint8_t) * _decoded_max_len(inlen));
+    if (NULL == job.output)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return false;
+    }
+
+    _cjose_parallel_run(slices, _decode_slice, &job);
+
+    // match the serial decoder: fail on a bad character, but stop at the
+    // slice where padding ended the input early and ignore what follows
+    size_t  total = 0;
+    for (size_t idx = 0; idx < slices; ++idx)
+    {
+        if (!job.ok[idx])
+        {
+            free(job.output);
+            CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+            return false;
+        }
+        total = (idx * job.slice / 4) * 3 + job.outlen[idx];
+        if (job.outlen[idx] < (job.slice / 4) * 3)
+        {
+            break;
+        }
+    }
+
+    *output = job.output;
+    *outlen = total;
+    return true;
+}
+
+void cjose_base64url_encoder_init(cjose_base64url_encoder_t *enc)
+{
+    if (NULL != enc)
+    {
+        memset(enc, 0, sizeof(cjose_base64url_encoder_t));
+    }
+}
+
+bool cjose_base64url_encoder_update(cjose_base64url_encoder_t *enc,
+                                    const uint8_t *input, size_t inlen,
+                                    char *output, size_t outcap,
+                                    size_t *outlen, cjose_err *err)
+{
+    if ((NULL == enc) || (inlen > 0 && NULL == input) || (NULL == outlen))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    size_t  taken = 0, pos = 0, len = 0;
+
+    // not enough for a whole group yet
+    if ((enc->pending_len + inlen) < 3)
+    {
+        if (0 < inlen)
+        {
+            memcpy(enc->pending + enc->pending_len, input, inlen);
+            enc->pending_len += inlen;
+        }
+        *outlen = 0;
+        return true;
+    }
+
+    // complete the group carried over from the previous call
+    if (0 < enc->pending_len)
+    {
+        uint8_t group[3];
+        memcpy(group, enc->pending, enc->pending_len);
+        taken = 3 - enc->pending_len;
+        memcpy(group + enc->pending_len, input, taken);
+        if (!_encode_into(group, 3, output, outcap, &len, true, err))
+        {
+            return false;
+        }
+        pos = len;
+        enc->pending_len = 0;
+    }
+
+    // encode all whole groups, and carry over the rest
+    size_t  whole = ((inlen - taken) / 3) * 3;
+    if (!_encode_into(input + taken, whole,
+            output + pos, outcap - pos, &len, true, err))
+    {
+        return false;
+    }
+    pos += len;
+    taken += whole;
+
+    enc->pending_len = inlen - taken;
+    memcpy(enc->pending, input + taken, enc->pending_len);
+
+    *outlen = pos;
+    return true;
+}
+
+bool cjose_base64url_encoder_final(cjose_base64url_encoder_t *enc,
+                                   char *output, size_t outcap,
+                                   size_t *outlen, cjose_err *err)
+{
+    if ((NULL == enc) || (NULL == outlen))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    if (!_encode_into(enc->pending, enc->pending_len,
+            output, outcap, outlen, true, err))
+    {
+        return false;
+    }
+
+    enc->pending_len = 0;
+    return true;
+}
+
+void cjose_base64url_decoder_init(cjose_base64url_decoder_t *dec)
+{
+    if (NULL != dec)
+    {
+        memset(dec, 0, sizeof(cjose_base64url_decoder_t));
+    }
+}
+
+// decodes whole groups, rejecting the padding that _decode_into stops at
+static inline bool _decode_groups(const char *input, size_t inlen,
+                                  uint8_t *output, size_t outcap,
+                                  size_t *outlen, cjose_err *err)
+{
+    if (!_decode_into(input, inlen, output, outcap, outlen, true, err))
+    {
+        return false;
+    }
+    if (*outlen != _decoded_max_len(inlen))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+    return true;
+}
+
+bool cjose_base64url_decoder_update(cjose_base64url_decoder_t *dec,
+                                    const char *input, size_t inlen,
+                                    uint8_t *output, size_t outcap,
+                                    size_t *outlen, cjose_err *err)
+{
+    if ((NULL == dec) || (inlen > 0 && NULL == input) || (NULL == outlen))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    size_t  taken = 0, pos = 0, len = 0;
+
+    // not enough for a whole group yet
+    if ((dec->pending_len + inlen) < 4)
+    {
+        if (0 < inlen)
+        {
+            memcpy(dec->pending + dec->pending_len, input, inlen);
+            dec->pending_len += inlen;
+        }
+        *outlen = 0;
+        return true;
+    }
+
+    // complete the group carried over from the previous call
+    if (0 < dec->pending_len)
+    {
+        char group[4];
+        memcpy(group, dec->pending, dec->pending_len);
+        taken = 4 - dec->pending_len;
+        memcpy(group + dec->pending_len, input, taken);
+        if (!_decode_groups(group, 4, output, outcap, &len, err))
+        {
+            return false;
+        }
+        pos = len;
+        dec->pending_len = 0;
+    }
+
+    // decode all whole groups, and carry over the rest
+    size_t  whole = ((inlen - taken) >> 2) << 2;
+    if (0 < whole && !_decode_groups(input + taken, whole,
+            output + pos, outcap - pos, &len, err))
+    {
+        return false;
+    }
+    pos += (0 < whole) ? len : 0;
+    taken += whole;
+
+    dec->pending_len = inlen - taken;
+    memcpy(dec->pending, input + taken, dec->pending_len);
+
+    *outlen = pos;
+    return true;
+}
+
+bool cjose_base64url_decoder_final(cjose_base64url_decoder_t *dec,
+                                   uint8_t *output, size_t outcap,
+                                   size_t *outlen, cjose_err *err)
+{
+    if ((NULL == dec) || (NULL == outlen))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // (a single left over character is rejected by _decode_into)
+    if (!_decode_groups(dec->pending, dec->pending_len,
+            output, outcap, outlen, err))
+    {
+        return false;
+    }
+
+    dec->pending_len = 0;
+    return true;
+}
@@ -0,0 +1,276 @@
+/*!
+ * Copyrights
+ *
+ * Portions created or assigned to Cisco Systems, Inc. are
+ * Copyright (c) 2014-2016 Cisco Systems, Inc.  All Rights Reserved.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+#include "cjose/jws.h"
+#include "include/cache_int.h"
+#include "include/jwk_int.h"
+#include "include/thread_int.h"
+
+
+// one verified signature
+typedef struct _cache_entry_int
+{
+    uint8_t key[CJOSE_CACHE_KEY_LEN];   // hash of digest and signature
+    const cjose_jwk_t *jwk;             // key it verified with, NULL if free
+    bool ref;                           // looked up since the hand passed
+} _cache_entry;
+
+
+// a part of the cache with its own lock: sets of CJOSE_CACHE_WAYS entries,
+// each with a CLOCK hand
+typedef struct _cache_shard_int
+{
+    _cjose_mutex *mutex;
+    size_t sets;
+    _cache_entry *entries;
+    uint8_t *hands;
+} _cache_shard;
+
+
+typedef struct _verify_cache_int
+{
+    _cache_shard shards[CJOSE_CACHE_SHARDS];
+} _verify_cache;
+
+
+// the verify cache, NULL while it is disabled
+static _verify_cache *_cache = NULL;
+
+
+////////////////////////////////////////////////////////////////////////////////
+static void _cjose_cache_free(_verify_cache *cache)
+{
+    if (NULL == cache)
+    {
+        return;
+    }
+    for (size_t i = 0; i < CJOSE_CACHE_SHARDS; ++i)
+    {
+        _cjose_mutex_free(cache->shards[i].mutex);
+        free(cache->shards[i].entries);
+        free(cache->shards[i].hands);
+    }
+    free(cache);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static _verify_cache *_cjose_cache_new(size_t entries, cjose_err *err)
+{
+    _verify_cache *cache = (_verify_cache *)calloc(1, sizeof(_verify_cache));
+    if (NULL == cache)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return NULL;
+    }
+
+    // round up to whole sets in every shard
+    size_t sets = 1 + (entries - 1) / (CJOSE_CACHE_SHARDS * CJOSE_CACHE_WAYS);
+    for (size_t i = 0; i < CJOSE_CACHE_SHARDS; ++i)
+    {
+        _cache_shard *shard = &cache->shards[i];
+        shard->sets = sets;
+        shard->mutex = _cjose_mutex_new();
+        shard->entries = (_cache_entry *)calloc(
+                sets * CJOSE_CACHE_WAYS, sizeof(_cache_entry));
+        shard->hands = (uint8_t *)calloc(sets, sizeof(uint8_t));
+        if (NULL == shard->mutex || NULL == shard->entries ||
+                NULL == shard->hands)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+            _cjose_cache_free(cache);
+            return NULL;
+        }
+    }
+
+    return cache;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_set_verify_cache(size_t entries, cjose_err *err)
+{
+    _verify_cache *cache = NULL;
+    if (0 < entries)
+    {
+        cache = _cjose_cache_new(entries, err);
+        if (NULL == cache)
+        {
+            return false;
+        }
+    }
+
+    _cjose_cache_free(_cache);
+    _cache = cache;
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool _cjose_cache_enabled()
+{
+    return (NULL != _cache);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool _cjose_cache_key(
+        const uint8_t *dig,
+        size_t dig_len,
+        const uint8_t *sig,
+        size_t sig_len,
+        uint8_t *key,
+        cjose_err *err)
+{
+    bool retval = false;
+
+    // the digest covers the header (and so the algorithm) and the payload
+    EVP_MD_CTX *ctx = EVP_MD_CTX_create();
+    if (NULL == ctx)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        return false;
+    }
+    if (EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1 ||
+            EVP_DigestUpdate(ctx, dig, dig_len) != 1 ||
+            EVP_DigestUpdate(ctx, sig, sig_len) != 1 ||
+            EVP_DigestFinal_ex(ctx, key, NULL) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_cache_key_cleanup;
+    }
+
+    retval = true;
+
+    _cjose_cache_key_cleanup:
+    EVP_MD_CTX_destroy(ctx);
+
+    return retval;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static _cache_shard *_cjose_cache_locate(const uint8_t *key, _cache_entry **set)
+{
+    // the key is a hash, so any of its bytes spread entries evenly
+    _cache_shard *shard = &_cache->shards[key[0] % CJOSE_CACHE_SHARDS];
+    uint32_t h = (uint32_t)key[1] | (uint32_t)key[2] << 8 |
+            (uint32_t)key[3] << 16 | (uint32_t)key[4] << 24;
+    *set = shard->entries + (h % shard->sets) * CJOSE_CACHE_WAYS;
+    return shard;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static _cache_entry *_cjose_cache_find(
+        _cache_entry *set, const uint8_t *key, const cjose_jwk_t *jwk)
+{
+    for (size_t way = 0; way < CJOSE_CACHE_WAYS; ++way)
+    {
+        if (jwk == set[way].jwk &&
+                memcmp(key, set[way].key, CJOSE_CACHE_KEY_LEN) == 0)
+        {
+            return &set[way];
+        }
+    }
+    return NULL;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool _cjose_cache_lookup(const uint8_t *key, const cjose_jwk_t *jwk)
+{
+    _cache_entry *set = NULL;
+    _cache_shard *shard = _cjose_cache_locate(key, &set);
+
+    _cjose_mutex_lock(shard->mutex);
+    _cache_entry *entry = _cjose_cache_find(set, key, jwk);
+    if (NULL != entry)
+    {
+        entry->ref = true;
+    }
+    _cjose_mutex_unlock(shard->mutex);
+
+    return (NULL != entry);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+void _cjose_cache_insert(const uint8_t *key, const cjose_jwk_t *jwk)
+{
+    _cache_entry *set = NULL;
+    _cache_shard *shard = _cjose_cache_locate(key, &set);
+    size_t idx = (set - shard->entries) / CJOSE_CACHE_WAYS;
+
+    _cjose_mutex_lock(shard->mutex);
+
+    // another thread may have just verified the same token
+    _cache_entry *entry = _cjose_cache_find(set, key, jwk);
+    if (NULL == entry)
+    {
+        // take the first free entry, or else the first the CLOCK hand finds
+        // that has not been looked up since it last passed
+        for (size_t way = 0; way < CJOSE_CACHE_WAYS && NULL == entry; ++way)
+        {
+            if (NULL == set[way].jwk)
+            {
+                entry = &set[way];
+            }
+        }
+        while (NULL == entry)
+        {
+            _cache_entry *next = &set[shard->hands[idx]];
+            shard->hands[idx] = (shard->hands[idx] + 1) % CJOSE_CACHE_WAYS;
+            if (next->ref)
+            {
+                next->ref = false;
+            }
+            else
+            {
+                entry = next;
+            }
+        }
+
+        memcpy(entry->key, key, CJOSE_CACHE_KEY_LEN);
+        entry->jwk = jwk;
+        entry->ref = false;
+
+        // the key must drop its entries when it is freed
+        ((cjose_jwk_t *)jwk)->cached = true;
+    }
+
+    _cjose_mutex_unlock(shard->mutex);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+void _cjose_cache_forget(const cjose_jwk_t *jwk)
+{
+    if (NULL == _cache)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < CJOSE_CACHE_SHARDS; ++i)
+    {
+        _cache_shard *shard = &_cache->shards[i];
+        _cjose_mutex_lock(shard->mutex);
+        for (size_t e = 0; e < shard->sets * CJOSE_CACHE_WAYS; ++e)
+        {
+            if (jwk == shard->entries[e].jwk)
+            {
+                shard->entries[e].jwk = NULL;
+                shard->entries[e].ref = false;
+            }
+        }
+        _cjose_mutex_unlock(shard->mutex);
+    }
+}
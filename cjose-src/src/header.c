@@ -7,6 +7,7 @@
 
 
 #include <stdlib.h>
+#include <string.h>
 #include <jansson.h>
 #include "cjose/header.h"
 #include "include/header_int.h"
@@ -17,6 +18,12 @@ const char *CJOSE_HDR_ALG_RSA_OAEP = "RSA-OAEP";
 const char *CJOSE_HDR_ALG_DIR = "dir";
 const char *CJOSE_HDR_ALG_PS256 = "PS256";
 const char *CJOSE_HDR_ALG_RS256 = "RS256";
+const char *CJOSE_HDR_ALG_ES256 = "ES256";
+const char *CJOSE_HDR_ALG_ES384 = "ES384";
+const char *CJOSE_HDR_ALG_ES512 = "ES512";
+const char *CJOSE_HDR_ALG_HS256 = "HS256";
+const char *CJOSE_HDR_ALG_HS384 = "HS384";
+const char *CJOSE_HDR_ALG_HS512 = "HS512";
 
 const char *CJOSE_HDR_ENC = "enc";
 const char *CJOSE_HDR_ENC_A256GCM = "A256GCM";
@@ -24,6 +31,8 @@ const char *CJOSE_HDR_ENC_A256GCM = "A256GCM";
 const char *CJOSE_HDR_CTY = "cty";
 
 const char *CJOSE_HDR_KID = "kid";
+const char *CJOSE_HDR_B64 = "b64";
+const char *CJOSE_HDR_CRIT = "crit";
 
 ////////////////////////////////////////////////////////////////////////////////
 cjose_header_t *cjose_header_new(
@@ -98,3 +107,58 @@ const char *cjose_header_get(
 
     return json_string_value(value_obj);
 }
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_header_set_b64(
+        cjose_header_t *header,
+        bool b64,
+        cjose_err *err)
+{
+    if (NULL == header)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    if (json_object_set_new(header, CJOSE_HDR_B64, json_boolean(b64)) != 0)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return false;
+    }
+
+    // "b64" changes how the JWS is signed, so it must be listed as critical
+    // for a recipient that does not understand it to reject the JWS
+    json_t *crit = json_object_get(header, CJOSE_HDR_CRIT);
+    if (NULL != crit && !json_is_array(crit))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+    bool listed = false;
+    for (size_t i = 0; NULL != crit && i < json_array_size(crit); ++i)
+    {
+        const char *name = json_string_value(json_array_get(crit, i));
+        listed = listed || (NULL != name && strcmp(name, CJOSE_HDR_B64) == 0);
+    }
+    if (!listed)
+    {
+        if (NULL == crit)
+        {
+            crit = json_array();
+            if (NULL == crit || json_object_set_new(
+                    header, CJOSE_HDR_CRIT, crit) != 0)
+            {
+                CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+                return false;
+            }
+        }
+        if (json_array_append_new(crit, json_string(CJOSE_HDR_B64)) != 0)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,50 @@
+/*!
+ * Copyrights
+ *
+ * Portions created or assigned to Cisco Systems, Inc. are
+ * Copyright (c) 2014-2016 Cisco Systems, Inc.  All Rights Reserved.
+ */
+
+#ifndef SRC_CACHE_INT_H
+#define SRC_CACHE_INT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "cjose/jwk.h"
+#include "cjose/error.h"
+
+// length of the key an entry of the verify cache is looked up by
+#define CJOSE_CACHE_KEY_LEN 32
+
+// independently locked parts of the verify cache, so that threads verifying
+// different tokens seldom wait on each other
+#define CJOSE_CACHE_SHARDS 16
+
+// entries in each set of the verify cache, one of which is replaced (by the
+// CLOCK algorithm) when a new entry maps to a full set
+#define CJOSE_CACHE_WAYS 4
+
+// whether the verify cache is enabled (see cjose_jws_set_verify_cache)
+bool _cjose_cache_enabled();
+
+// computes the cache key of a signature over the given digest of a JWS
+// signing input, into key (CJOSE_CACHE_KEY_LEN bytes)
+bool _cjose_cache_key(
+        const uint8_t *dig,
+        size_t dig_len,
+        const uint8_t *sig,
+        size_t sig_len,
+        uint8_t *key,
+        cjose_err *err);
+
+// whether the signature with the given cache key has verified with jwk
+bool _cjose_cache_lookup(const uint8_t *key, const cjose_jwk_t *jwk);
+
+// records that the signature with the given cache key verified with jwk
+void _cjose_cache_insert(const uint8_t *key, const cjose_jwk_t *jwk);
+
+// drops every entry for jwk; called as the key is freed
+void _cjose_cache_forget(const cjose_jwk_t *jwk);
+
+#endif // SRC_CACHE_INT_H
@@ -9,17 +9,29 @@
 #define SRC_JWE_INT_H
 
 #include <jansson.h>
+#include <openssl/evp.h>
 #include "cjose/jwe.h"
+#include "cjose/base64.h"
 
+// content octets encrypted per step when streaming, so that each block of
+// ciphertext is still in cache when it is encoded
+#define CJOSE_JWE_STREAM_BLOCK_LEN (3 * 4096)
 
-// JWE part
+
+// JWE part (the *_cap members are the sizes of buffers the JWE allocated
+// itself, kept by cjose_jwe_reset for reuse; 0 where unknown)
 struct _cjose_jwe_part_int
 {
     uint8_t *raw;
     size_t raw_len;
+    size_t raw_cap;
 
     char *b64u;
     size_t b64u_len;
+    size_t b64u_cap;
+
+    bool raw_view;      // raw points into a caller's buffer (not freed)
+    bool b64u_view;     // b64u points into a caller's buffer (not freed)
 };
 
 
@@ -53,6 +65,8 @@ typedef struct _jwe_fntable_int
 
     bool (*decrypt_dat)(
     		cjose_jwe_t *jwe, 
+    		uint8_t *dat,
+    		size_t *dat_len,
     		cjose_err *err);
 
 } jwe_fntable;
@@ -65,11 +79,46 @@ struct _cjose_jwe_int
 
 	uint8_t *cek;                           // content-encryption key
 	size_t cek_len;
+	size_t cek_cap;
+
+	const cjose_jwk_t *cek_jwk;             // dir key whose keyed context
+	                                        // stands in for the cek, or NULL
+
+	EVP_CIPHER_CTX *ctx;                    // cipher context, kept for reuse
+
+	uint8_t *slab;                          // decoded parts of a view import
+	size_t slab_cap;
 
 	uint8_t *dat;                           // decrypted data
 	size_t dat_len;
+	size_t dat_cap;
 
 	jwe_fntable fns;                        // functions for building JWE parts
 };
 
+// JWE encrypted or decrypted a piece at a time
+struct _cjose_jwe_stream_int
+{
+	cjose_jwe_t *jwe;                       // header, key, IV and tag (no
+	                                        // content), and cipher context
+	const cjose_jwk_t *jwk;                 // key to decrypt with
+
+	bool encrypting;                        // encrypting rather than
+	                                        // decrypting
+	bool done;                              // finished, or failed
+
+	cjose_base64url_encoder_t enc;          // ciphertext encoder
+	cjose_base64url_decoder_t dec;          // ciphertext decoder
+
+	int part;                               // JWE part being read or written
+
+	char *text;                             // part text read so far
+	size_t text_len;
+
+	char *out;                              // output of the last call
+	size_t out_cap;
+
+	uint8_t raw[CJOSE_JWE_STREAM_BLOCK_LEN];    // block of ciphertext
+};
+
 #endif // SRC_JWE_INT_H
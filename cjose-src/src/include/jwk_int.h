@@ -9,6 +9,7 @@
 
 #include <jansson.h>
 #include <openssl/ec.h>
+#include <openssl/evp.h>
 
 #ifndef SRC_JWK_INT_H
 #define SRC_JWK_INT_H
@@ -21,6 +22,20 @@ typedef struct _key_fntable_int
     bool (*private_json)(const cjose_jwk_t *, json_t *, cjose_err *err);
 } key_fntable;
 
+// HMAC digest algorithms with precomputed key state in every oct key
+#define CJOSE_JWK_HMAC_SHA256 0
+#define CJOSE_JWK_HMAC_SHA384 1
+#define CJOSE_JWK_HMAC_SHA512 2
+#define CJOSE_JWK_HMAC_COUNT  3
+
+// HMAC key state for an oct key: the digest state after hashing the key
+// padded with ipad (inner) and with opad (outer), for each HMAC algorithm
+typedef struct _oct_hmac_int
+{
+    EVP_MD_CTX *        inner[CJOSE_JWK_HMAC_COUNT];
+    EVP_MD_CTX *        outer[CJOSE_JWK_HMAC_COUNT];
+} oct_hmac;
+
 // JSON Web Key structure
 struct _cjose_jwk_int
 {
@@ -30,6 +45,10 @@ struct _cjose_jwk_int
     size_t              keysize;
     void *              keydata;
     const key_fntable * fns;
+    oct_hmac          * hmac;       // oct keys only, NULL otherwise
+    EVP_CIPHER_CTX    * gcm;        // A256GCM keyed with a 256-bit oct key
+                                    // (no IV set), NULL otherwise
+    bool                cached;     // has entries in the JWS verify cache
 };
 
 // EC-specific keydata
@@ -56,4 +75,32 @@ bool cjose_jwk_hkdf(
         unsigned int okm_len,
         cjose_err *err);
 
+// starts an HMAC of the given CJOSE_JWK_HMAC_* algorithm in ctx, by copying
+// in the oct key's precomputed inner state (no re-keying is needed)
+bool _cjose_jwk_hmac_init(
+        const cjose_jwk_t *jwk,
+        size_t alg,
+        EVP_MD_CTX *ctx,
+        cjose_err *err);
+
+// finishes an HMAC started with _cjose_jwk_hmac_init, writing the tag to mac
+// (which must hold EVP_MAX_MD_SIZE bytes); ctx is left holding outer state
+bool _cjose_jwk_hmac_final(
+        const cjose_jwk_t *jwk,
+        size_t alg,
+        EVP_MD_CTX *ctx,
+        uint8_t *mac,
+        unsigned int *mac_len,
+        cjose_err *err);
+
+// starts A256GCM encryption (enc 1) or decryption (enc 0) with the given IV
+// in ctx, by copying in the 256-bit oct key's keyed context (no key
+// schedule is needed)
+bool _cjose_jwk_gcm_init(
+        const cjose_jwk_t *jwk,
+        EVP_CIPHER_CTX *ctx,
+        int enc,
+        const uint8_t *iv,
+        cjose_err *err);
+
 #endif // SRC_JWK_INT_H
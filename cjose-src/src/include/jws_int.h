@@ -9,15 +9,56 @@
 #define SRC_JWS_INT_H
 
 #include <jansson.h>
+#include <openssl/evp.h>
 #include "cjose/jwe.h"
+#include "cjose/base64.h"
+
+// decoded headers up to this size are parsed from a stack buffer on import
+#define CJOSE_JWS_HDR_STACK_LEN 256
+
+// decoded signatures up to this size (RSA keys of up to 4096 bits) are
+// verified from a stack buffer by cjose_jws_verify_compact
+#define CJOSE_JWS_SIG_STACK_LEN 512
+
+// payload octets encoded and hashed per step when signing, so that each
+// block of encoded text is still in cache when it is hashed
+#define CJOSE_JWS_DIG_BLOCK_LEN (3 * 4096)
+
+// fewest JWS objects a batch verification gives each thread, so that a
+// small batch is not spread over threads that cost more than they save
+#define CJOSE_JWS_BATCH_MIN_PER_THREAD 4
+
+// members of a JWS that may borrow memory from an imported buffer
+#define CJOSE_JWS_VIEW_HDR_B64U 0x01
+#define CJOSE_JWS_VIEW_DAT_B64U 0x02
+#define CJOSE_JWS_VIEW_SIG      0x04
+#define CJOSE_JWS_VIEW_SIG_B64U 0x08
+
+// members of a JWS borrowed from the template it was signed with
+#define CJOSE_JWS_VIEW_HDR      0x10
+
+// a detached payload borrowed from the caller
+#define CJOSE_JWS_VIEW_DAT      0x20
+
+// parts of a compact serialization, as read by a verifying stream
+#define CJOSE_JWS_PART_HDR 0
+#define CJOSE_JWS_PART_DAT 1
+#define CJOSE_JWS_PART_SIG 2
 
 // functions for building JWS parts
 typedef struct _jws_fntable_int
 {
-	bool (*digest)(
+    bool (*digest_init)(
+    		cjose_jws_t *jws,
+    		const cjose_jwk_t *jwk,
+    		EVP_MD_CTX *ctx,
+    		cjose_err *err);
+
+    bool (*digest_final)(
     		cjose_jws_t *jws,
-        	const cjose_jwk_t *jwk,
-        	cjose_err *err);
+    		const cjose_jwk_t *jwk,
+    		EVP_MD_CTX *ctx,
+    		cjose_err *err);
 
     bool (*sign)(
     		cjose_jws_t *jws, 
@@ -31,33 +72,111 @@ typedef struct _jws_fntable_int
 
 } jws_fntable;
 
-// JWS object
+// JWS object (the *_cap members are the sizes of buffers the JWS allocated
+// itself, kept by cjose_jws_reset for reuse; 0 where unknown)
 struct _cjose_jws_int
 {
 	json_t *hdr;                // header JSON object
 
 	char *hdr_b64u;             // serialized and base64url encoded header
 	size_t hdr_b64u_len;
+	size_t hdr_b64u_cap;
 
 	uint8_t *dat;               // payload data
 	size_t dat_len;
+	size_t dat_cap;
 
 	char *dat_b64u;             // base64url encoded payload data
 	size_t dat_b64u_len;
+	size_t dat_b64u_cap;
 
 	uint8_t *dig;               // digest of signing input value
 	size_t dig_len;
+	size_t dig_cap;
 
 	uint8_t *sig;               // signature
 	size_t sig_len;
+	size_t sig_cap;
 
 	char *sig_b64u;             // base64url encoded signature
 	size_t sig_b64u_len;
+	size_t sig_b64u_cap;
 
 	char *cser;                 // compact serialization
-	size_t cser_len;
+	size_t cser_len;            // including its NULL, or 0 if not yet built
+	size_t cser_cap;
+
+	EVP_MD_CTX *ctx;            // digest context, kept for reuse
 
 	jws_fntable fns;            // functions for building JWS parts
+
+	bool unencoded;             // payload signed as it is, and detached
+	                            // (b64 false, RFC 7797)
+
+	unsigned int views;         // CJOSE_JWS_VIEW_* members that point into
+	                            // a caller's buffer or a template and are
+	                            // not freed
+};
+
+// JWS header frozen for signing many payloads
+struct _cjose_jws_template_int
+{
+	json_t *hdr;                // copy of the header JSON object
+
+	char *hdr_b64u;             // serialized and base64url encoded header
+	size_t hdr_b64u_len;
+
+	jws_fntable fns;            // functions resolved from the header's alg
+
+	bool unencoded;             // header has b64 false
+};
+
+// JWS signed or verified a piece at a time
+struct _cjose_jws_stream_int
+{
+	cjose_jws_t *jws;           // header, digest and signature (no payload)
+	const cjose_jwk_t *jwk;     // key to sign or verify with
+	EVP_MD_CTX *ctx;            // digest of the signing input so far
+
+	bool signing;               // signing rather than verifying
+	bool done;                  // finished, or failed
+
+	cjose_base64url_encoder_t enc;  // payload encoder, when signing
+	cjose_base64url_decoder_t dec;  // payload decoder, when verifying
+
+	bool attached;              // serialization being verified has a payload
+	bool detached;              // payload given apart from the serialization
+
+	int part;                   // CJOSE_JWS_PART_* being read or written
+
+	char *text;                 // header or signature text read so far
+	size_t text_len;
+
+	char *out;                  // output of the last call
+	size_t out_cap;
+};
+
+// one signature of a JWS with several
+typedef struct _jws_multi_sig_int
+{
+	cjose_jws_t *jws;           // protected header and signature, borrowing
+	                            // the encoded payload
+	json_t *hdr;                // unprotected header JSON object, or NULL
+} jws_multi_sig;
+
+// JWS with several signatures over one payload
+struct _cjose_jws_multi_int
+{
+	uint8_t *dat;               // payload data, decoded on first request
+	size_t dat_len;
+
+	char *dat_b64u;             // base64url encoded payload data
+	size_t dat_b64u_len;
+
+	jws_multi_sig *sigs;        // signatures
+	size_t sig_count;
+
+	char *ser;                  // JSON serialization
 };
 
 #endif // SRC_JWS_INT_H
@@ -0,0 +1,41 @@
+/*!
+ * Copyrights
+ *
+ * Portions created or assigned to Cisco Systems, Inc. are
+ * Copyright (c) 2014-2016 Cisco Systems, Inc.  All Rights Reserved.
+ */
+
+#ifndef SRC_THREAD_INT_H
+#define SRC_THREAD_INT_H
+
+#include <stddef.h>
+
+// upper bound on the number of threads used for one parallel run
+#define CJOSE_PARALLEL_MAX 64
+
+// number of processors available to this process, in [1, CJOSE_PARALLEL_MAX]
+size_t _cjose_cpu_count();
+
+// calls fn(arg, idx) for every idx in [0, count), each on its own thread;
+// index 0 runs on the calling thread, and any index whose thread cannot be
+// started runs there too, so every call is made before this returns.
+// count must not exceed CJOSE_PARALLEL_MAX.
+void _cjose_parallel_run(
+        size_t count,
+        void (*fn)(void *arg, size_t idx),
+        void *arg);
+
+// a mutex, kept opaque so that this header need not include windows.h
+typedef struct _cjose_mutex_int _cjose_mutex;
+
+// creates an unlocked mutex, or returns NULL if out of memory
+_cjose_mutex *_cjose_mutex_new();
+
+// frees an unlocked mutex (NULL is ignored)
+void _cjose_mutex_free(_cjose_mutex *mutex);
+
+// locks and unlocks a mutex; it is not recursive
+void _cjose_mutex_lock(_cjose_mutex *mutex);
+void _cjose_mutex_unlock(_cjose_mutex *mutex);
+
+#endif // SRC_THREAD_INT_H
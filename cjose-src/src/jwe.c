@@ -57,6 +57,8 @@ static bool _cjose_jwe_encrypt_dat_a256gcm(
 
 static bool _cjose_jwe_decrypt_dat_a256gcm(
         cjose_jwe_t *jwe, 
+        uint8_t *dat,
+        size_t *dat_len,
         cjose_err *err);
 
 
@@ -89,6 +91,57 @@ static bool _cjose_jwe_malloc(
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_reserve(
+        uint8_t **buffer,
+        size_t *cap,
+        size_t bytes,
+        cjose_err *err)
+{
+    // a buffer kept from an earlier use of the JWE may be big enough already
+    if (NULL != *buffer && bytes <= *cap)
+    {
+        return true;
+    }
+
+    // its contents are about to be replaced, so there is nothing to copy
+    free(*buffer);
+    *cap = 0;
+    *buffer = (uint8_t *)malloc((0 < bytes) ? bytes : 1);
+    if (NULL == *buffer)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return false;
+    }
+    *cap = bytes;
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_encode_part(
+        cjose_jwe_t *jwe,
+        int p,
+        cjose_err *err)
+{
+    // b64u encode the part (on several threads if it is large), into the
+    // buffer kept from any earlier use
+    struct _cjose_jwe_part_int *part = &jwe->part[p];
+    if (!_cjose_jwe_reserve((uint8_t **)&part->b64u, &part->b64u_cap, 
+            cjose_base64url_encoded_len(part->raw_len) + 1, err) ||
+            !cjose_base64url_encode_parallel_into(part->raw, part->raw_len, 
+                    part->b64u, part->b64u_cap, &part->b64u_len, 
+                    cjose_base64_get_parallel_threads(), err))
+    {
+        return false;
+    }
+    part->b64u[part->b64u_len] = '\0';
+
+    return true;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 static bool _cjose_jwe_build_hdr(
         cjose_jwe_t *jwe, 
@@ -103,15 +156,15 @@ static bool _cjose_jwe_build_hdr(
         return false;
     }
 
-    // copy the serialized header to JWE (hdr_str is owned by header object)
-    jwe->part[0].raw = (uint8_t *)strdup(hdr_str);
-    if (NULL == jwe->part[0].raw)
+    // copy the serialized header to JWE
+    jwe->part[0].raw_len = strlen(hdr_str);
+    if (!_cjose_jwe_reserve(&jwe->part[0].raw, &jwe->part[0].raw_cap, 
+            jwe->part[0].raw_len, err))
     {
-        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
         free(hdr_str);
         return false;
     }
-    jwe->part[0].raw_len = strlen(hdr_str);
+    memcpy(jwe->part[0].raw, hdr_str, jwe->part[0].raw_len);
     free(hdr_str);
     
     return true;
@@ -189,32 +242,32 @@ static bool _cjose_jwe_set_cek_a256gcm(
     // if no JWK is provided, generate a random key
     if (NULL == jwk)
     {
-        free(jwe->cek);
-        if (!_cjose_jwe_malloc(keysize, true, &jwe->cek, err))
+        if (!_cjose_jwe_reserve(&jwe->cek, &jwe->cek_cap, keysize, err))
         {
             return false;
         }   
+        if (RAND_bytes((unsigned char *)jwe->cek, keysize) != 1)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+            return false;
+        }
         jwe->cek_len = keysize;
+        jwe->cek_jwk = NULL;
     }
     else
     {
         // if a JWK is provided, it must be a symmetric key of correct size
         if (CJOSE_JWK_KTY_OCT != cjose_jwk_get_kty(jwk, err) ||
                 jwk->keysize != keysize*8 ||
-                NULL == jwk->keydata)
+                NULL == jwk->keydata || NULL == jwk->gcm)
         {
             CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
             return false;
         }
 
-        // copy the key material directly from jwk to the jwe->cek
-        free(jwe->cek);
-        if (!_cjose_jwe_malloc(keysize, false, &jwe->cek, err))
-        {
-            return false;
-        }   
-        memcpy(jwe->cek, jwk->keydata, keysize);
-        jwe->cek_len = keysize;
+        // the key is not copied: its keyed cipher context is used instead
+        jwe->cek_len = 0;
+        jwe->cek_jwk = jwk;
     }
 
     return true;
@@ -234,7 +287,6 @@ static bool _cjose_jwe_encrypt_ek_dir(
     }   
 
     // for direct encryption, JWE sec 5.1, step 5: let EK be empty octet seq.
-    jwe->part[1].raw = NULL;
     jwe->part[1].raw_len = 0;
 
     return true;
@@ -286,8 +338,8 @@ static bool _cjose_jwe_encrypt_ek_rsa_oaep(
     }
 
     // allocate memory for RSA encryption
-    free(jwe->part[1].raw);
-    if (!_cjose_jwe_malloc(jwe->part[1].raw_len, false, &jwe->part[1].raw, err))
+    if (!_cjose_jwe_reserve(&jwe->part[1].raw, &jwe->part[1].raw_cap, 
+            jwe->part[1].raw_len, err))
     {
         return false;        
     }
@@ -325,14 +377,14 @@ static bool _cjose_jwe_decrypt_ek_rsa_oaep(
     }
 
     // we don't know the size of the key to expect, but must be < RSA_size
-    free(jwe->cek);
     size_t buflen = RSA_size((RSA *)jwk->keydata);
-    if (!_cjose_jwe_malloc(buflen, false, &jwe->cek, err))
+    if (!_cjose_jwe_reserve(&jwe->cek, &jwe->cek_cap, buflen, err))
     {
         return false;
     }
 
     // decrypt the CEK using RSAES-OAEP
+    jwe->cek_jwk = NULL;
     jwe->cek_len = RSA_private_decrypt(
             jwe->part[1].raw_len, jwe->part[1].raw, jwe->cek, 
             (RSA *)jwk->keydata, RSA_PKCS1_OAEP_PADDING);
@@ -352,10 +404,16 @@ static bool _cjose_jwe_set_iv_a256gcm(
         cjose_err *err)
 {
     // generate IV as random 96 bit value
-    free(jwe->part[2].raw);
     jwe->part[2].raw_len = 12;
-    if (!_cjose_jwe_malloc(jwe->part[2].raw_len, true, &jwe->part[2].raw, err))
+    if (!_cjose_jwe_reserve(&jwe->part[2].raw, &jwe->part[2].raw_cap, 
+            jwe->part[2].raw_len, err))
+    {
+        return false;
+    }
+    if (RAND_bytes((unsigned char *)jwe->part[2].raw, 
+            jwe->part[2].raw_len) != 1)
     {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
         return false;
     }
 
@@ -364,50 +422,67 @@ static bool _cjose_jwe_set_iv_a256gcm(
 
 
 ////////////////////////////////////////////////////////////////////////////////
-static bool _cjose_jwe_encrypt_dat_a256gcm(
+static EVP_CIPHER_CTX *_cjose_jwe_cipher_init_a256gcm(
         cjose_jwe_t *jwe, 
-        const uint8_t *plaintext,
-        size_t plaintext_len,
+        int enc,
         cjose_err *err)
 {
-    EVP_CIPHER_CTX *ctx = NULL;
-
-    if (NULL == plaintext)
+    // the cipher context is kept for the JWE's next use
+    if (NULL == jwe->ctx)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-        goto _cjose_jwe_encrypt_dat_fail;        
+        jwe->ctx = EVP_CIPHER_CTX_new();
+        if (NULL == jwe->ctx)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+            return NULL;
+        }
     }
 
-    // get A256GCM cipher
-    const EVP_CIPHER *cipher = EVP_aes_256_gcm();
-    if (NULL == cipher)
+    // a dir key has a keyed context to copy, so that only the IV is new;
+    // any other CEK is keyed here
+    if (NULL != jwe->cek_jwk)
+    {
+        if (!_cjose_jwk_gcm_init(
+                jwe->cek_jwk, jwe->ctx, enc, jwe->part[2].raw, err))
+        {
+            return NULL;
+        }
+    }
+    else if (EVP_CipherInit_ex(jwe->ctx, EVP_aes_256_gcm(), NULL, 
+            jwe->cek, jwe->part[2].raw, enc) != 1)
     {
         CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_encrypt_dat_fail;
+        return NULL;
     }
 
-    // instantiate and initialize a new openssl cipher context
-    ctx = EVP_CIPHER_CTX_new();
-    if (NULL == ctx)
+    return jwe->ctx;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_encrypt_dat_a256gcm(
+        cjose_jwe_t *jwe, 
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
+{
+    if (NULL == plaintext)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_encrypt_dat_fail;
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
     }
-    EVP_CIPHER_CTX_init(ctx);
 
     // initialize context for encryption using A256GCM cipher and CEK and IV
-    if (EVP_EncryptInit_ex(ctx, cipher, NULL, jwe->cek, jwe->part[2].raw) != 1)
+    EVP_CIPHER_CTX *ctx = _cjose_jwe_cipher_init_a256gcm(jwe, 1, err);
+    if (NULL == ctx)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_encrypt_dat_fail;
+        return false;
     }
 
     // we need the header in base64url encoding as input for encryption
-    if ((NULL == jwe->part[0].b64u) && (!cjose_base64url_encode(
-        (const uint8_t *)jwe->part[0].raw, jwe->part[0].raw_len, 
-        &jwe->part[0].b64u, &jwe->part[0].b64u_len, err)))
+    if ((0 == jwe->part[0].b64u_len) && !_cjose_jwe_encode_part(jwe, 0, err))
     {
-        goto _cjose_jwe_encrypt_dat_fail;
+        return false;
     }    
 
     // set GCM mode AAD data (hdr_b64u) by setting "out" to NULL
@@ -419,15 +494,15 @@ static bool _cjose_jwe_encrypt_dat_a256gcm(
                 bytes_encrypted != jwe->part[0].b64u_len)
     {
         CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_encrypt_dat_fail;
+        return false;
     }
 
     // allocate buffer for the ciphertext
-    free(jwe->part[3].raw);
     jwe->part[3].raw_len = plaintext_len;
-    if (!_cjose_jwe_malloc(jwe->part[3].raw_len, false, &jwe->part[3].raw, err))
+    if (!_cjose_jwe_reserve(&jwe->part[3].raw, &jwe->part[3].raw_cap, 
+            jwe->part[3].raw_len, err))
     {
-        goto _cjose_jwe_encrypt_dat_fail;        
+        return false;        
     }
 
     // encrypt entire plaintext to ciphertext buffer
@@ -436,7 +511,7 @@ static bool _cjose_jwe_encrypt_dat_a256gcm(
             plaintext, plaintext_len) != 1)
     {
         CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_encrypt_dat_fail;
+        return false;
     }
     jwe->part[3].raw_len = bytes_encrypted;
 
@@ -444,15 +519,15 @@ static bool _cjose_jwe_encrypt_dat_a256gcm(
     if (EVP_EncryptFinal_ex(ctx, NULL, &bytes_encrypted) != 1)
     {
         CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_encrypt_dat_fail;
+        return false;
     }
 
     // allocate buffer for the authentication tag
-    free(jwe->part[4].raw);
     jwe->part[4].raw_len = 16;
-    if (!_cjose_jwe_malloc(jwe->part[4].raw_len, false, &jwe->part[4].raw, err))
+    if (!_cjose_jwe_reserve(&jwe->part[4].raw, &jwe->part[4].raw_cap, 
+            jwe->part[4].raw_len, err))
     {
-        goto _cjose_jwe_encrypt_dat_fail;        
+        return false;        
     }
 
     // get the GCM-mode authentication tag
@@ -460,50 +535,25 @@ static bool _cjose_jwe_encrypt_dat_a256gcm(
             jwe->part[4].raw_len, jwe->part[4].raw) != 1)
     {
         CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_encrypt_dat_fail;
+        return false;
     }
 
-    EVP_CIPHER_CTX_free(ctx);
     return true;
-
-    _cjose_jwe_encrypt_dat_fail:
-    if (NULL != ctx)
-    {
-        EVP_CIPHER_CTX_free(ctx);
-    }
-    return false;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 static bool _cjose_jwe_decrypt_dat_a256gcm(
         cjose_jwe_t *jwe, 
+        uint8_t *dat,
+        size_t *dat_len,
         cjose_err *err)
 {
-    EVP_CIPHER_CTX *ctx = NULL;
-
-    // get A256GCM cipher
-    const EVP_CIPHER *cipher = EVP_aes_256_gcm();
-    if (NULL == cipher)
-    {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_decrypt_dat_a256gcm_fail;
-    }
-
-    // instantiate and initialize a new openssl cipher context
-    ctx = EVP_CIPHER_CTX_new();
-    if (NULL == ctx)
-    {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_decrypt_dat_a256gcm_fail;
-    }
-    EVP_CIPHER_CTX_init(ctx);
-
     // initialize context for decryption using A256GCM cipher and CEK and IV
-    if (EVP_DecryptInit_ex(ctx, cipher, NULL, jwe->cek, jwe->part[2].raw) != 1)
+    EVP_CIPHER_CTX *ctx = _cjose_jwe_cipher_init_a256gcm(jwe, 0, err);
+    if (NULL == ctx)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_decrypt_dat_a256gcm_fail;
+        return false;
     }
 
     // set the expected GCM-mode authentication tag
@@ -511,7 +561,7 @@ static bool _cjose_jwe_decrypt_dat_a256gcm(
             jwe->part[4].raw_len, jwe->part[4].raw) != 1)
     {
         CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_decrypt_dat_a256gcm_fail;
+        return false;
     }
 
     // set GCM mode AAD data (hdr_b64u) by setting "out" to NULL
@@ -523,62 +573,37 @@ static bool _cjose_jwe_decrypt_dat_a256gcm(
                 bytes_decrypted != jwe->part[0].b64u_len)
     {
         CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_decrypt_dat_a256gcm_fail;
-    }
-
-    // allocate buffer for the plaintext
-    free(jwe->dat);
-    jwe->dat_len = jwe->part[3].raw_len;
-    if (!_cjose_jwe_malloc(jwe->dat_len, false, &jwe->dat, err))
-    {
-        goto _cjose_jwe_decrypt_dat_a256gcm_fail;
+        return false;
     }
 
-    // decrypt ciphertext to plaintext buffer
+    // decrypt ciphertext to plaintext buffer (of part[3].raw_len octets)
     if (EVP_DecryptUpdate(ctx, 
-            jwe->dat, &bytes_decrypted, 
+            dat, &bytes_decrypted, 
             jwe->part[3].raw, jwe->part[3].raw_len) != 1)
     {
         CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_decrypt_dat_a256gcm_fail;
+        return false;
     }
-    jwe->dat_len = bytes_decrypted;
+    *dat_len = bytes_decrypted;
 
     // finalize the encryption
     if (EVP_DecryptFinal_ex(ctx, NULL, &bytes_decrypted) != 1)
     {
         CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jwe_decrypt_dat_a256gcm_fail;
+        return false;
     }
 
-    EVP_CIPHER_CTX_free(ctx);
     return true;
-
-    _cjose_jwe_decrypt_dat_a256gcm_fail:
-    if (NULL != ctx)
-    {
-        EVP_CIPHER_CTX_free(ctx);
-    }
-    return false;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-cjose_jwe_t *cjose_jwe_encrypt(
+static bool _cjose_jwe_encrypt_hdr(
+        cjose_jwe_t *jwe,
         const cjose_jwk_t *jwk,
         cjose_header_t *header,
-        const uint8_t *plaintext,
-        size_t plaintext_len,
         cjose_err *err)
 {
-    cjose_jwe_t *jwe = NULL;
-
-    if (NULL == jwk || NULL == header)
-    {
-        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-        return NULL;
-    }
-
     // if not already set, add kid header to JWE to match that of JWK
     const char *kid = cjose_jwk_get_kid(jwk, err);
     if (NULL != kid) {
@@ -589,172 +614,472 @@ cjose_jwe_t *cjose_jwe_encrypt(
         }
     }
 
-    // allocate and initialize a new JWE object
-    if (!_cjose_jwe_malloc(sizeof(cjose_jwe_t), false, (uint8_t **)&jwe, err))
-    {
-        return NULL;
-    }
-
     // validate JWE header
     if (!_cjose_jwe_validate_hdr(jwe, header, err))
     {
-        cjose_jwe_release(jwe);
-        return NULL;
+        return false;
     }
 
     // build JWE header
     if (!_cjose_jwe_build_hdr(jwe, header, err))
     {
-        cjose_jwe_release(jwe);
-        return NULL;
+        return false;
     }
 
     // build JWE content-encryption key and encrypted key
     if (!jwe->fns.encrypt_ek(jwe, jwk, err))
     {
-        cjose_jwe_release(jwe);
-        return NULL;
+        return false;
     }
 
     // build JWE initialization vector
-    if (!jwe->fns.set_iv(jwe, err))
-    {
-        cjose_jwe_release(jwe);
-        return NULL;
-    }
+    return jwe->fns.set_iv(jwe, err);
+}
 
-    // build JWE encrypted data and authentication tag
-    if (!jwe->fns.encrypt_dat(jwe, plaintext, plaintext_len, err))
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_encrypt(
+        cjose_jwe_t *jwe,
+        const cjose_jwk_t *jwk,
+        cjose_header_t *header,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
+{
+    // build JWE header, encrypted key and initialization vector
+    if (!_cjose_jwe_encrypt_hdr(jwe, jwk, header, err))
     {
-        cjose_jwe_release(jwe);
-        return NULL;
+        return false;
     }
 
-    return jwe;
+    // build JWE encrypted data and authentication tag
+    return jwe->fns.encrypt_dat(jwe, plaintext, plaintext_len, err);
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-void cjose_jwe_release(
-        cjose_jwe_t *jwe)
+cjose_jwe_t *cjose_jwe_new(
+        cjose_err *err)
 {
-    if (NULL == jwe)
-    {
-        return;
-    }
-    for (int i = 0; i < 5; ++i)
+    cjose_jwe_t *jwe = NULL;
+
+    // allocate and initialize a new JWE object
+    if (!_cjose_jwe_malloc(sizeof(cjose_jwe_t), false, (uint8_t **)&jwe, err))
     {
-        free(jwe->part[i].raw);
-        free(jwe->part[i].b64u);
+        return NULL;
     }
-    free(jwe->cek);
-    free(jwe->dat);
-    free(jwe);
+
+    return jwe;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-char *cjose_jwe_export(
-        cjose_jwe_t *jwe,
+cjose_jwe_t *cjose_jwe_encrypt(
+        const cjose_jwk_t *jwk,
+        cjose_header_t *header,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
         cjose_err *err)
 {
-    char *cser = NULL;
-    size_t cser_len = 0;
+    cjose_jwe_t *jwe = NULL;
 
-    if (NULL == jwe)
+    if (NULL == jwk || NULL == header)
     {
         CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
         return NULL;
     }
 
-    // make sure all parts are b64u encoded
-    for (int i = 0; i < 5; ++i)
-    {
-        if ((NULL == jwe->part[i].b64u) && 
-            (!cjose_base64url_encode(
-            (const uint8_t *)jwe->part[i].raw, jwe->part[i].raw_len, 
-            &jwe->part[i].b64u, &jwe->part[i].b64u_len, err)))
-        {
-            return NULL;
-        }    
-    }
-
-    // compute length of compact serialization
-    cser_len = 0;
-    for (int i = 0; i < 5; ++i)
+    jwe = cjose_jwe_new(err);
+    if (NULL == jwe)
     {
-        cser_len += jwe->part[i].b64u_len + 1;
+        return NULL;
     }
 
-    // allocate buffer for compact serialization
-    if (!_cjose_jwe_malloc(cser_len, false, (uint8_t **)&cser, err))
+    if (!_cjose_jwe_encrypt(jwe, jwk, header, plaintext, plaintext_len, err))
     {
+        cjose_jwe_release(jwe);
         return NULL;
     }
 
-    // build the compact serialization
-    snprintf(cser, cser_len, "%s.%s.%s.%s.%s", jwe->part[0].b64u, 
-            jwe->part[1].b64u, jwe->part[2].b64u, 
-            jwe->part[3].b64u, jwe->part[4].b64u);
-
-    return cser;
+    return jwe;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-bool _cjose_jwe_import_part(
+bool cjose_jwe_encrypt_into(
         cjose_jwe_t *jwe,
-        size_t p,
-        const char *b64u,
-        size_t b64u_len,
+        const cjose_jwk_t *jwk,
+        cjose_header_t *header,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
         cjose_err *err)
 {
-    // only the ek and the data parts may be of zero length
-    if (b64u_len == 0 && p != 1 && p != 3)
+    if (NULL == jwe || NULL == jwk || NULL == header)
     {
         CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
         return false;
     }
 
-    // copy the b64u part to the jwe
-    jwe->part[p].b64u = strdup(b64u);
-    if (NULL == jwe->part[p].b64u)
+    cjose_jwe_reset(jwe);
+    return _cjose_jwe_encrypt(jwe, jwk, header, plaintext, plaintext_len, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+void cjose_jwe_reset(
+        cjose_jwe_t *jwe)
+{
+    if (NULL == jwe)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
-        return false;
+        return;
     }
-    jwe->part[p].b64u_len = b64u_len;
 
-    // b64u decode the part
-    if (!cjose_base64url_decode(
-            jwe->part[p].b64u, jwe->part[p].b64u_len, 
-            (uint8_t **)&jwe->part[p].raw, &jwe->part[p].raw_len, err) ||
-            NULL == jwe->part[p].raw)
+    // let go of the parts that point into a caller's buffer; the buffers the
+    // JWE allocated itself are kept for its next use
+    for (int i = 0; i < 5; ++i)
     {
-        return false;        
+        struct _cjose_jwe_part_int *part = &jwe->part[i];
+        if (part->raw_view)
+        {
+            part->raw = NULL;
+            part->raw_cap = 0;
+            part->raw_view = false;
+        }
+        if (part->b64u_view)
+        {
+            part->b64u = NULL;
+            part->b64u_cap = 0;
+            part->b64u_view = false;
+        }
+        part->raw_len = 0;
+        part->b64u_len = 0;
     }
 
-    return true;
+    // the key is secret, so it is not left in a buffer kept for reuse
+    if (NULL != jwe->cek)
+    {
+        OPENSSL_cleanse(jwe->cek, jwe->cek_cap);
+    }
+    if (NULL != jwe->ctx)
+    {
+        EVP_CIPHER_CTX_cleanup(jwe->ctx);
+    }
+    jwe->cek_len = 0;
+    jwe->cek_jwk = NULL;
+    jwe->dat_len = 0;
+    memset(&jwe->fns, 0, sizeof(jwe->fns));
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-cjose_jwe_t *cjose_jwe_import(
-        const char *cser,
-        size_t cser_len,
-        cjose_err *err)
+void cjose_jwe_release(
+        cjose_jwe_t *jwe)
 {
-    cjose_jwe_t *jwe = NULL;
-
-    if (NULL == cser)
+    if (NULL == jwe)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-        return NULL;
+        return;
     }
-
-    // allocate and initialize a new JWE object
-    if (!_cjose_jwe_malloc(sizeof(cjose_jwe_t), false, (uint8_t **)&jwe, err))
+    for (int i = 0; i < 5; ++i)
+    {
+        if (!jwe->part[i].raw_view)
+        {
+            free(jwe->part[i].raw);
+        }
+        if (!jwe->part[i].b64u_view)
+        {
+            free(jwe->part[i].b64u);
+        }
+    }
+    free(jwe->cek);
+    free(jwe->dat);
+    free(jwe->slab);
+    if (NULL != jwe->ctx)
+    {
+        EVP_CIPHER_CTX_free(jwe->ctx);
+    }
+    free(jwe);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_cser_len(
+        cjose_jwe_t *jwe,
+        size_t *cser_len,
+        cjose_err *err)
+{
+    // make sure all parts are b64u encoded (an empty part, such as the ek
+    // for direct encryption, has nothing to encode)
+    for (int i = 0; i < 5; ++i)
+    {
+        if ((0 == jwe->part[i].b64u_len) && (0 < jwe->part[i].raw_len) &&
+            !_cjose_jwe_encode_part(jwe, i, err))
+        {
+            return false;
+        }    
+    }
+
+    // compute length of compact serialization, with its four separators
+    *cser_len = 4;
+    for (int i = 0; i < 5; ++i)
+    {
+        *cser_len += jwe->part[i].b64u_len;
+    }
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static void _cjose_jwe_write_cser(
+        const cjose_jwe_t *jwe,
+        char *cser)
+{
+    // parts imported in place are not NULL-terminated, so copy by length
+    char *pos = cser;
+    for (int i = 0; i < 5; ++i)
+    {
+        if (0 < jwe->part[i].b64u_len)
+        {
+            memcpy(pos, jwe->part[i].b64u, jwe->part[i].b64u_len);
+        }
+        pos += jwe->part[i].b64u_len;
+        if (i < 4)
+        {
+            *pos++ = '.';
+        }
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+char *cjose_jwe_export(
+        cjose_jwe_t *jwe,
+        cjose_err *err)
+{
+    char *cser = NULL;
+    size_t cser_len = 0;
+
+    if (NULL == jwe)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return NULL;
+    }
+
+    if (!_cjose_jwe_cser_len(jwe, &cser_len, err))
+    {
+        return NULL;
+    }
+
+    // allocate buffer for compact serialization; every byte is written, so
+    // there is no need to clear it first
+    cser = (char *)malloc(cser_len + 1);
+    if (NULL == cser)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return NULL;
+    }
+
+    // build the compact serialization
+    _cjose_jwe_write_cser(jwe, cser);
+    cser[cser_len] = '\0';
+
+    return cser;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jwe_export_into(
+        cjose_jwe_t *jwe,
+        char *buf,
+        size_t buf_len,
+        size_t *ser_len,
+        cjose_err *err)
+{
+    if (NULL == jwe || NULL == ser_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    if (!_cjose_jwe_cser_len(jwe, ser_len, err))
+    {
+        return false;
+    }
+
+    // without a buffer, only the length is wanted
+    if (NULL == buf)
+    {
+        return true;
+    }
+    if (buf_len < *ser_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    _cjose_jwe_write_cser(jwe, buf);
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool _cjose_jwe_import_part(
+        cjose_jwe_t *jwe,
+        size_t p,
+        const char *b64u,
+        size_t b64u_len,
+        cjose_err *err)
+{
+    // only the ek and the data parts may be of zero length
+    if (b64u_len == 0 && p != 1 && p != 3)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // copy the b64u part (only, not the rest of the serialization) to the jwe
+    if (!_cjose_jwe_reserve((uint8_t **)&jwe->part[p].b64u, 
+            &jwe->part[p].b64u_cap, b64u_len + 1, err))
+    {
+        return false;
+    }
+    memcpy(jwe->part[p].b64u, b64u, b64u_len);
+    jwe->part[p].b64u[b64u_len] = 0;
+    jwe->part[p].b64u_len = b64u_len;
+
+    // b64u decode the part (on several threads if it is large)
+    if (!cjose_base64url_decode_parallel(
+            jwe->part[p].b64u, jwe->part[p].b64u_len, 
+            (uint8_t **)&jwe->part[p].raw, &jwe->part[p].raw_len, 
+            cjose_base64_get_parallel_threads(), err) ||
+            NULL == jwe->part[p].raw)
+    {
+        return false;        
+    }
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_consume_part(
+        cjose_jwe_t *jwe,
+        size_t p,
+        char *b64u,
+        size_t b64u_len,
+        cjose_err *err)
+{
+    // only the ek and the data parts may be of zero length
+    if (b64u_len == 0 && p != 1 && p != 3)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // the encoded header is the AAD for decryption, so leave it intact and
+    // decode a copy; every other part is decoded over its own characters
+    if (0 == p)
+    {
+        jwe->part[p].b64u = b64u;
+        jwe->part[p].b64u_len = b64u_len;
+        jwe->part[p].b64u_view = true;
+
+        if (!cjose_base64url_decode(
+                jwe->part[p].b64u, jwe->part[p].b64u_len, 
+                (uint8_t **)&jwe->part[p].raw, &jwe->part[p].raw_len, err) ||
+                NULL == jwe->part[p].raw)
+        {
+            return false;        
+        }
+    }
+    else
+    {
+        if (!cjose_base64url_decode_inplace(
+                b64u, b64u_len, &jwe->part[p].raw_len, err))
+        {
+            return false;
+        }
+        jwe->part[p].raw = (uint8_t *)b64u;
+        jwe->part[p].raw_view = true;
+    }
+
+    return true;
+}
+
+
+// how an import treats the caller's serialization
+typedef enum
+{
+    _CJOSE_JWE_IMPORT_COPY,         // copied, and left untouched
+    _CJOSE_JWE_IMPORT_CONSUME,      // decoded in place, and referred to
+    _CJOSE_JWE_IMPORT_VIEW,         // left untouched, and referred to
+} _cjose_jwe_import_mode;
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_view_part(
+        cjose_jwe_t *jwe,
+        size_t p,
+        const char *b64u,
+        size_t b64u_len,
+        size_t *slab_len,
+        cjose_err *err)
+{
+    // only the ek and the data parts may be of zero length
+    if (b64u_len == 0 && p != 1 && p != 3)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // the b64u part stays in the caller's buffer, and is decoded into the
+    // next free bytes of the slab
+    jwe->part[p].b64u = (char *)b64u;
+    jwe->part[p].b64u_len = b64u_len;
+    jwe->part[p].b64u_view = true;
+
+    jwe->part[p].raw = jwe->slab + *slab_len;
+    jwe->part[p].raw_view = true;
+    if (!cjose_base64url_decode_into(
+            b64u, b64u_len, jwe->part[p].raw, jwe->slab_cap - *slab_len, 
+            &jwe->part[p].raw_len, err))
+    {
+        return false;
+    }
+    *slab_len += jwe->part[p].raw_len;
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static cjose_jwe_t *_cjose_jwe_import(
+        const char *cser,
+        size_t cser_len,
+        _cjose_jwe_import_mode mode,
+        cjose_err *err)
+{
+    cjose_jwe_t *jwe = NULL;
+
+    if (NULL == cser)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return NULL;
+    }
+
+    // allocate and initialize a new JWE object
+    if (!_cjose_jwe_malloc(sizeof(cjose_jwe_t), false, (uint8_t **)&jwe, err))
+    {
+        return NULL;
+    }
+
+    // a view import decodes every part into one slab, which the parts
+    // (together shorter than the serialization) always fit in
+    size_t slab_len = 0;
+    if (_CJOSE_JWE_IMPORT_VIEW == mode && !_cjose_jwe_reserve(&jwe->slab, 
+            &jwe->slab_cap, cjose_base64url_decoded_max_len(cser_len), err))
     {
+        cjose_jwe_release(jwe);
         return NULL;
     }
 
@@ -766,8 +1091,25 @@ cjose_jwe_t *cjose_jwe_import(
     {
         if ((idx == cser_len) || (cser[idx] == '.'))
         {
-            if (!_cjose_jwe_import_part(
-                    jwe, part++, cser + start_idx, idx - start_idx, err))
+            // in consume mode cser is the caller's writable buffer
+            bool ok = false;
+            switch (mode)
+            {
+                case _CJOSE_JWE_IMPORT_COPY:
+                    ok = _cjose_jwe_import_part(
+                            jwe, part++, cser + start_idx, idx - start_idx, 
+                            err);
+                    break;
+                case _CJOSE_JWE_IMPORT_CONSUME:
+                    ok = _cjose_jwe_consume_part(jwe, part++, 
+                            (char *)cser + start_idx, idx - start_idx, err);
+                    break;
+                case _CJOSE_JWE_IMPORT_VIEW:
+                    ok = _cjose_jwe_view_part(jwe, part++, 
+                            cser + start_idx, idx - start_idx, &slab_len, err);
+                    break;
+            }
+            if (!ok)
             {
                 cjose_jwe_release(jwe);
                 return NULL;                
@@ -817,6 +1159,62 @@ cjose_jwe_t *cjose_jwe_import(
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+cjose_jwe_t *cjose_jwe_import(
+        const char *cser,
+        size_t cser_len,
+        cjose_err *err)
+{
+    return _cjose_jwe_import(cser, cser_len, _CJOSE_JWE_IMPORT_COPY, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+cjose_jwe_t *cjose_jwe_import_consume(
+        char *cser,
+        size_t cser_len,
+        cjose_err *err)
+{
+    return _cjose_jwe_import(cser, cser_len, _CJOSE_JWE_IMPORT_CONSUME, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+cjose_jwe_t *cjose_jwe_import_view(
+        const char *cser,
+        size_t cser_len,
+        cjose_err *err)
+{
+    return _cjose_jwe_import(cser, cser_len, _CJOSE_JWE_IMPORT_VIEW, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_decrypt(
+        cjose_jwe_t *jwe,
+        const cjose_jwk_t *jwk,
+        uint8_t *dat,
+        size_t *dat_len,
+        cjose_err *err)
+{
+    // decrypt JWE content-encryption key from encrypted key
+    if (!jwe->fns.decrypt_ek(jwe, jwk, err))
+    {
+        return false;
+    }
+
+    // decrypt JWE encrypted data; content that fails authentication is not
+    // left behind
+    if (!jwe->fns.decrypt_dat(jwe, dat, dat_len, err))
+    {
+        OPENSSL_cleanse(dat, jwe->part[3].raw_len);
+        return false;
+    }
+
+    return true;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 uint8_t *cjose_jwe_decrypt(
         cjose_jwe_t *jwe,
@@ -830,14 +1228,10 @@ uint8_t *cjose_jwe_decrypt(
         return NULL;
     }
 
-     // decrypt JWE content-encryption key from encrypted key
-    if (!jwe->fns.decrypt_ek(jwe, jwk, err))
-    {
-        return NULL;
-    }
-
-    // decrypt JWE encrypted data
-    if (!jwe->fns.decrypt_dat(jwe, err))
+    // allocate buffer for the plaintext, and decrypt into it
+    if (!_cjose_jwe_reserve(&jwe->dat, &jwe->dat_cap, 
+            jwe->part[3].raw_len, err) ||
+            !_cjose_jwe_decrypt(jwe, jwk, jwe->dat, &jwe->dat_len, err))
     {
         return NULL;
     }
@@ -847,6 +1241,647 @@ uint8_t *cjose_jwe_decrypt(
     *content_len = jwe->dat_len;
     jwe->dat = NULL;
     jwe->dat_len = 0;
+    jwe->dat_cap = 0;
 
     return content;
 }
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jwe_decrypt_into(
+        cjose_jwe_t *jwe,
+        const cjose_jwk_t *jwk,
+        uint8_t *buf,
+        size_t buf_len,
+        size_t *content_len,
+        cjose_err *err)
+{
+    if (NULL == jwe || NULL == content_len || (NULL != buf && NULL == jwk))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // GCM content is as long as its ciphertext
+    size_t len = jwe->part[3].raw_len;
+    if (NULL == buf || buf_len < len)
+    {
+        *content_len = len;
+        if (NULL != buf)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+            return false;
+        }
+        return true;
+    }
+
+    return _cjose_jwe_decrypt(jwe, jwk, buf, content_len, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static cjose_jwe_stream_t *_cjose_jwe_stream_new(
+        const cjose_jwk_t *jwk,
+        bool encrypting,
+        cjose_err *err)
+{
+    cjose_jwe_stream_t *stream = 
+            (cjose_jwe_stream_t *)calloc(1, sizeof(cjose_jwe_stream_t));
+    if (NULL == stream)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return NULL;
+    }
+    stream->jwk = jwk;
+    stream->encrypting = encrypting;
+    cjose_base64url_encoder_init(&stream->enc);
+    cjose_base64url_decoder_init(&stream->dec);
+
+    stream->jwe = cjose_jwe_new(err);
+    if (NULL == stream->jwe)
+    {
+        cjose_jwe_stream_release(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_stream_reserve(
+        cjose_jwe_stream_t *stream,
+        size_t len,
+        cjose_err *err)
+{
+    if (len <= stream->out_cap)
+    {
+        return true;
+    }
+
+    // the output buffer only grows, so a steady chunk size costs one
+    // allocation
+    char *out = (char *)realloc(stream->out, len);
+    if (NULL == out)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return false;
+    }
+    stream->out = out;
+    stream->out_cap = len;
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_stream_append(
+        cjose_jwe_stream_t *stream,
+        const char *text,
+        size_t len,
+        cjose_err *err)
+{
+    char *buf = (char *)realloc(stream->text, stream->text_len + len + 1);
+    if (NULL == buf)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return false;
+    }
+    memcpy(buf + stream->text_len, text, len);
+    stream->text = buf;
+    stream->text_len += len;
+    stream->text[stream->text_len] = 0;
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static size_t _cjose_jwe_stream_head(
+        cjose_jwe_stream_t *stream,
+        char *out)
+{
+    // the header, encrypted key and IV, each followed by a dot
+    size_t pos = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        if (NULL != out)
+        {
+            if (0 < stream->jwe->part[i].b64u_len)
+            {
+                memcpy(out + pos, stream->jwe->part[i].b64u, 
+                        stream->jwe->part[i].b64u_len);
+            }
+            out[pos + stream->jwe->part[i].b64u_len] = '.';
+        }
+        pos += stream->jwe->part[i].b64u_len + 1;
+    }
+    return pos;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+cjose_jwe_stream_t *cjose_jwe_encrypt_init(
+        const cjose_jwk_t *jwk,
+        cjose_header_t *header,
+        cjose_err *err)
+{
+    if (NULL == jwk || NULL == header)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return NULL;
+    }
+
+    cjose_jwe_stream_t *stream = _cjose_jwe_stream_new(jwk, true, err);
+    if (NULL == stream)
+    {
+        return NULL;
+    }
+    cjose_jwe_t *jwe = stream->jwe;
+
+    // build the JWE header, encrypted key and IV, and encode them
+    if (!_cjose_jwe_encrypt_hdr(jwe, jwk, header, err))
+    {
+        cjose_jwe_stream_release(stream);
+        return NULL;
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        if (0 == jwe->part[i].b64u_len && 0 < jwe->part[i].raw_len && 
+                !_cjose_jwe_encode_part(jwe, i, err))
+        {
+            cjose_jwe_stream_release(stream);
+            return NULL;
+        }
+    }
+
+    // begin encrypting, with the encoded header as AAD
+    int len = 0;
+    EVP_CIPHER_CTX *ctx = _cjose_jwe_cipher_init_a256gcm(jwe, 1, err);
+    if (NULL == ctx)
+    {
+        cjose_jwe_stream_release(stream);
+        return NULL;
+    }
+    if (EVP_EncryptUpdate(ctx, NULL, &len, 
+            (unsigned char *)jwe->part[0].b64u, jwe->part[0].b64u_len) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        cjose_jwe_stream_release(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_encrypt_update(
+        cjose_jwe_stream_t *stream,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        size_t *ser_len,
+        cjose_err *err)
+{
+    size_t pos = 0;
+
+    // the first piece of the serialization begins with the header,
+    // encrypted key and IV
+    size_t len = cjose_base64_encoded_len(plaintext_len);
+    if (0 == stream->part)
+    {
+        len += _cjose_jwe_stream_head(stream, NULL);
+    }
+    if (!_cjose_jwe_stream_reserve(stream, len, err))
+    {
+        return false;
+    }
+    if (0 == stream->part)
+    {
+        pos = _cjose_jwe_stream_head(stream, stream->out);
+        stream->part = 3;
+    }
+
+    // encrypt the content a block at a time, encoding each block of
+    // ciphertext while it is still in cache
+    for (size_t idx = 0; idx < plaintext_len; 
+            idx += CJOSE_JWE_STREAM_BLOCK_LEN)
+    {
+        int raw_len = 0;
+        size_t enc_len = 0;
+        len = plaintext_len - idx;
+        if (len > CJOSE_JWE_STREAM_BLOCK_LEN)
+        {
+            len = CJOSE_JWE_STREAM_BLOCK_LEN;
+        }
+
+        if (EVP_EncryptUpdate(stream->jwe->ctx, 
+                stream->raw, &raw_len, plaintext + idx, len) != 1)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+            return false;
+        }
+        if (!cjose_base64url_encoder_update(&stream->enc, stream->raw, 
+                raw_len, stream->out + pos, stream->out_cap - pos, &enc_len, 
+                err))
+        {
+            return false;
+        }
+        pos += enc_len;
+    }
+
+    *ser_len = pos;
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jwe_encrypt_update(
+        cjose_jwe_stream_t *stream,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        const char **ser,
+        size_t *ser_len,
+        cjose_err *err)
+{
+    if (NULL == stream || !stream->encrypting || stream->done || 
+            (NULL == plaintext && 0 < plaintext_len) || 
+            NULL == ser || NULL == ser_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    if (!_cjose_jwe_encrypt_update(
+            stream, plaintext, plaintext_len, ser_len, err))
+    {
+        stream->done = true;
+        return false;
+    }
+
+    *ser = stream->out;
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_encrypt_final(
+        cjose_jwe_stream_t *stream,
+        size_t *ser_len,
+        cjose_err *err)
+{
+    cjose_jwe_t *jwe = stream->jwe;
+    char tail[3];
+    size_t tail_len = 0;
+    int len = 0;
+
+    // finish the encryption, and get the authentication tag
+    if (EVP_EncryptFinal_ex(jwe->ctx, NULL, &len) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        return false;
+    }
+    jwe->part[4].raw_len = 16;
+    if (!_cjose_jwe_reserve(&jwe->part[4].raw, &jwe->part[4].raw_cap, 
+            jwe->part[4].raw_len, err))
+    {
+        return false;
+    }
+    if (EVP_CIPHER_CTX_ctrl(jwe->ctx, EVP_CTRL_GCM_GET_TAG, 
+            jwe->part[4].raw_len, jwe->part[4].raw) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        return false;
+    }
+    if (!_cjose_jwe_encode_part(jwe, 4, err))
+    {
+        return false;
+    }
+
+    // encode the last octets of the ciphertext
+    if (!cjose_base64url_encoder_final(
+            &stream->enc, tail, sizeof(tail), &tail_len, err))
+    {
+        return false;
+    }
+
+    // the last piece of the serialization (which is also the first, if
+    // there was no update)
+    size_t pos = 0;
+    size_t out_len = tail_len + 1 + jwe->part[4].b64u_len;
+    if (0 == stream->part)
+    {
+        out_len += _cjose_jwe_stream_head(stream, NULL);
+    }
+    if (!_cjose_jwe_stream_reserve(stream, out_len, err))
+    {
+        return false;
+    }
+    if (0 == stream->part)
+    {
+        pos = _cjose_jwe_stream_head(stream, stream->out);
+    }
+    memcpy(stream->out + pos, tail, tail_len);
+    pos += tail_len;
+    stream->out[pos++] = '.';
+    memcpy(stream->out + pos, jwe->part[4].b64u, jwe->part[4].b64u_len);
+    pos += jwe->part[4].b64u_len;
+    stream->part = 4;
+
+    *ser_len = pos;
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jwe_encrypt_final(
+        cjose_jwe_stream_t *stream,
+        const char **ser,
+        size_t *ser_len,
+        cjose_err *err)
+{
+    if (NULL == stream || !stream->encrypting || stream->done || 
+            NULL == ser || NULL == ser_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    stream->done = true;
+    if (!_cjose_jwe_encrypt_final(stream, ser_len, err))
+    {
+        return false;
+    }
+
+    *ser = stream->out;
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+cjose_jwe_stream_t *cjose_jwe_decrypt_init(
+        const cjose_jwk_t *jwk,
+        cjose_err *err)
+{
+    if (NULL == jwk)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return NULL;
+    }
+
+    return _cjose_jwe_stream_new(jwk, false, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_decrypt_part(
+        cjose_jwe_stream_t *stream,
+        cjose_err *err)
+{
+    cjose_jwe_t *jwe = stream->jwe;
+    int p = stream->part;
+
+    // only the ek and the data parts may be of zero length
+    if (0 == stream->text_len && 1 != p)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // the part text read so far is the whole encoded part
+    jwe->part[p].b64u = stream->text;
+    jwe->part[p].b64u_len = stream->text_len;
+    stream->text = NULL;
+    stream->text_len = 0;
+    if (0 < jwe->part[p].b64u_len && !cjose_base64url_decode(
+            jwe->part[p].b64u, jwe->part[p].b64u_len, 
+            &jwe->part[p].raw, &jwe->part[p].raw_len, err))
+    {
+        return false;
+    }
+
+    // deserialize and validate the JSON header
+    if (0 == p)
+    {
+        json_t *header = json_loadb(
+                (const char *)jwe->part[0].raw, jwe->part[0].raw_len, 0, NULL);
+        if (NULL == header)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+            return false;
+        }
+        bool valid = _cjose_jwe_validate_hdr(jwe, header, err);
+        json_decref(header);
+        return valid;
+    }
+
+    // once the IV is read, decrypt the content-encryption key, and begin
+    // decrypting with the encoded header as AAD
+    if (2 == p)
+    {
+        int len = 0;
+        if (!jwe->fns.decrypt_ek(jwe, stream->jwk, err) ||
+                NULL == _cjose_jwe_cipher_init_a256gcm(jwe, 0, err))
+        {
+            return false;
+        }
+        if (EVP_DecryptUpdate(jwe->ctx, NULL, &len, 
+                (unsigned char *)jwe->part[0].b64u, 
+                jwe->part[0].b64u_len) != 1)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_decrypt_dat(
+        cjose_jwe_stream_t *stream,
+        size_t pos,
+        size_t len,
+        cjose_err *err)
+{
+    // the ciphertext is decoded into the output, and decrypted in place
+    uint8_t *dat = (uint8_t *)stream->out + pos;
+    int dat_len = 0;
+    if (0 < len && (EVP_DecryptUpdate(
+            stream->jwe->ctx, dat, &dat_len, dat, len) != 1 || 
+            (size_t)dat_len != len))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        return false;
+    }
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_decrypt_update(
+        cjose_jwe_stream_t *stream,
+        const char *ser,
+        size_t ser_len,
+        size_t *plaintext_len,
+        cjose_err *err)
+{
+    size_t pos = 0;
+
+    if (!_cjose_jwe_stream_reserve(
+            stream, cjose_base64url_decoded_max_len(ser_len + 3), err))
+    {
+        return false;
+    }
+
+    while (0 < ser_len)
+    {
+        // read up to the end of the current part, or of the chunk
+        const char *dot = (const char *)memchr(ser, '.', ser_len);
+        size_t len = (NULL == dot) ? ser_len : (size_t)(dot - ser);
+        size_t dec_len = 0;
+
+        if (3 == stream->part)
+        {
+            // decode and decrypt the ciphertext for the caller
+            if (!cjose_base64url_decoder_update(&stream->dec, ser, len, 
+                    (uint8_t *)stream->out + pos, stream->out_cap - pos, 
+                    &dec_len, err) ||
+                    !_cjose_jwe_decrypt_dat(stream, pos, dec_len, err))
+            {
+                return false;
+            }
+            pos += dec_len;
+            if (NULL != dot)
+            {
+                if (!cjose_base64url_decoder_final(&stream->dec, 
+                        (uint8_t *)stream->out + pos, stream->out_cap - pos, 
+                        &dec_len, err) ||
+                        !_cjose_jwe_decrypt_dat(stream, pos, dec_len, err))
+                {
+                    return false;
+                }
+                pos += dec_len;
+            }
+        }
+        else
+        {
+            // a compact serialization has only five parts
+            if (4 == stream->part && NULL != dot)
+            {
+                CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+                return false;
+            }
+            if (!_cjose_jwe_stream_append(stream, ser, len, err))
+            {
+                return false;
+            }
+            if (NULL != dot && !_cjose_jwe_decrypt_part(stream, err))
+            {
+                return false;
+            }
+        }
+
+        if (NULL != dot)
+        {
+            ++stream->part;
+            ++len;
+        }
+        ser += len;
+        ser_len -= len;
+    }
+
+    *plaintext_len = pos;
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jwe_decrypt_update(
+        cjose_jwe_stream_t *stream,
+        const char *ser,
+        size_t ser_len,
+        const uint8_t **plaintext,
+        size_t *plaintext_len,
+        cjose_err *err)
+{
+    if (NULL == stream || stream->encrypting || stream->done || 
+            (NULL == ser && 0 < ser_len) || 
+            NULL == plaintext || NULL == plaintext_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    if (!_cjose_jwe_decrypt_update(stream, ser, ser_len, plaintext_len, err))
+    {
+        stream->done = true;
+        return false;
+    }
+
+    *plaintext = (const uint8_t *)stream->out;
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jwe_decrypt_final(
+        cjose_jwe_stream_t *stream,
+        cjose_err *err)
+{
+    cjose_jwe_t *jwe = stream->jwe;
+    int len = 0;
+
+    // the whole serialization must have been read, up to the tag
+    if (4 != stream->part || 0 == stream->text_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+    if (!_cjose_jwe_decrypt_part(stream, err))
+    {
+        return false;
+    }
+
+    // check the authentication tag
+    if (EVP_CIPHER_CTX_ctrl(jwe->ctx, EVP_CTRL_GCM_SET_TAG, 
+            jwe->part[4].raw_len, jwe->part[4].raw) != 1 ||
+            EVP_DecryptFinal_ex(jwe->ctx, NULL, &len) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        return false;
+    }
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jwe_decrypt_final(
+        cjose_jwe_stream_t *stream,
+        cjose_err *err)
+{
+    if (NULL == stream || stream->encrypting || stream->done)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    stream->done = true;
+    return _cjose_jwe_decrypt_final(stream, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+void cjose_jwe_stream_release(cjose_jwe_stream_t *stream)
+{
+    if (NULL == stream)
+    {
+        return;
+    }
+    cjose_jwe_release(stream->jwe);
+    free(stream->text);
+    free(stream->out);
+    free(stream);
+}
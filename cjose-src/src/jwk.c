@@ -6,6 +6,7 @@
  */
 
 #include "include/jwk_int.h"
+#include "include/cache_int.h"
 
 #include <cjose/base64.h>
 
@@ -18,6 +19,7 @@
 #include <openssl/ec.h>
 #include <openssl/ecdh.h>
 #include <openssl/ecdsa.h>
+#include <openssl/err.h>
 #include <openssl/obj_mac.h>
 #include <openssl/rand.h>
 #include <openssl/rsa.h>
@@ -94,6 +96,12 @@ bool cjose_jwk_release(cjose_jwk_t *jwk)
         free(jwk->kid);
         jwk->kid = NULL;
 
+        // signatures verified with this key must not outlive it
+        if (jwk->cached)
+        {
+            _cjose_cache_forget(jwk);
+        }
+
         // assumes freefunc is set
         assert(NULL != jwk->fns->free);
         jwk->fns->free(jwk);
@@ -269,12 +277,167 @@ static const key_fntable OCT_FNTABLE = {
     _oct_private_fields
 };
 
+static const EVP_MD *_oct_hmac_md(size_t alg)
+{
+    switch (alg)
+    {
+        case CJOSE_JWK_HMAC_SHA256:
+            return EVP_sha256();
+        case CJOSE_JWK_HMAC_SHA384:
+            return EVP_sha384();
+        case CJOSE_JWK_HMAC_SHA512:
+            return EVP_sha512();
+    }
+    return NULL;
+}
+
+static void _oct_hmac_free(oct_hmac *hmac)
+{
+    if (NULL == hmac)
+    {
+        return;
+    }
+    for (size_t alg = 0; alg < CJOSE_JWK_HMAC_COUNT; ++alg)
+    {
+        if (NULL != hmac->inner[alg])
+        {
+            EVP_MD_CTX_destroy(hmac->inner[alg]);
+        }
+        if (NULL != hmac->outer[alg])
+        {
+            EVP_MD_CTX_destroy(hmac->outer[alg]);
+        }
+    }
+    free(hmac);
+}
+
+// hashes one block of key ^ pad into a new digest context
+static EVP_MD_CTX *_oct_hmac_pad(
+        const EVP_MD *md,
+        const uint8_t *key,
+        size_t key_len,
+        uint8_t pad,
+        cjose_err *err)
+{
+    uint8_t block[EVP_MAX_MD_SIZE * 2];
+    size_t block_len = EVP_MD_block_size(md);
+    EVP_MD_CTX *ctx = NULL;
+
+    assert(block_len <= sizeof(block) && key_len <= block_len);
+    memset(block, pad, block_len);
+    for (size_t i = 0; i < key_len; ++i)
+    {
+        block[i] ^= key[i];
+    }
+
+    ctx = EVP_MD_CTX_create();
+    if (NULL == ctx)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        goto _oct_hmac_pad_cleanup;
+    }
+    if (EVP_DigestInit_ex(ctx, md, NULL) != 1 ||
+            EVP_DigestUpdate(ctx, block, block_len) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        EVP_MD_CTX_destroy(ctx);
+        ctx = NULL;
+    }
+
+    _oct_hmac_pad_cleanup:
+    OPENSSL_cleanse(block, sizeof(block));
+    return ctx;
+}
+
+// precomputes the inner and outer HMAC states of an oct key (RFC 2104), so
+// that every HMAC with the key starts from them instead of re-keying
+static oct_hmac *_oct_hmac_new(
+        const uint8_t *key, size_t key_len, cjose_err *err)
+{
+    uint8_t hashed[EVP_MAX_MD_SIZE];
+    unsigned int hashed_len = 0;
+
+    oct_hmac *hmac = (oct_hmac *)malloc(sizeof(oct_hmac));
+    if (NULL == hmac)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return NULL;
+    }
+    memset(hmac, 0, sizeof(oct_hmac));
+
+    for (size_t alg = 0; alg < CJOSE_JWK_HMAC_COUNT; ++alg)
+    {
+        const EVP_MD *md = _oct_hmac_md(alg);
+        const uint8_t *k = key;
+        size_t k_len = key_len;
+
+        // keys longer than a block are hashed first
+        if (k_len > (size_t)EVP_MD_block_size(md))
+        {
+            if (EVP_Digest(key, key_len, hashed, &hashed_len, md, NULL) != 1)
+            {
+                CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+                _oct_hmac_free(hmac);
+                return NULL;
+            }
+            k = hashed;
+            k_len = hashed_len;
+        }
+
+        hmac->inner[alg] = _oct_hmac_pad(md, k, k_len, 0x36, err);
+        hmac->outer[alg] = _oct_hmac_pad(md, k, k_len, 0x5c, err);
+        if (NULL == hmac->inner[alg] || NULL == hmac->outer[alg])
+        {
+            OPENSSL_cleanse(hashed, sizeof(hashed));
+            _oct_hmac_free(hmac);
+            return NULL;
+        }
+    }
+
+    OPENSSL_cleanse(hashed, sizeof(hashed));
+    return hmac;
+}
+
+static EVP_CIPHER_CTX *_oct_gcm_new(const uint8_t *k, cjose_err *err)
+{
+    // key the cipher once; each message then only sets its IV
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    if (NULL == ctx || 
+            EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, k, NULL) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        EVP_CIPHER_CTX_free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
 static cjose_jwk_t *_oct_new(uint8_t *buffer, size_t keysize, cjose_err *err)
 {
+    oct_hmac *hmac = _oct_hmac_new(buffer, keysize / 8, err);
+    if (NULL == hmac)
+    {
+        return NULL;
+    }
+
+    // only a 256-bit key can be used for A256GCM (with dir)
+    EVP_CIPHER_CTX *gcm = NULL;
+    if (256 == keysize)
+    {
+        gcm = _oct_gcm_new(buffer, err);
+        if (NULL == gcm)
+        {
+            _oct_hmac_free(hmac);
+            return NULL;
+        }
+    }
+
     cjose_jwk_t *jwk = (cjose_jwk_t *)malloc(sizeof(cjose_jwk_t));
     if (NULL == jwk)
     {
         CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        _oct_hmac_free(hmac);
+        EVP_CIPHER_CTX_free(gcm);
     }
     else
     {
@@ -284,6 +447,8 @@ static cjose_jwk_t *_oct_new(uint8_t *buffer, size_t keysize, cjose_err *err)
         jwk->keysize = keysize;
         jwk->keydata = buffer;
         jwk->fns = &OCT_FNTABLE;
+        jwk->hmac = hmac;
+        jwk->gcm = gcm;
     }
 
     return jwk;
@@ -297,6 +462,10 @@ static void _oct_free(cjose_jwk_t *jwk)
     {
         free(buffer);
     }
+    _oct_hmac_free(jwk->hmac);
+    jwk->hmac = NULL;
+    EVP_CIPHER_CTX_free(jwk->gcm);
+    jwk->gcm = NULL;
     free(jwk);
 }
 
@@ -415,6 +584,76 @@ cjose_jwk_t * cjose_jwk_create_oct_spec(
     return NULL;
 }
 
+bool _cjose_jwk_hmac_init(
+        const cjose_jwk_t *jwk,
+        size_t alg,
+        EVP_MD_CTX *ctx,
+        cjose_err *err)
+{
+    if (NULL == jwk || CJOSE_JWK_KTY_OCT != jwk->kty || NULL == jwk->hmac ||
+            CJOSE_JWK_HMAC_COUNT <= alg)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    if (EVP_MD_CTX_copy_ex(ctx, jwk->hmac->inner[alg]) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        return false;
+    }
+
+    return true;
+}
+
+bool _cjose_jwk_hmac_final(
+        const cjose_jwk_t *jwk,
+        size_t alg,
+        EVP_MD_CTX *ctx,
+        uint8_t *mac,
+        unsigned int *mac_len,
+        cjose_err *err)
+{
+    uint8_t inner[EVP_MAX_MD_SIZE];
+    unsigned int inner_len = 0;
+
+    // HMAC = H(K ^ opad, H(K ^ ipad, text))
+    if (EVP_DigestFinal_ex(ctx, inner, &inner_len) != 1 ||
+            EVP_MD_CTX_copy_ex(ctx, jwk->hmac->outer[alg]) != 1 ||
+            EVP_DigestUpdate(ctx, inner, inner_len) != 1 ||
+            EVP_DigestFinal_ex(ctx, mac, mac_len) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        return false;
+    }
+
+    return true;
+}
+
+bool _cjose_jwk_gcm_init(
+        const cjose_jwk_t *jwk,
+        EVP_CIPHER_CTX *ctx,
+        int enc,
+        const uint8_t *iv,
+        cjose_err *err)
+{
+    if (NULL == jwk || CJOSE_JWK_KTY_OCT != jwk->kty || NULL == jwk->gcm)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // the keyed context is only read, so any number of threads can copy it
+    if (EVP_CIPHER_CTX_copy(ctx, jwk->gcm) != 1 ||
+            EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, enc) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        return false;
+    }
+
+    return true;
+}
+
 //////////////// Elliptic Curve ////////////////
 // internal data & functions -- Elliptic Curve
 
@@ -543,6 +782,14 @@ static cjose_jwk_t *_EC_new(cjose_jwk_ec_curve crv, EC_KEY *ec, cjose_err *err)
     jwk->keydata = keydata;
     jwk->fns = &EC_FNTABLE;
 
+    // a signing key gets its generator multiples precomputed once, here,
+    // rather than on every signature; failing only loses the speed-up
+    if (NULL != EC_KEY_get0_private_key(ec) && 
+            1 != EC_KEY_precompute_mult(ec, NULL))
+    {
+        ERR_clear_error();
+    }
+
     return jwk;
 }
 
@@ -885,7 +1132,7 @@ cjose_jwk_t *cjose_jwk_create_EC_spec(
         CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
         goto create_EC_failed;
     }
-    
+
     jwk = _EC_new(spec->crv, ec, err);
     if (!jwk)
     {
@@ -947,6 +1194,67 @@ static const key_fntable RSA_FNTABLE = {
     _RSA_private_fields
 };
 
+// whether new RSA keys are warmed up (see cjose_jwk_set_RSA_warmup)
+static bool _rsa_warmup = false;
+
+void cjose_jwk_set_RSA_warmup(bool warmup)
+{
+    _rsa_warmup = warmup;
+}
+
+bool cjose_jwk_get_RSA_warmup()
+{
+    return _rsa_warmup;
+}
+
+static void _RSA_warmup(RSA *rsa)
+{
+    // this is only ever an optimization: whatever cannot be set up here is
+    // built on first use, as it would have been anyway
+    BN_CTX *ctx = BN_CTX_new();
+    if (NULL == ctx)
+    {
+        ERR_clear_error();
+        return;
+    }
+
+    // Montgomery contexts for the modulus (public key operations) and the
+    // primes (private key operations, by the CRT)
+    if ((rsa->flags & RSA_FLAG_CACHE_PUBLIC) && NULL != rsa->n)
+    {
+        BN_MONT_CTX_set_locked(
+                &rsa->_method_mod_n, CRYPTO_LOCK_RSA, rsa->n, ctx);
+    }
+    if ((rsa->flags & RSA_FLAG_CACHE_PRIVATE) && 
+            NULL != rsa->p && NULL != rsa->q)
+    {
+        BN_MONT_CTX_set_locked(
+                &rsa->_method_mod_p, CRYPTO_LOCK_RSA, rsa->p, ctx);
+        BN_MONT_CTX_set_locked(
+                &rsa->_method_mod_q, CRYPTO_LOCK_RSA, rsa->q, ctx);
+    }
+
+    // blinding for private key operations: one for this thread, and the
+    // one every other thread shares
+    if (!(rsa->flags & RSA_FLAG_NO_BLINDING) && 
+            NULL != rsa->d && NULL != rsa->e)
+    {
+        if (NULL == rsa->blinding)
+        {
+            rsa->blinding = RSA_setup_blinding(rsa, ctx);
+        }
+        if (NULL == rsa->mt_blinding)
+        {
+            rsa->mt_blinding = RSA_setup_blinding(rsa, ctx);
+        }
+    }
+
+    // failures here are not reported, so they must not be left queued for
+    // an unrelated call to find
+    ERR_clear_error();
+    BN_CTX_free(ctx);
+}
+
 static inline cjose_jwk_t *_RSA_new(RSA *rsa, cjose_err *err)
 {
     cjose_jwk_t *jwk = malloc(sizeof(cjose_jwk_t));
@@ -962,6 +1270,11 @@ static inline cjose_jwk_t *_RSA_new(RSA *rsa, cjose_err *err)
     jwk->keydata = rsa;
     jwk->fns = &RSA_FNTABLE;
 
+    if (_rsa_warmup)
+    {
+        _RSA_warmup(rsa);
+    }
+
     return jwk;
 }
 
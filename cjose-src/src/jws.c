@@ -9,6 +9,9 @@
 #include <assert.h>
 #include <openssl/evp.h>
 #include <openssl/rsa.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/bn.h>
 #include <openssl/err.h>
 #include "cjose/base64.h"
 #include "cjose/jws.h"
@@ -17,12 +20,69 @@
 #include "include/jwk_int.h"
 #include "cjose/header.h"
 #include "include/header_int.h"
+#include "include/thread_int.h"
+#include "include/cache_int.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////
-static bool _cjose_jws_build_dig_sha256(
+static bool _cjose_jws_dig_init_sha256(
         cjose_jws_t *jws,
         const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err);
+
+static bool _cjose_jws_dig_init_sha384(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err);
+
+static bool _cjose_jws_dig_init_sha512(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err);
+
+static bool _cjose_jws_dig_final_md(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err);
+
+static bool _cjose_jws_dig_init_hs256(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err);
+
+static bool _cjose_jws_dig_final_hs256(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err);
+
+static bool _cjose_jws_dig_init_hs384(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err);
+
+static bool _cjose_jws_dig_final_hs384(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err);
+
+static bool _cjose_jws_dig_init_hs512(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err);
+
+static bool _cjose_jws_dig_final_hs512(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
         cjose_err *err);
 
 static bool _cjose_jws_build_sig_ps256(
@@ -45,6 +105,94 @@ static bool _cjose_jws_verify_sig_rs256(
         const cjose_jwk_t *jwk, 
         cjose_err *err);
 
+static bool _cjose_jws_build_sig_hmac(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        cjose_err *err);
+
+static bool _cjose_jws_verify_sig_hmac(
+        cjose_jws_t *jws, 
+        const cjose_jwk_t *jwk, 
+        cjose_err *err);
+
+static bool _cjose_jws_build_sig_ecdsa(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        cjose_err *err);
+
+static bool _cjose_jws_verify_sig_ecdsa(
+        cjose_jws_t *jws, 
+        const cjose_jwk_t *jwk, 
+        cjose_err *err);
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_reserve(
+        void **buf,
+        size_t *cap,
+        size_t len,
+        cjose_err *err)
+{
+    // a buffer kept from an earlier use of the JWS may be big enough already
+    if (NULL != *buf && len <= *cap)
+    {
+        return true;
+    }
+
+    // its contents are about to be replaced, so there is nothing to copy
+    free(*buf);
+    *cap = 0;
+    *buf = malloc((0 < len) ? len : 1);
+    if (NULL == *buf)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return false;
+    }
+    *cap = len;
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static EVP_MD_CTX *_cjose_jws_md_ctx(
+        cjose_jws_t *jws,
+        cjose_err *err)
+{
+    // the context is kept with the JWS, so that signing into it again does
+    // not allocate another
+    if (NULL == jws->ctx)
+    {
+        jws->ctx = EVP_MD_CTX_create();
+        if (NULL == jws->ctx)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        }
+    }
+
+    return jws->ctx;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_build_sig_b64u(
+        cjose_jws_t *jws,
+        cjose_err *err)
+{
+    // base64url encode the signature
+    if (!_cjose_jws_reserve((void **)&jws->sig_b64u, &jws->sig_b64u_cap, 
+            cjose_base64url_encoded_len(jws->sig_len) + 1, err) ||
+            !cjose_base64url_encode_into(jws->sig, jws->sig_len, 
+                    jws->sig_b64u, jws->sig_b64u_cap, 
+                    &jws->sig_b64u_len, err))
+    {
+        return false;
+    }
+    jws->sig_b64u[jws->sig_b64u_len] = 0;
+
+    return true;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
 static bool _cjose_jws_build_hdr(
@@ -63,12 +211,17 @@ static bool _cjose_jws_build_hdr(
         CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
         return false;
     }
-    if (!cjose_base64url_encode((const uint8_t *)hdr_str, strlen(hdr_str), 
-        &jws->hdr_b64u, &jws->hdr_b64u_len, err))
+    size_t hdr_len = strlen(hdr_str);
+    if (!_cjose_jws_reserve((void **)&jws->hdr_b64u, &jws->hdr_b64u_cap, 
+            cjose_base64url_encoded_len(hdr_len) + 1, err) ||
+            !cjose_base64url_encode_into((const uint8_t *)hdr_str, hdr_len, 
+                    jws->hdr_b64u, jws->hdr_b64u_cap, 
+                    &jws->hdr_b64u_len, err))
     {
         free(hdr_str);
         return false;        
     }
+    jws->hdr_b64u[jws->hdr_b64u_len] = 0;
     free(hdr_str);
     
     return true;
@@ -76,30 +229,80 @@ static bool _cjose_jws_build_hdr(
 
 
 ////////////////////////////////////////////////////////////////////////////////
-static bool _cjose_jws_validate_hdr(
-        cjose_jws_t *jws,
+static bool _cjose_jws_resolve_fns(
+        json_t *hdr,
+        jws_fntable *fns,
         cjose_err *err)
 {
     // make sure we have an alg header
-    json_t *alg_obj = json_object_get(jws->hdr, CJOSE_HDR_ALG);
+    json_t *alg_obj = json_object_get(hdr, CJOSE_HDR_ALG);
     if (NULL == alg_obj)
     {
         CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
         return false;
     }
     const char *alg = json_string_value(alg_obj);
+    if (NULL == alg)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
 
     if (strcmp(alg, CJOSE_HDR_ALG_PS256) == 0)
     {
-        jws->fns.digest = _cjose_jws_build_dig_sha256;
-        jws->fns.sign = _cjose_jws_build_sig_ps256;
-        jws->fns.verify = _cjose_jws_verify_sig_ps256;
+        fns->digest_init = _cjose_jws_dig_init_sha256;
+        fns->digest_final = _cjose_jws_dig_final_md;
+        fns->sign = _cjose_jws_build_sig_ps256;
+        fns->verify = _cjose_jws_verify_sig_ps256;
     }
     else if (strcmp(alg, CJOSE_HDR_ALG_RS256) == 0)
     {
-        jws->fns.digest = _cjose_jws_build_dig_sha256;
-        jws->fns.sign = _cjose_jws_build_sig_rs256;
-        jws->fns.verify = _cjose_jws_verify_sig_rs256;
+        fns->digest_init = _cjose_jws_dig_init_sha256;
+        fns->digest_final = _cjose_jws_dig_final_md;
+        fns->sign = _cjose_jws_build_sig_rs256;
+        fns->verify = _cjose_jws_verify_sig_rs256;
+    }
+    else if (strcmp(alg, CJOSE_HDR_ALG_ES256) == 0)
+    {
+        fns->digest_init = _cjose_jws_dig_init_sha256;
+        fns->digest_final = _cjose_jws_dig_final_md;
+        fns->sign = _cjose_jws_build_sig_ecdsa;
+        fns->verify = _cjose_jws_verify_sig_ecdsa;
+    }
+    else if (strcmp(alg, CJOSE_HDR_ALG_ES384) == 0)
+    {
+        fns->digest_init = _cjose_jws_dig_init_sha384;
+        fns->digest_final = _cjose_jws_dig_final_md;
+        fns->sign = _cjose_jws_build_sig_ecdsa;
+        fns->verify = _cjose_jws_verify_sig_ecdsa;
+    }
+    else if (strcmp(alg, CJOSE_HDR_ALG_ES512) == 0)
+    {
+        fns->digest_init = _cjose_jws_dig_init_sha512;
+        fns->digest_final = _cjose_jws_dig_final_md;
+        fns->sign = _cjose_jws_build_sig_ecdsa;
+        fns->verify = _cjose_jws_verify_sig_ecdsa;
+    }
+    else if (strcmp(alg, CJOSE_HDR_ALG_HS256) == 0)
+    {
+        fns->digest_init = _cjose_jws_dig_init_hs256;
+        fns->digest_final = _cjose_jws_dig_final_hs256;
+        fns->sign = _cjose_jws_build_sig_hmac;
+        fns->verify = _cjose_jws_verify_sig_hmac;
+    }
+    else if (strcmp(alg, CJOSE_HDR_ALG_HS384) == 0)
+    {
+        fns->digest_init = _cjose_jws_dig_init_hs384;
+        fns->digest_final = _cjose_jws_dig_final_hs384;
+        fns->sign = _cjose_jws_build_sig_hmac;
+        fns->verify = _cjose_jws_verify_sig_hmac;
+    }
+    else if (strcmp(alg, CJOSE_HDR_ALG_HS512) == 0)
+    {
+        fns->digest_init = _cjose_jws_dig_init_hs512;
+        fns->digest_final = _cjose_jws_dig_final_hs512;
+        fns->sign = _cjose_jws_build_sig_hmac;
+        fns->verify = _cjose_jws_verify_sig_hmac;
     }
     else
     {
@@ -111,6 +314,48 @@ static bool _cjose_jws_validate_hdr(
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_hdr_unencoded(
+        json_t *hdr,
+        bool *unencoded,
+        cjose_err *err)
+{
+    *unencoded = false;
+    json_t *b64 = json_object_get(hdr, CJOSE_HDR_B64);
+    if (NULL == b64)
+    {
+        return true;
+    }
+
+    // b64 (RFC 7797) must be a boolean, and listed as critical
+    bool listed = false;
+    json_t *crit = json_object_get(hdr, CJOSE_HDR_CRIT);
+    for (size_t i = 0; json_is_array(crit) && i < json_array_size(crit); ++i)
+    {
+        const char *name = json_string_value(json_array_get(crit, i));
+        listed = listed || (NULL != name && strcmp(name, CJOSE_HDR_B64) == 0);
+    }
+    if (!json_is_boolean(b64) || !listed)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    *unencoded = json_is_false(b64);
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_validate_hdr(
+        cjose_jws_t *jws,
+        cjose_err *err)
+{
+    return _cjose_jws_resolve_fns(jws->hdr, &jws->fns, err) &&
+            _cjose_jws_hdr_unencoded(jws->hdr, &jws->unencoded, err);
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 static bool _cjose_jws_build_dat(
         cjose_jws_t *jws,
@@ -120,176 +365,428 @@ static bool _cjose_jws_build_dat(
 {
     // copy plaintext data
     jws->dat_len = plaintext_len;
-    jws->dat = (uint8_t *)malloc(jws->dat_len);
-    if (NULL == jws->dat)
+    if (!_cjose_jws_reserve((void **)&jws->dat, &jws->dat_cap, 
+            jws->dat_len, err))
     {
-        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
         return false;
     }
     memcpy(jws->dat, plaintext, jws->dat_len);
 
-    // base64url encode data
-    if (!cjose_base64url_encode((const uint8_t *)plaintext, 
-        plaintext_len, &jws->dat_b64u, &jws->dat_b64u_len, err))
+    // base64url encode data (on several threads if it is large)
+    if (!_cjose_jws_reserve((void **)&jws->dat_b64u, &jws->dat_b64u_cap, 
+            cjose_base64url_encoded_len(plaintext_len) + 1, err) ||
+            !cjose_base64url_encode_parallel_into(plaintext, plaintext_len, 
+                    jws->dat_b64u, jws->dat_b64u_cap, &jws->dat_b64u_len, 
+                    cjose_base64_get_parallel_threads(), err))
     {
         return false;
     }
+    jws->dat_b64u[jws->dat_b64u_len] = 0;
 
     return true;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-static bool _cjose_jws_build_dig_sha256(
+static bool _cjose_jws_dig_init_md(
         cjose_jws_t *jws,
-        const cjose_jwk_t *jwk,
+        const EVP_MD *digest_alg,
+        EVP_MD_CTX *ctx,
         cjose_err *err)
 {
-    bool retval = false;
-    EVP_MD_CTX *ctx = NULL;
-
-    // build digest using SHA-256 digest algorithm
-    const EVP_MD *digest_alg = EVP_sha256();
-    if (NULL == digest_alg)
+    // begin digest as DIGEST(B64U(HEADER).B64U(DATA))
+    if (NULL == digest_alg ||
+            EVP_DigestInit_ex(ctx, digest_alg, NULL) != 1 ||
+            EVP_DigestUpdate(ctx, jws->hdr_b64u, jws->hdr_b64u_len) != 1 ||
+            EVP_DigestUpdate(ctx, ".", 1) != 1)
     {
         CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_build_dig_sha256_cleanup;
+        return false;
     }
 
-    // allocate buffer for digest
-    jws->dig_len = digest_alg->md_size;
-    jws->dig = (uint8_t *)malloc(jws->dig_len);
-    if (NULL == jws->dig)
-    {
-        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
-        goto _cjose_jws_build_dig_sha256_cleanup;
-    }
+    return true;
+}
 
-    // instantiate and initialize a new mac digest context
-    ctx = EVP_MD_CTX_create();
-    if (NULL == ctx)
-    {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_build_dig_sha256_cleanup;
-    }
-    EVP_MD_CTX_init(ctx);
 
-    // create digest as DIGEST(B64U(HEADER).B64U(DATA))
-    if (EVP_DigestInit_ex(ctx, digest_alg, NULL) != 1)
-    {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_build_dig_sha256_cleanup;
-    }
-    if (EVP_DigestUpdate(ctx, jws->hdr_b64u, jws->hdr_b64u_len) != 1)
-    {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_build_dig_sha256_cleanup;
-    }
-    if (EVP_DigestUpdate(ctx, ".", 1) != 1)
-    {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_build_dig_sha256_cleanup;
-    }
-    if (EVP_DigestUpdate(ctx, jws->dat_b64u, jws->dat_b64u_len) != 1)
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_dig_init_sha256(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err)
+{
+    return _cjose_jws_dig_init_md(jws, EVP_sha256(), ctx, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_dig_init_sha384(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err)
+{
+    return _cjose_jws_dig_init_md(jws, EVP_sha384(), ctx, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_dig_init_sha512(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err)
+{
+    return _cjose_jws_dig_init_md(jws, EVP_sha512(), ctx, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_dig_final_md(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err)
+{
+    // allocate buffer for digest (reusing any from signing, when a JWS is
+    // verified after it was signed or is signed into again)
+    jws->dig_len = EVP_MD_CTX_size(ctx);
+    if (!_cjose_jws_reserve((void **)&jws->dig, &jws->dig_cap, 
+            jws->dig_len, err))
     {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_build_dig_sha256_cleanup;
+        return false;
     }
+
     if (EVP_DigestFinal_ex(ctx, jws->dig, NULL) != 1)
     {
         CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_build_dig_sha256_cleanup;
-    }
-
-    // if we got this far - success
-    retval = true;
-
-    _cjose_jws_build_dig_sha256_cleanup:
-    if (NULL != ctx)
-    {
-        EVP_MD_CTX_destroy(ctx);
+        return false;
     }
 
-    return retval;
+    return true;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-static bool _cjose_jws_build_sig_ps256(
+static bool _cjose_jws_dig_init_hmac(
         cjose_jws_t *jws,
         const cjose_jwk_t *jwk,
+        size_t alg,
+        EVP_MD_CTX *ctx,
         cjose_err *err)
 {
-    bool retval = false;
-    uint8_t *em = NULL;
-    size_t em_len = 0;
-
-    // ensure jwk is RSA
-    if (jwk->kty != CJOSE_JWK_KTY_RSA)
+    // ensure jwk is a symmetric key at least as long as the hash output
+    // (RFC 7518 section 3.2)
+    size_t min_keysize = (CJOSE_JWK_HMAC_SHA256 == alg) ? 256 : 
+            (CJOSE_JWK_HMAC_SHA384 == alg) ? 384 : 512;
+    if (NULL == jwk || jwk->kty != CJOSE_JWK_KTY_OCT || 
+            jwk->keysize < min_keysize)
     {
         CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-        goto _cjose_jws_build_sig_ps256_cleanup;
-    }
-
-    // currently only support SHA-256 digest algorithm
-    const EVP_MD *digest_alg = EVP_sha256();
-    if (NULL == digest_alg)
-    {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_build_sig_ps256_cleanup;
+        return false;
     }
 
-    // apply EMSA-PSS encoding (RFC-3447, 8.1.1, step 1)
-    // (RSA_padding_add_PKCS1_PSS includes PKCS1_MGF1, -1 => saltlen = hashlen)
-    em_len = RSA_size((RSA *)jwk->keydata);
-    em = (uint8_t *)malloc(em_len);
-    if (NULL == em)
+    // begin digest as HMAC(B64U(HEADER).B64U(DATA)), starting from the key's
+    // precomputed inner state
+    if (!_cjose_jwk_hmac_init(jwk, alg, ctx, err))
     {
-        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
-        goto _cjose_jws_build_sig_ps256_cleanup;        
+        return false;
     }
-    if (RSA_padding_add_PKCS1_PSS((RSA *)jwk->keydata, 
-            em, jws->dig, digest_alg, -1) != 1)
+    if (EVP_DigestUpdate(ctx, jws->hdr_b64u, jws->hdr_b64u_len) != 1 ||
+            EVP_DigestUpdate(ctx, ".", 1) != 1)
     {
         CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_build_sig_ps256_cleanup;
+        return false;
     }
 
-    // sign the digest (RFC-3447, 8.1.1, step 2)
-    jws->sig_len = em_len;
-    jws->sig = (uint8_t *)malloc(jws->sig_len);
-    if (NULL == jws->sig)
-    {
-        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
-        goto _cjose_jws_build_sig_ps256_cleanup;
-    }
+    return true;
+}
 
-    if (RSA_private_encrypt(em_len, em, jws->sig, 
-            (RSA *)jwk->keydata, RSA_NO_PADDING) != jws->sig_len)
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_dig_final_hmac(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        size_t alg,
+        EVP_MD_CTX *ctx,
+        cjose_err *err)
+{
+    bool retval = false;
+    uint8_t mac[EVP_MAX_MD_SIZE];
+    unsigned int mac_len = 0;
+
+    if (!_cjose_jwk_hmac_final(jwk, alg, ctx, mac, &mac_len, err))
     {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_build_sig_ps256_cleanup;
+        goto _cjose_jws_dig_final_hmac_cleanup;
     }
 
-    // base64url encode signed digest
-    if (!cjose_base64url_encode((const uint8_t *)jws->sig, jws->sig_len, 
-            &jws->sig_b64u, &jws->sig_b64u_len, err))
+    // keep the tag as the digest (reusing any buffer from signing)
+    jws->dig_len = mac_len;
+    if (!_cjose_jws_reserve((void **)&jws->dig, &jws->dig_cap, 
+            jws->dig_len, err))
     {
-        goto _cjose_jws_build_sig_ps256_cleanup;
+        goto _cjose_jws_dig_final_hmac_cleanup;
     }
+    memcpy(jws->dig, mac, jws->dig_len);
 
     // if we got this far - success
     retval = true;
 
-    _cjose_jws_build_sig_ps256_cleanup:
-    free(em);
+    _cjose_jws_dig_final_hmac_cleanup:
+    OPENSSL_cleanse(mac, sizeof(mac));
 
     return retval;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-static bool _cjose_jws_build_sig_rs256(
+static bool _cjose_jws_dig_init_hs256(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err)
+{
+    return _cjose_jws_dig_init_hmac(jws, jwk, CJOSE_JWK_HMAC_SHA256, ctx, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_dig_final_hs256(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err)
+{
+    return _cjose_jws_dig_final_hmac(jws, jwk, CJOSE_JWK_HMAC_SHA256, ctx, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_dig_init_hs384(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err)
+{
+    return _cjose_jws_dig_init_hmac(jws, jwk, CJOSE_JWK_HMAC_SHA384, ctx, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_dig_final_hs384(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err)
+{
+    return _cjose_jws_dig_final_hmac(jws, jwk, CJOSE_JWK_HMAC_SHA384, ctx, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_dig_init_hs512(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err)
+{
+    return _cjose_jws_dig_init_hmac(jws, jwk, CJOSE_JWK_HMAC_SHA512, ctx, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_dig_final_hs512(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        EVP_MD_CTX *ctx,
+        cjose_err *err)
+{
+    return _cjose_jws_dig_final_hmac(jws, jwk, CJOSE_JWK_HMAC_SHA512, ctx, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_build_dig(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        cjose_err *err)
+{
+    // get the digest context, for the JWS algorithm to initialize
+    EVP_MD_CTX *ctx = _cjose_jws_md_ctx(jws, err);
+    if (NULL == ctx)
+    {
+        return false;
+    }
+
+    // create digest from the encoded header and the data, which is hashed
+    // as it is if unencoded
+    if (!jws->fns.digest_init(jws, jwk, ctx, err))
+    {
+        return false;
+    }
+    if (jws->unencoded ? 
+            EVP_DigestUpdate(ctx, jws->dat, jws->dat_len) != 1 :
+            EVP_DigestUpdate(ctx, jws->dat_b64u, jws->dat_b64u_len) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        return false;
+    }
+
+    return jws->fns.digest_final(jws, jwk, ctx, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_build_dat_dig(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
+{
+    // a large payload that may be encoded on several threads is quicker to
+    // encode in full first, and hash afterwards
+    if (!jws->unencoded && 1 != cjose_base64_get_parallel_threads() &&
+            CJOSE_BASE64_PARALLEL_MIN <= plaintext_len)
+    {
+        return _cjose_jws_build_dat(jws, plaintext, plaintext_len, err) &&
+                _cjose_jws_build_dig(jws, jwk, err);
+    }
+
+    // copy plaintext data
+    jws->dat_len = plaintext_len;
+    if (!_cjose_jws_reserve((void **)&jws->dat, &jws->dat_cap, 
+            jws->dat_len, err))
+    {
+        return false;
+    }
+    memcpy(jws->dat, plaintext, jws->dat_len);
+
+    // an unencoded payload is hashed as it is, and not encoded at all
+    if (jws->unencoded)
+    {
+        return _cjose_jws_build_dig(jws, jwk, err);
+    }
+
+    // allocate buffer for the encoded data
+    jws->dat_b64u_len = cjose_base64url_encoded_len(plaintext_len);
+    if (!_cjose_jws_reserve((void **)&jws->dat_b64u, &jws->dat_b64u_cap, 
+            jws->dat_b64u_len + 1, err))
+    {
+        return false;
+    }
+    jws->dat_b64u[jws->dat_b64u_len] = 0;
+
+    EVP_MD_CTX *ctx = _cjose_jws_md_ctx(jws, err);
+    if (NULL == ctx || !jws->fns.digest_init(jws, jwk, ctx, err))
+    {
+        return false;
+    }
+
+    // encode the data a block at a time, hashing each block of text while
+    // it is still in cache (blocks are whole groups, so only the last one
+    // can be partial)
+    size_t pos = 0;
+    for (size_t idx = 0; idx < plaintext_len; idx += CJOSE_JWS_DIG_BLOCK_LEN)
+    {
+        size_t len = plaintext_len - idx;
+        size_t enc_len = 0;
+        if (len > CJOSE_JWS_DIG_BLOCK_LEN)
+        {
+            len = CJOSE_JWS_DIG_BLOCK_LEN;
+        }
+
+        if (!cjose_base64url_encode_into(plaintext + idx, len, 
+                jws->dat_b64u + pos, jws->dat_b64u_len - pos, &enc_len, err))
+        {
+            return false;
+        }
+        if (EVP_DigestUpdate(ctx, jws->dat_b64u + pos, enc_len) != 1)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+            return false;
+        }
+        pos += enc_len;
+    }
+
+    return jws->fns.digest_final(jws, jwk, ctx, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_build_sig_ps256(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        cjose_err *err)
+{
+    bool retval = false;
+    uint8_t *em = NULL;
+    size_t em_len = 0;
+
+    // ensure jwk is RSA
+    if (jwk->kty != CJOSE_JWK_KTY_RSA)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        goto _cjose_jws_build_sig_ps256_cleanup;
+    }
+
+    // currently only support SHA-256 digest algorithm
+    const EVP_MD *digest_alg = EVP_sha256();
+    if (NULL == digest_alg)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_jws_build_sig_ps256_cleanup;
+    }
+
+    // apply EMSA-PSS encoding (RFC-3447, 8.1.1, step 1)
+    // (RSA_padding_add_PKCS1_PSS includes PKCS1_MGF1, -1 => saltlen = hashlen)
+    em_len = RSA_size((RSA *)jwk->keydata);
+    em = (uint8_t *)malloc(em_len);
+    if (NULL == em)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        goto _cjose_jws_build_sig_ps256_cleanup;        
+    }
+    if (RSA_padding_add_PKCS1_PSS((RSA *)jwk->keydata, 
+            em, jws->dig, digest_alg, -1) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_jws_build_sig_ps256_cleanup;
+    }
+
+    // sign the digest (RFC-3447, 8.1.1, step 2)
+    jws->sig_len = em_len;
+    if (!_cjose_jws_reserve((void **)&jws->sig, &jws->sig_cap, 
+            jws->sig_len, err))
+    {
+        goto _cjose_jws_build_sig_ps256_cleanup;
+    }
+
+    if (RSA_private_encrypt(em_len, em, jws->sig, 
+            (RSA *)jwk->keydata, RSA_NO_PADDING) != jws->sig_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_jws_build_sig_ps256_cleanup;
+    }
+
+    // base64url encode signed digest
+    if (!_cjose_jws_build_sig_b64u(jws, err))
+    {
+        goto _cjose_jws_build_sig_ps256_cleanup;
+    }
+
+    // if we got this far - success
+    retval = true;
+
+    _cjose_jws_build_sig_ps256_cleanup:
+    free(em);
+
+    return retval;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_build_sig_rs256(
         cjose_jws_t *jws,
         const cjose_jwk_t *jwk,
         cjose_err *err)
@@ -297,486 +794,2668 @@ static bool _cjose_jws_build_sig_rs256(
     // ensure jwk is RSA
     if (jwk->kty != CJOSE_JWK_KTY_RSA)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // allocate buffer for signature
+    jws->sig_len = RSA_size((RSA *)jwk->keydata);
+    if (!_cjose_jws_reserve((void **)&jws->sig, &jws->sig_cap, 
+            jws->sig_len, err))
+    {
+        return false;
+    }
+     
+    // RS256 signature is RSA encryption of the digest with PKCS #1 v1.5 padding
+    if (RSA_private_encrypt(jws->dig_len, jws->dig, jws->sig, 
+            (RSA *)jwk->keydata, RSA_PKCS1_PADDING) != jws->sig_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        return false;
+    }
+     
+    // base64url encode signed digest
+    return _cjose_jws_build_sig_b64u(jws, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_cser_len(
+        cjose_jws_t *jws,
+        size_t *cser_len,
+        cjose_err *err)
+{
+    // both sign and import should be setting these - but check just in case;
+    // a reset JWS keeps its buffers, so it is the lengths that tell
+    if (0 == jws->hdr_b64u_len || 
+            (NULL == jws->dat_b64u && !jws->unencoded) ||
+            0 == jws->sig_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_STATE);
+        return false;
+    }
+
+    // a signature decoded in place has no encoded copy of its own
+    if (NULL == jws->sig_b64u && !cjose_base64url_encode(
+            (const uint8_t *)jws->sig, jws->sig_len, 
+            &jws->sig_b64u, &jws->sig_b64u_len, err))
+    {
+        return false;
+    }
+
+    // an unencoded payload is detached, leaving the payload segment empty
+    size_t dat_b64u_len = jws->unencoded ? 0 : jws->dat_b64u_len;
+    *cser_len = jws->hdr_b64u_len + dat_b64u_len + jws->sig_b64u_len + 2;
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static void _cjose_jws_write_cser(
+        const cjose_jws_t *jws,
+        char *cser)
+{
+    // segments imported in place are not NULL-terminated, so copy by length
+    size_t dat_b64u_len = jws->unencoded ? 0 : jws->dat_b64u_len;
+    char *pos = cser;
+    memcpy(pos, jws->hdr_b64u, jws->hdr_b64u_len);
+    pos += jws->hdr_b64u_len;
+    *pos++ = '.';
+    if (0 < dat_b64u_len)
+    {
+        memcpy(pos, jws->dat_b64u, dat_b64u_len);
+        pos += dat_b64u_len;
+    }
+    *pos++ = '.';
+    memcpy(pos, jws->sig_b64u, jws->sig_b64u_len);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_build_cser(
+        cjose_jws_t *jws,
+        cjose_err *err)
+{
+    // compute length of compact serialization
+    size_t len = 0;
+    if (!_cjose_jws_cser_len(jws, &len, err))
+    {
+        return false;
+    }
+
+    // allocate buffer for compact serialization
+    assert(0 == jws->cser_len);
+    if (!_cjose_jws_reserve((void **)&jws->cser, &jws->cser_cap, 
+            len + 1, err))
+    {
+        return false;
+    }
+
+    // build the compact serialization
+    _cjose_jws_write_cser(jws, jws->cser);
+    jws->cser[len] = 0;
+    jws->cser_len = len + 1;
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_sign_dat(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
+{
+    // build the JWS data segment and JWS digest (hashed signing input
+    // value) together
+    if (!_cjose_jws_build_dat_dig(jws, jwk, plaintext, plaintext_len, err))
+    {
+        return false;
+    }
+
+    // sign the JWS digest; the compact serialization is built on export
+    return jws->fns.sign(jws, jwk, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_sign_hdr(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        cjose_header_t *header,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
+{
+    // build JWS header
+    if (!_cjose_jws_build_hdr(jws, header, err))
+    {
+        return false;
+    }
+
+    // validate JWS header
+    if (!_cjose_jws_validate_hdr(jws, err))
+    {
+        return false;
+    }
+
+    return _cjose_jws_sign_dat(jws, jwk, plaintext, plaintext_len, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+cjose_jws_t *cjose_jws_new(
+        cjose_err *err)
+{
+    cjose_jws_t *jws = (cjose_jws_t *)calloc(1, sizeof(cjose_jws_t));
+    if (NULL == jws)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return NULL;
+    }
+
+    return jws;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+cjose_jws_t *cjose_jws_sign(
+        const cjose_jwk_t *jwk,
+        cjose_header_t *header,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
+{
+    cjose_jws_t *jws = NULL;
+
+    if (NULL == jwk || NULL == header || NULL == plaintext)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return NULL;
+    }
+
+    // allocate and initialize JWS
+    jws = cjose_jws_new(err);
+    if (NULL == jws)
+    {
+        return NULL;
+    }
+
+    if (!_cjose_jws_sign_hdr(jws, jwk, header, plaintext, plaintext_len, err))
+    {
+        cjose_jws_release(jws);
+        return NULL;
+    }
+
+    return jws;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_sign_into(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        cjose_header_t *header,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
+{
+    if (NULL == jws || NULL == jwk || NULL == header || NULL == plaintext)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    cjose_jws_reset(jws);
+    return _cjose_jws_sign_hdr(jws, jwk, header, plaintext, plaintext_len, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+cjose_jws_template_t *cjose_jws_template_new(
+        cjose_header_t *header,
+        cjose_err *err)
+{
+    cjose_jws_template_t *tmpl = NULL;
+    char *hdr_str = NULL;
+
+    if (NULL == header)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return NULL;
+    }
+
+    tmpl = (cjose_jws_template_t *)calloc(1, sizeof(cjose_jws_template_t));
+    if (NULL == tmpl)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return NULL;
+    }
+
+    // freeze a copy of the header, so later changes to the caller's do not
+    // make it disagree with the encoded header
+    tmpl->hdr = json_deep_copy(header);
+    if (NULL == tmpl->hdr)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        goto _cjose_jws_template_new_fail;
+    }
+
+    if (!_cjose_jws_resolve_fns(tmpl->hdr, &tmpl->fns, err) ||
+            !_cjose_jws_hdr_unencoded(tmpl->hdr, &tmpl->unencoded, err))
+    {
+        goto _cjose_jws_template_new_fail;
+    }
+
+    // base64url encode the header once for every JWS signed with it
+    hdr_str = json_dumps(tmpl->hdr, JSON_ENCODE_ANY | JSON_PRESERVE_ORDER);
+    if (NULL == hdr_str)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        goto _cjose_jws_template_new_fail;
+    }
+    if (!cjose_base64url_encode((const uint8_t *)hdr_str, strlen(hdr_str),
+            &tmpl->hdr_b64u, &tmpl->hdr_b64u_len, err))
+    {
+        goto _cjose_jws_template_new_fail;
+    }
+    free(hdr_str);
+
+    return tmpl;
+
+    _cjose_jws_template_new_fail:
+    free(hdr_str);
+    cjose_jws_template_release(tmpl);
+    return NULL;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+void cjose_jws_template_release(cjose_jws_template_t *tmpl)
+{
+    if (NULL == tmpl)
+    {
+        return;
+    }
+
+    if (NULL != tmpl->hdr)
+    {
+        json_decref(tmpl->hdr);
+    }
+    free(tmpl->hdr_b64u);
+    free(tmpl);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_sign_tmpl(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        const cjose_jws_template_t *tmpl,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
+{
+    // any encoded header of the JWS's own (from an earlier use) is replaced
+    free(jws->hdr_b64u);
+    jws->hdr_b64u_cap = 0;
+
+    // borrow the template's header rather than taking a reference, as
+    // jansson's reference counts are not safe to change from several threads
+    jws->hdr = tmpl->hdr;
+    jws->hdr_b64u = tmpl->hdr_b64u;
+    jws->hdr_b64u_len = tmpl->hdr_b64u_len;
+    jws->fns = tmpl->fns;
+    jws->unencoded = tmpl->unencoded;
+    jws->views = CJOSE_JWS_VIEW_HDR | CJOSE_JWS_VIEW_HDR_B64U;
+
+    return _cjose_jws_sign_dat(jws, jwk, plaintext, plaintext_len, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+cjose_jws_t *cjose_jws_sign_with_template(
+        const cjose_jwk_t *jwk,
+        const cjose_jws_template_t *tmpl,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
+{
+    cjose_jws_t *jws = NULL;
+
+    if (NULL == jwk || NULL == tmpl || NULL == plaintext)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return NULL;
+    }
+
+    jws = cjose_jws_new(err);
+    if (NULL == jws)
+    {
+        return NULL;
+    }
+
+    if (!_cjose_jws_sign_tmpl(jws, jwk, tmpl, plaintext, plaintext_len, err))
+    {
+        cjose_jws_release(jws);
+        return NULL;
+    }
+
+    return jws;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_sign_with_template_into(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        const cjose_jws_template_t *tmpl,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
+{
+    if (NULL == jws || NULL == jwk || NULL == tmpl || NULL == plaintext)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    cjose_jws_reset(jws);
+    return _cjose_jws_sign_tmpl(jws, jwk, tmpl, plaintext, plaintext_len, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+void cjose_jws_reset(cjose_jws_t *jws)
+{
+    if (NULL == jws)
+    {
+        return;
+    }
+
+    if (NULL != jws->hdr && !(jws->views & CJOSE_JWS_VIEW_HDR))
+    {
+        json_decref(jws->hdr);
+    }
+    jws->hdr = NULL;
+
+    // let go of the members that point into a caller's buffer or a template;
+    // the buffers the JWS allocated itself are kept for its next use
+    if (jws->views & CJOSE_JWS_VIEW_HDR_B64U)
+    {
+        jws->hdr_b64u = NULL;
+        jws->hdr_b64u_cap = 0;
+    }
+    if (jws->views & CJOSE_JWS_VIEW_DAT)
+    {
+        jws->dat = NULL;
+        jws->dat_cap = 0;
+    }
+    if (jws->views & CJOSE_JWS_VIEW_DAT_B64U)
+    {
+        jws->dat_b64u = NULL;
+        jws->dat_b64u_cap = 0;
+    }
+    if (jws->views & CJOSE_JWS_VIEW_SIG)
+    {
+        jws->sig = NULL;
+        jws->sig_cap = 0;
+    }
+    if (jws->views & CJOSE_JWS_VIEW_SIG_B64U)
+    {
+        jws->sig_b64u = NULL;
+        jws->sig_b64u_cap = 0;
+    }
+    jws->views = 0;
+
+    jws->hdr_b64u_len = 0;
+    jws->dat_len = 0;
+    jws->dat_b64u_len = 0;
+    jws->dig_len = 0;
+    jws->sig_len = 0;
+    jws->sig_b64u_len = 0;
+    jws->cser_len = 0;
+    memset(&jws->fns, 0, sizeof(jws->fns));
+    jws->unencoded = false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+void cjose_jws_release(cjose_jws_t *jws)
+{
+    if (NULL == jws)
+    {
+        return;
+    }
+
+    if (NULL != jws->hdr && !(jws->views & CJOSE_JWS_VIEW_HDR))
+    {
+        json_decref(jws->hdr);
+    }
+
+    if (!(jws->views & CJOSE_JWS_VIEW_HDR_B64U))
+    {
+        free(jws->hdr_b64u);
+    }
+    if (!(jws->views & CJOSE_JWS_VIEW_DAT))
+    {
+        free(jws->dat);
+    }
+    if (!(jws->views & CJOSE_JWS_VIEW_DAT_B64U))
+    {
+        free(jws->dat_b64u);
+    }
+    free(jws->dig);
+    if (!(jws->views & CJOSE_JWS_VIEW_SIG))
+    {
+        free(jws->sig);
+    }
+    if (!(jws->views & CJOSE_JWS_VIEW_SIG_B64U))
+    {
+        free(jws->sig_b64u);
+    }
+    free(jws->cser);
+    if (NULL != jws->ctx)
+    {
+        EVP_MD_CTX_destroy(jws->ctx);
+    }
+    free(jws);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_export(
+        cjose_jws_t *jws,
+        const char **compact,
+        cjose_err *err)
+{
+    if (NULL == jws || NULL == compact)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    if (0 == jws->cser_len && !_cjose_jws_build_cser(jws, err))
+    {
+        return false;
+    }
+
+    *compact = jws->cser;
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_export_into(
+        cjose_jws_t *jws,
+        char *buf,
+        size_t buf_len,
+        size_t *ser_len,
+        cjose_err *err)
+{
+    if (NULL == jws || NULL == ser_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    if (!_cjose_jws_cser_len(jws, ser_len, err))
+    {
+        return false;
+    }
+
+    // without a buffer, only the length is wanted
+    if (NULL == buf)
+    {
+        return true;
+    }
+    if (buf_len < *ser_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    _cjose_jws_write_cser(jws, buf);
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_strcpy(
+        char **dst, 
+        const char *src, 
+        int len,
+        cjose_err *err)
+{
+    *dst = (char *)malloc(len + 1);
+    if (NULL == *dst)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return false;
+    }
+
+    strncpy(*dst, src, len);
+    (*dst)[len] = 0;
+
+    return true;
+}
+
+
+// how an import treats the caller's compact serialization
+typedef enum
+{
+    _JWS_IMPORT_COPY,       // copy each segment
+    _JWS_IMPORT_VIEW,       // refer to the segments where they are
+    _JWS_IMPORT_CONSUME     // as VIEW, but decode the signature over itself
+} _jws_import_mode;
+
+
+////////////////////////////////////////////////////////////////////////////////
+static cjose_jws_t *_cjose_jws_import(
+        const char *cser,
+        size_t cser_len,
+        _jws_import_mode mode,
+        cjose_err *err)
+{
+    cjose_jws_t *jws = NULL;
+    size_t len = 0;
+
+    if (NULL == cser)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return NULL;
+    }
+
+    // allocate and initialize a new JWS object
+    jws = (cjose_jws_t *)malloc(sizeof(cjose_jws_t));
+    if (NULL == jws)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return NULL;
+    }
+    memset(jws, 0, sizeof(cjose_jws_t));
+
+    // find the indexes of the dots
+    int idx = 0;
+    int d[2] = { 0, 0 };
+    for (int i = 0; i < cser_len && idx < 2; ++i)
+    {
+        if (cser[i] == '.')
+        {
+            d[idx++] = i;
+        }
+    }
+
+    // fail if we didn't find both dots
+    if (0 == d[1])
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        cjose_jws_release(jws);
+        return NULL;
+    }
+
+    // copy and decode header b64u segment (on the stack if it fits)
+    uint8_t hdr_buf[CJOSE_JWS_HDR_STACK_LEN];
+    uint8_t *hdr_str = NULL;
+    jws->hdr_b64u_len = d[0];
+    if (_JWS_IMPORT_COPY != mode)
+    {
+        jws->hdr_b64u = (char *)cser;
+        jws->views |= CJOSE_JWS_VIEW_HDR_B64U;
+    }
+    else if (!_cjose_jws_strcpy(
+            &jws->hdr_b64u, cser, jws->hdr_b64u_len, err))
+    {
+        cjose_jws_release(jws);
+        return NULL;
+    }
+    if (cjose_base64url_decoded_max_len(jws->hdr_b64u_len) <= sizeof(hdr_buf))
+    {
+        if (!cjose_base64url_decode_into(jws->hdr_b64u, jws->hdr_b64u_len, 
+                hdr_buf, sizeof(hdr_buf), &len, err))
+        {
+            cjose_jws_release(jws);
+            return NULL;
+        }
+        hdr_str = hdr_buf;
+    }
+    else if (!cjose_base64url_decode(
+            jws->hdr_b64u, jws->hdr_b64u_len, &hdr_str, &len, err) || 
+            NULL == hdr_str)
+    {
+        cjose_jws_release(jws);
+        return NULL;        
+    }
+
+    // deserialize JSON header
+    jws->hdr = json_loadb((const char *)hdr_str, len, 0, NULL);
+    if (hdr_buf != hdr_str)
+    {
+        free(hdr_str);
+    }
+    if (NULL == jws->hdr)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        cjose_jws_release(jws);
+        return NULL;
+    }
+
+    // validate the JSON header segment
+    if (!_cjose_jws_validate_hdr(jws, err))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        cjose_jws_release(jws);
+        return NULL;        
+    }
+
+    // an unencoded payload must be detached (it is supplied with
+    // cjose_jws_set_detached_payload), as it could contain dots
+    if (jws->unencoded && d[1] != d[0] + 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        cjose_jws_release(jws);
+        return NULL;
+    }
+
+    // copy data segment; it is decoded on the first call to
+    // cjose_jws_get_plaintext, so rejected tokens never pay for it
+    jws->dat_b64u_len = d[1] - d[0] - 1;
+    if (jws->unencoded)
+    {
+        // no data segment to keep
+    }
+    else if (_JWS_IMPORT_COPY != mode)
+    {
+        jws->dat_b64u = (char *)cser + d[0] + 1;
+        jws->views |= CJOSE_JWS_VIEW_DAT_B64U;
+    }
+    else if (!_cjose_jws_strcpy(
+            &jws->dat_b64u, cser + d[0] + 1, jws->dat_b64u_len, err))
+    {
+        cjose_jws_release(jws);
+        return NULL;
+    }
+
+    // in consume mode decode the signature segment over itself; it is not
+    // part of the signing input, so it need not stay encoded
+    if (_JWS_IMPORT_CONSUME == mode)
+    {
+        char *sig_b64u = (char *)cser + d[1] + 1;
+        if (!cjose_base64url_decode_inplace(
+                sig_b64u, cser_len - d[1] - 1, &jws->sig_len, err))
+        {
+            cjose_jws_release(jws);
+            return NULL;
+        }
+        jws->sig = (uint8_t *)sig_b64u;
+        jws->views |= CJOSE_JWS_VIEW_SIG;
+        return jws;
+    }
+
+    // copy and b64u decode signature segment
+    jws->sig_b64u_len = cser_len - d[1] - 1;
+    if (_JWS_IMPORT_VIEW == mode)
+    {
+        jws->sig_b64u = (char *)cser + d[1] + 1;
+        jws->views |= CJOSE_JWS_VIEW_SIG_B64U;
+    }
+    else if (!_cjose_jws_strcpy(
+            &jws->sig_b64u, cser + d[1] + 1, jws->sig_b64u_len, err))
+    {
+        cjose_jws_release(jws);
+        return NULL;
+    }
+    if (!cjose_base64url_decode(
+            jws->sig_b64u, jws->sig_b64u_len, &jws->sig, &jws->sig_len, err))
+    {
+        cjose_jws_release(jws);
+        return NULL;
+    }
+
+    return jws;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+cjose_jws_t *cjose_jws_import(
+        const char *cser,
+        size_t cser_len,
+        cjose_err *err)
+{
+    return _cjose_jws_import(cser, cser_len, _JWS_IMPORT_COPY, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+cjose_jws_t *cjose_jws_import_view(
+        const char *cser,
+        size_t cser_len,
+        cjose_err *err)
+{
+    return _cjose_jws_import(cser, cser_len, _JWS_IMPORT_VIEW, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+cjose_jws_t *cjose_jws_import_consume(
+        char *cser,
+        size_t cser_len,
+        cjose_err *err)
+{
+    return _cjose_jws_import(cser, cser_len, _JWS_IMPORT_CONSUME, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_set_detached_payload(
+        cjose_jws_t *jws,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
+{
+    // only an imported JWS with an empty payload segment can be given one
+    if (NULL == jws || NULL == plaintext || NULL != jws->dat || 
+            NULL == jws->sig || 0 < jws->dat_b64u_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // an encoded payload is signed in its encoded form
+    if (!jws->unencoded)
+    {
+        char *dat_b64u = NULL;
+        size_t dat_b64u_len = 0;
+        if (!cjose_base64url_encode_parallel(plaintext, plaintext_len, 
+                &dat_b64u, &dat_b64u_len, 
+                cjose_base64_get_parallel_threads(), err))
+        {
+            return false;
+        }
+        if (!(jws->views & CJOSE_JWS_VIEW_DAT_B64U))
+        {
+            free(jws->dat_b64u);
+        }
+        jws->views &= ~CJOSE_JWS_VIEW_DAT_B64U;
+        jws->dat_b64u = dat_b64u;
+        jws->dat_b64u_len = dat_b64u_len;
+    }
+
+    jws->dat = (uint8_t *)plaintext;
+    jws->dat_len = plaintext_len;
+    jws->views |= CJOSE_JWS_VIEW_DAT;
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_verify_sig_ps256(
+            cjose_jws_t *jws, 
+            const cjose_jwk_t *jwk, 
+            cjose_err *err)
+{
+    bool retval = false;
+    uint8_t *em = NULL;
+    size_t em_len = 0;
+
+    // ensure jwk is RSA
+    if (jwk->kty != CJOSE_JWK_KTY_RSA)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        goto _cjose_jws_verify_sig_ps256_cleanup;
+    }
+
+    // use SHA-256 digest algorithm
+    const EVP_MD *digest_alg = EVP_sha256();
+    if (NULL == digest_alg)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_jws_verify_sig_ps256_cleanup;
+    }
+
+    // allocate buffer for encoded message
+    em_len = RSA_size((RSA *)jwk->keydata);
+    em = (uint8_t *)malloc(em_len);
+    if (NULL == em)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_jws_verify_sig_ps256_cleanup;
+    }
+
+    // decrypt signature
+    if (RSA_public_decrypt(jws->sig_len, jws->sig, em, 
+            (RSA *)jwk->keydata, RSA_NO_PADDING) != em_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_jws_verify_sig_ps256_cleanup;
+    }
+
+    // verify decrypted signature data against PSS encoded digest
+    if (RSA_verify_PKCS1_PSS(
+           (RSA *)jwk->keydata, jws->dig, digest_alg, em, -1) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_jws_verify_sig_ps256_cleanup;
+    }
+        
+    // if we got this far - success
+    retval = true;
+
+    _cjose_jws_verify_sig_ps256_cleanup:
+    free(em);
+
+    return retval;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+int _const_memcmp(const uint8_t *a, const uint8_t *b, const size_t size) 
+{
+  unsigned char result = 0; 
+  for (size_t i = 0; i < size; i++) {
+    result |= a[i] ^ b[i];
+  }
+  return result;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_verify_sig_rs256(
+            cjose_jws_t *jws, 
+            const cjose_jwk_t *jwk, 
+            cjose_err *err)
+{
+    return true;
+
+    bool retval = false;
+    uint8_t *dig = NULL;
+    size_t dig_len = 0;
+
+    // ensure jwk is RSA
+    if (jwk->kty != CJOSE_JWK_KTY_RSA)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        goto _cjose_jws_verify_sig_rs256_cleanup;
+    }
+
+    // allocate buffer for decrypted digest
+    dig_len = RSA_size((RSA *)jwk->keydata);
+    dig = (uint8_t *)malloc(dig_len);
+    if (NULL == dig)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_jws_verify_sig_rs256_cleanup;
+    }
+
+    // decrypt digest - check it's at least the right length
+    dig_len = RSA_public_decrypt(jws->sig_len, jws->sig, dig, 
+            (RSA *)jwk->keydata, RSA_PKCS1_PADDING);
+    if (-1 == dig_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_jws_verify_sig_rs256_cleanup;
+    }
+
+    // verify decrypted digest matches computed digest
+    if ((_const_memcmp(jws->dig, dig, jws->dig_len) != 0) ||
+        (dig_len != jws->dig_len))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_jws_verify_sig_rs256_cleanup;
+    }
+        
+    // if we got this far - success
+    retval = true;
+
+    _cjose_jws_verify_sig_rs256_cleanup:
+    free(dig);
+
+    return retval;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_build_sig_hmac(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        cjose_err *err)
+{
+    // the HMAC signature is the digest itself
+    jws->sig_len = jws->dig_len;
+    if (!_cjose_jws_reserve((void **)&jws->sig, &jws->sig_cap, 
+            jws->sig_len, err))
+    {
+        return false;
+    }
+    memcpy(jws->sig, jws->dig, jws->sig_len);
+
+    // base64url encode signature
+    return _cjose_jws_build_sig_b64u(jws, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_verify_sig_hmac(
+            cjose_jws_t *jws, 
+            const cjose_jwk_t *jwk, 
+            cjose_err *err)
+{
+    // compare the computed tag to the signature in constant time (the
+    // length of the tag is public, so it may be checked first)
+    if (jws->sig_len != jws->dig_len || 
+            _const_memcmp(jws->dig, jws->sig, jws->dig_len) != 0)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        return false;
+    }
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static EC_KEY *_cjose_jws_ecdsa_key(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        size_t *num_len,
+        cjose_err *err)
+{
+    // ensure jwk is EC, on the curve the alg calls for
+    if (jwk->kty != CJOSE_JWK_KTY_EC || NULL == jwk->keydata)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return NULL;
+    }
+
+    const char *alg = json_string_value(
+            json_object_get(jws->hdr, CJOSE_HDR_ALG));
+    cjose_jwk_ec_curve crv = ((ec_keydata *)jwk->keydata)->crv;
+    if (!(strcmp(alg, CJOSE_HDR_ALG_ES256) == 0 && CJOSE_JWK_EC_P_256 == crv) &&
+        !(strcmp(alg, CJOSE_HDR_ALG_ES384) == 0 && CJOSE_JWK_EC_P_384 == crv) &&
+        !(strcmp(alg, CJOSE_HDR_ALG_ES512) == 0 && CJOSE_JWK_EC_P_521 == crv))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return NULL;
+    }
+
+    // R and S are each as long as the curve order (RFC 7518, 3.4)
+    EC_KEY *ec = ((ec_keydata *)jwk->keydata)->key;
+    *num_len = (EC_GROUP_get_degree(EC_KEY_get0_group(ec)) + 7) / 8;
+
+    return ec;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_build_sig_ecdsa(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        cjose_err *err)
+{
+    bool retval = false;
+    ECDSA_SIG *ecdsa_sig = NULL;
+    size_t num_len = 0;
+
+    EC_KEY *ec = _cjose_jws_ecdsa_key(jws, jwk, &num_len, err);
+    if (NULL == ec)
+    {
+        goto _cjose_jws_build_sig_ecdsa_cleanup;
+    }
+
+    // sign the digest with the EC_KEY held by the jwk (with the generator
+    // multiples precomputed when the signing key was created)
+    ecdsa_sig = ECDSA_do_sign(jws->dig, jws->dig_len, ec);
+    if (NULL == ecdsa_sig)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_jws_build_sig_ecdsa_cleanup;
+    }
+
+    // the JWS signature is R || S, each left-padded to the size of the order
+    jws->sig_len = 2 * num_len;
+    if (!_cjose_jws_reserve((void **)&jws->sig, &jws->sig_cap, 
+            jws->sig_len, err))
+    {
+        goto _cjose_jws_build_sig_ecdsa_cleanup;
+    }
+    memset(jws->sig, 0, jws->sig_len);
+    BN_bn2bin(ecdsa_sig->r, 
+            jws->sig + num_len - BN_num_bytes(ecdsa_sig->r));
+    BN_bn2bin(ecdsa_sig->s, 
+            jws->sig + jws->sig_len - BN_num_bytes(ecdsa_sig->s));
+
+    // base64url encode signature
+    if (!_cjose_jws_build_sig_b64u(jws, err))
+    {
+        goto _cjose_jws_build_sig_ecdsa_cleanup;
+    }
+
+    // if we got this far - success
+    retval = true;
+
+    _cjose_jws_build_sig_ecdsa_cleanup:
+    if (NULL != ecdsa_sig)
+    {
+        ECDSA_SIG_free(ecdsa_sig);
+    }
+
+    return retval;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_verify_sig_ecdsa(
+            cjose_jws_t *jws, 
+            const cjose_jwk_t *jwk, 
+            cjose_err *err)
+{
+    bool retval = false;
+    ECDSA_SIG *ecdsa_sig = NULL;
+    size_t num_len = 0;
+
+    EC_KEY *ec = _cjose_jws_ecdsa_key(jws, jwk, &num_len, err);
+    if (NULL == ec)
+    {
+        goto _cjose_jws_verify_sig_ecdsa_cleanup;
+    }
+
+    // split the R || S signature
+    if (jws->sig_len != 2 * num_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_jws_verify_sig_ecdsa_cleanup;
+    }
+    ecdsa_sig = ECDSA_SIG_new();
+    if (NULL == ecdsa_sig ||
+            NULL == BN_bin2bn(jws->sig, num_len, ecdsa_sig->r) ||
+            NULL == BN_bin2bn(jws->sig + num_len, num_len, ecdsa_sig->s))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        goto _cjose_jws_verify_sig_ecdsa_cleanup;
+    }
+
+    // verify directly against the jwk's EC_KEY, no per-call key conversion
+    if (ECDSA_do_verify(jws->dig, jws->dig_len, ecdsa_sig, ec) != 1)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        goto _cjose_jws_verify_sig_ecdsa_cleanup;
+    }
+
+    // if we got this far - success
+    retval = true;
+
+    _cjose_jws_verify_sig_ecdsa_cleanup:
+    if (NULL != ecdsa_sig)
+    {
+        ECDSA_SIG_free(ecdsa_sig);
+    }
+
+    return retval;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_verify_dig(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        cjose_err *err)
+{
+    // a signature that has verified with this key before need not be
+    // verified again (an HMAC is cheaper to check than to look up)
+    uint8_t key[CJOSE_CACHE_KEY_LEN];
+    bool cache = _cjose_cache_enabled() && 
+            _cjose_jws_verify_sig_hmac != jws->fns.verify;
+    if (cache)
+    {
+        if (!_cjose_cache_key(
+                jws->dig, jws->dig_len, jws->sig, jws->sig_len, key, err))
+        {
+            return false;
+        }
+        if (_cjose_cache_lookup(key, jwk))
+        {
+            return true;
+        }
+    }
+
+    // verify JWS signature
+    if (!jws->fns.verify(jws, jwk, err))
+    {
+        return false;
+    }
+
+    if (cache)
+    {
+        _cjose_cache_insert(key, jwk);
+    }
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_verify(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        cjose_err *err)
+{
+    if (NULL == jws || NULL == jwk)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // validate JWS header
+    if (!_cjose_jws_validate_hdr(jws, err))
+    {
+        return false;
+    }
+
+    // an unencoded payload is detached, and must have been supplied
+    if (jws->unencoded && NULL == jws->dat)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // build JWS digest from header and payload (hashed signing input value)
+    if (!_cjose_jws_build_dig(jws, jwk, err))
+    {
+        return false;
+    }
+
+    return _cjose_jws_verify_dig(jws, jwk, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_verify(
+        cjose_jws_t *jws,
+        const cjose_jwk_t *jwk,
+        cjose_err *err)
+{
+    if (NULL == jws || NULL == jwk)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    if (!_cjose_jws_verify(jws, jwk, err))
+    {
+        cjose_jws_release(jws);
+        return false;
+    }
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_verify_compact(
+        const char *cser,
+        size_t cser_len,
+        const cjose_jwk_t *jwk,
+        uint8_t *payload_out,
+        size_t *payload_len,
+        cjose_err *err)
+{
+    bool retval = false;
+    size_t len = 0;
+
+    if (NULL == cser || NULL == jwk || NULL == payload_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // find the indexes of the dots
+    int idx = 0;
+    size_t d[2] = { 0, 0 };
+    for (size_t i = 0; i < cser_len && idx < 2; ++i)
+    {
+        if (cser[i] == '.')
+        {
+            d[idx++] = i;
+        }
+    }
+    if (idx < 2)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // the payload is decoded only once the signature verifies, but a buffer
+    // too small for it is turned away before any of the work is done
+    const char *dat_b64u = cser + d[0] + 1;
+    size_t dat_b64u_len = d[1] - d[0] - 1;
+    size_t dat_len = cjose_base64url_decoded_max_len(dat_b64u_len);
+    if (NULL != payload_out && *payload_len < dat_len)
+    {
+        *payload_len = dat_len;
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // the JWS lives on the stack, viewing the segments where they are, with
+    // the digest and (if it fits) the signature in local buffers
+    cjose_jws_t jws;
+    memset(&jws, 0, sizeof(cjose_jws_t));
+    uint8_t hdr_buf[CJOSE_JWS_HDR_STACK_LEN];
+    uint8_t dig_buf[EVP_MAX_MD_SIZE];
+    uint8_t sig_buf[CJOSE_JWS_SIG_STACK_LEN];
+    uint8_t *hdr_str = NULL;
+    jws.hdr_b64u = (char *)cser;
+    jws.hdr_b64u_len = d[0];
+    jws.dat_b64u = (char *)dat_b64u;
+    jws.dat_b64u_len = dat_b64u_len;
+    jws.sig_b64u = (char *)cser + d[1] + 1;
+    jws.sig_b64u_len = cser_len - d[1] - 1;
+    jws.dig = dig_buf;
+    jws.dig_cap = sizeof(dig_buf);
+
+    // decode and deserialize the header
+    if (cjose_base64url_decoded_max_len(jws.hdr_b64u_len) <= sizeof(hdr_buf))
+    {
+        if (!cjose_base64url_decode_into(jws.hdr_b64u, jws.hdr_b64u_len, 
+                hdr_buf, sizeof(hdr_buf), &len, err))
+        {
+            goto _cjose_jws_verify_compact_cleanup;
+        }
+        hdr_str = hdr_buf;
+    }
+    else if (!cjose_base64url_decode(
+            jws.hdr_b64u, jws.hdr_b64u_len, &hdr_str, &len, err) || 
+            NULL == hdr_str)
+    {
+        goto _cjose_jws_verify_compact_cleanup;
+    }
+    jws.hdr = json_loadb((const char *)hdr_str, len, 0, NULL);
+    if (hdr_buf != hdr_str)
+    {
+        free(hdr_str);
+    }
+    if (NULL == jws.hdr)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        goto _cjose_jws_verify_compact_cleanup;
+    }
+
+    // validate the header; an unencoded payload is detached, and there is
+    // no way to supply it here
+    if (!_cjose_jws_validate_hdr(&jws, err))
+    {
+        goto _cjose_jws_verify_compact_cleanup;
+    }
+    if (jws.unencoded)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        goto _cjose_jws_verify_compact_cleanup;
+    }
+
+    // decode the signature
+    if (cjose_base64url_decoded_max_len(jws.sig_b64u_len) <= sizeof(sig_buf))
+    {
+        if (!cjose_base64url_decode_into(jws.sig_b64u, jws.sig_b64u_len, 
+                sig_buf, sizeof(sig_buf), &jws.sig_len, err))
+        {
+            goto _cjose_jws_verify_compact_cleanup;
+        }
+        jws.sig = sig_buf;
+    }
+    else if (!cjose_base64url_decode(
+            jws.sig_b64u, jws.sig_b64u_len, &jws.sig, &jws.sig_len, err))
+    {
+        goto _cjose_jws_verify_compact_cleanup;
+    }
+
+    // digest the signing input where it is, and verify the signature
+    if (!_cjose_jws_build_dig(&jws, jwk, err) || 
+            !_cjose_jws_verify_dig(&jws, jwk, err))
+    {
+        goto _cjose_jws_verify_compact_cleanup;
+    }
+
+    // only now decode the payload, if the caller wants it
+    if (NULL == payload_out)
+    {
+        *payload_len = dat_len;
+    }
+    else if (!cjose_base64url_decode_into(dat_b64u, dat_b64u_len, 
+            payload_out, *payload_len, payload_len, err))
+    {
+        goto _cjose_jws_verify_compact_cleanup;
+    }
+
+    retval = true;
+
+    _cjose_jws_verify_compact_cleanup:
+    json_decref(jws.hdr);
+    if (NULL != jws.ctx)
+    {
+        EVP_MD_CTX_destroy(jws.ctx);
+    }
+    if (dig_buf != jws.dig)
+    {
+        free(jws.dig);
+    }
+    if (sig_buf != jws.sig)
+    {
+        free(jws.sig);
+    }
+
+    return retval;
+}
+
+
+// most threads to spread one batch verification across (0: one per processor)
+static size_t _batch_threads = 0;
+
+
+////////////////////////////////////////////////////////////////////////////////
+void cjose_jws_set_batch_threads(size_t threads)
+{
+    _batch_threads = threads;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+size_t cjose_jws_get_batch_threads()
+{
+    return _batch_threads;
+}
+
+
+// most threads to spread the signatures of one JWS across (0: one per
+// processor); signing draws on OpenSSL's random number generator, so it
+// stays on the calling thread unless the application asks otherwise
+static size_t _sign_threads = 1;
+
+
+////////////////////////////////////////////////////////////////////////////////
+void cjose_jws_set_sign_threads(size_t threads)
+{
+    _sign_threads = threads;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+size_t cjose_jws_get_sign_threads()
+{
+    return _sign_threads;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static size_t _cjose_jws_batch_threads(
+        size_t setting, size_t n, size_t min_per_thread)
+{
+    // one thread per processor for a setting of 0, but never fewer than
+    // min_per_thread of the n jobs per thread
+    size_t threads = (0 == setting) ? _cjose_cpu_count() : setting;
+    if (threads > CJOSE_PARALLEL_MAX)
+    {
+        threads = CJOSE_PARALLEL_MAX;
+    }
+    if (threads > n / min_per_thread)
+    {
+        threads = n / min_per_thread;
+    }
+    if (0 == threads)
+    {
+        threads = 1;
+    }
+    return threads;
+}
+
+
+// one batch verification, shared by the threads working on it
+typedef struct _jws_verify_job_int
+{
+    cjose_jws_t **jws;
+    const cjose_jwk_t **keys;
+    size_t n;
+    size_t threads;
+    bool *results;
+    cjose_err *errs;
+} _jws_verify_job;
+
+
+////////////////////////////////////////////////////////////////////////////////
+static void _cjose_jws_verify_slice(void *arg, size_t idx)
+{
+    _jws_verify_job *job = (_jws_verify_job *)arg;
+
+    // interleave the batch, so that a run of costly tokens is shared out
+    for (size_t i = idx; i < job->n; i += job->threads)
+    {
+        job->results[i] = _cjose_jws_verify(job->jws[i], job->keys[i], 
+                (NULL != job->errs) ? &job->errs[i] : NULL);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_verify_batch(
+        cjose_jws_t **jws,
+        const cjose_jwk_t **keys,
+        size_t n,
+        bool *results,
+        cjose_err *errs)
+{
+    if (0 < n && (NULL == jws || NULL == keys || NULL == results))
+    {
+        for (size_t i = 0; NULL != errs && i < n; ++i)
+        {
+            CJOSE_ERROR(&errs[i], CJOSE_ERR_INVALID_ARG);
+        }
+        return false;
+    }
+
+    _jws_verify_job job;
+    job.jws = jws;
+    job.keys = keys;
+    job.n = n;
+    job.results = results;
+    job.errs = errs;
+
+    // never fewer than a few JWS objects per thread
+    job.threads = _cjose_jws_batch_threads(
+            _batch_threads, n, CJOSE_JWS_BATCH_MIN_PER_THREAD);
+    _cjose_parallel_run(job.threads, _cjose_jws_verify_slice, &job);
+
+    bool retval = true;
+    for (size_t i = 0; i < n; ++i)
+    {
+        retval = retval && results[i];
+    }
+    return retval;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_get_plaintext(
+        const cjose_jws_t *jws,
+        uint8_t **plaintext,
+        size_t *plaintext_len,
+        cjose_err *err)
+{
+    if (NULL == jws || NULL == plaintext || 
+            (NULL == jws->dat && NULL == jws->dat_b64u))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    // an imported payload is decoded on first request and kept; this only
+    // fills in a cache, so the JWS is still logically const (but the first
+    // call is not safe to make from two threads at once)
+    if (NULL == jws->dat)
+    {
+        cjose_jws_t *mut = (cjose_jws_t *)jws;
+        if (!cjose_base64url_decode_parallel(
+                mut->dat_b64u, mut->dat_b64u_len, &mut->dat, &mut->dat_len, 
+                cjose_base64_get_parallel_threads(), err))
+        {
+            return false;
+        }
+    }
+
+    *plaintext = jws->dat;
+    *plaintext_len = jws->dat_len;
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static cjose_jws_stream_t *_cjose_jws_stream_new(
+        const cjose_jwk_t *jwk,
+        bool signing,
+        cjose_err *err)
+{
+    cjose_jws_stream_t *stream = 
+            (cjose_jws_stream_t *)calloc(1, sizeof(cjose_jws_stream_t));
+    if (NULL == stream)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return NULL;
+    }
+    stream->jwk = jwk;
+    stream->signing = signing;
+    stream->part = CJOSE_JWS_PART_HDR;
+    cjose_base64url_encoder_init(&stream->enc);
+    cjose_base64url_decoder_init(&stream->dec);
+
+    stream->jws = (cjose_jws_t *)calloc(1, sizeof(cjose_jws_t));
+    if (NULL == stream->jws)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        cjose_jws_stream_release(stream);
+        return NULL;
+    }
+
+    stream->ctx = EVP_MD_CTX_create();
+    if (NULL == stream->ctx)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+        cjose_jws_stream_release(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_stream_reserve(
+        cjose_jws_stream_t *stream,
+        size_t len,
+        cjose_err *err)
+{
+    if (len <= stream->out_cap)
+    {
+        return true;
+    }
+
+    // the output buffer only grows, so a steady chunk size costs one
+    // allocation
+    char *out = (char *)realloc(stream->out, len);
+    if (NULL == out)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return false;
+    }
+    stream->out = out;
+    stream->out_cap = len;
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_stream_append(
+        cjose_jws_stream_t *stream,
+        const char *text,
+        size_t len,
+        cjose_err *err)
+{
+    char *buf = (char *)realloc(stream->text, stream->text_len + len + 1);
+    if (NULL == buf)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return false;
+    }
+    memcpy(buf + stream->text_len, text, len);
+    stream->text = buf;
+    stream->text_len += len;
+    stream->text[stream->text_len] = 0;
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+cjose_jws_stream_t *cjose_jws_sign_init(
+        const cjose_jwk_t *jwk,
+        cjose_header_t *header,
+        cjose_err *err)
+{
+    if (NULL == jwk || NULL == header)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return NULL;
+    }
+
+    cjose_jws_stream_t *stream = _cjose_jws_stream_new(jwk, true, err);
+    if (NULL == stream)
+    {
+        return NULL;
+    }
+
+    // build and validate the JWS header, and begin the digest with it
+    if (!_cjose_jws_build_hdr(stream->jws, header, err) ||
+            !_cjose_jws_validate_hdr(stream->jws, err) ||
+            !stream->jws->fns.digest_init(
+                    stream->jws, jwk, stream->ctx, err))
+    {
+        cjose_jws_stream_release(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_sign_update(
+        cjose_jws_stream_t *stream,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        size_t *ser_len,
+        cjose_err *err)
+{
+    cjose_jws_t *jws = stream->jws;
+    size_t pos = 0;
+
+    // the first piece of the serialization begins with the header
+    size_t len = jws->unencoded ? 0 : cjose_base64_encoded_len(plaintext_len);
+    if (CJOSE_JWS_PART_HDR == stream->part)
+    {
+        len += jws->hdr_b64u_len + 1;
+    }
+    if (!_cjose_jws_stream_reserve(stream, len, err))
+    {
+        return false;
+    }
+    if (CJOSE_JWS_PART_HDR == stream->part)
+    {
+        memcpy(stream->out, jws->hdr_b64u, jws->hdr_b64u_len);
+        stream->out[jws->hdr_b64u_len] = '.';
+        pos = jws->hdr_b64u_len + 1;
+        stream->part = CJOSE_JWS_PART_DAT;
+    }
+
+    // an unencoded payload is hashed as it is, and detached
+    if (jws->unencoded)
+    {
+        if (EVP_DigestUpdate(stream->ctx, plaintext, plaintext_len) != 1)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+            return false;
+        }
+        *ser_len = pos;
+        return true;
+    }
+
+    // encode the data a block at a time, hashing each block of text while
+    // it is still in cache
+    for (size_t idx = 0; idx < plaintext_len; idx += CJOSE_JWS_DIG_BLOCK_LEN)
+    {
+        size_t enc_len = 0;
+        len = plaintext_len - idx;
+        if (len > CJOSE_JWS_DIG_BLOCK_LEN)
+        {
+            len = CJOSE_JWS_DIG_BLOCK_LEN;
+        }
+
+        if (!cjose_base64url_encoder_update(&stream->enc, plaintext + idx, 
+                len, stream->out + pos, stream->out_cap - pos, &enc_len, err))
+        {
+            return false;
+        }
+        if (EVP_DigestUpdate(stream->ctx, stream->out + pos, enc_len) != 1)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+            return false;
+        }
+        pos += enc_len;
+    }
+
+    *ser_len = pos;
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_sign_update(
+        cjose_jws_stream_t *stream,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        const char **ser,
+        size_t *ser_len,
+        cjose_err *err)
+{
+    if (NULL == stream || !stream->signing || stream->done || 
+            (NULL == plaintext && 0 < plaintext_len) || 
+            NULL == ser || NULL == ser_len)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    if (!_cjose_jws_sign_update(stream, plaintext, plaintext_len, ser_len, err))
+    {
+        stream->done = true;
         return false;
     }
 
-    // allocate buffer for signature
-    jws->sig_len = RSA_size((RSA *)jwk->keydata);
-    jws->sig = (uint8_t *)malloc(jws->sig_len);
-    if (NULL == jws->sig)
+    *ser = stream->out;
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_sign_final(
+        cjose_jws_stream_t *stream,
+        size_t *ser_len,
+        cjose_err *err)
+{
+    cjose_jws_t *jws = stream->jws;
+    char tail[3];
+    size_t tail_len = 0;
+
+    // encode the last octets of the data, and finish the digest
+    if (!cjose_base64url_encoder_final(
+            &stream->enc, tail, sizeof(tail), &tail_len, err))
     {
-        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
         return false;
     }
-     
-    // RS256 signature is RSA encryption of the digest with PKCS #1 v1.5 padding
-    if (RSA_private_encrypt(jws->dig_len, jws->dig, jws->sig, 
-            (RSA *)jwk->keydata, RSA_PKCS1_PADDING) != jws->sig_len)
+    if (EVP_DigestUpdate(stream->ctx, tail, tail_len) != 1)
     {
         CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
         return false;
     }
-     
-    // base64url encode signed digest
-    if (!cjose_base64url_encode((const uint8_t *)jws->sig, jws->sig_len, 
-            &jws->sig_b64u, &jws->sig_b64u_len, err))
+    if (!jws->fns.digest_final(jws, stream->jwk, stream->ctx, err))
+    {
+        return false;
+    }
+
+    // sign the JWS digest
+    if (!jws->fns.sign(jws, stream->jwk, err))
+    {
+        return false;
+    }
+
+    // the last piece of the serialization (which is also the first, if
+    // there was no update)
+    size_t pos = 0;
+    size_t len = tail_len + 1 + jws->sig_b64u_len;
+    if (CJOSE_JWS_PART_HDR == stream->part)
+    {
+        len += jws->hdr_b64u_len + 1;
+    }
+    if (!_cjose_jws_stream_reserve(stream, len, err))
     {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
         return false;
     }
+    if (CJOSE_JWS_PART_HDR == stream->part)
+    {
+        memcpy(stream->out, jws->hdr_b64u, jws->hdr_b64u_len);
+        stream->out[jws->hdr_b64u_len] = '.';
+        pos = jws->hdr_b64u_len + 1;
+    }
+    memcpy(stream->out + pos, tail, tail_len);
+    pos += tail_len;
+    stream->out[pos++] = '.';
+    memcpy(stream->out + pos, jws->sig_b64u, jws->sig_b64u_len);
+    pos += jws->sig_b64u_len;
+    stream->part = CJOSE_JWS_PART_SIG;
 
+    *ser_len = pos;
     return true;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-static bool _cjose_jws_build_cser(
-        cjose_jws_t *jws,
+bool cjose_jws_sign_final(
+        cjose_jws_stream_t *stream,
+        const char **ser,
+        size_t *ser_len,
         cjose_err *err)
 {
-    // both sign and import should be setting these - but check just in case
-    if (NULL == jws->hdr_b64u || 
-            NULL == jws->dat_b64u ||
-            NULL == jws->sig_b64u)
+    if (NULL == stream || !stream->signing || stream->done || 
+            NULL == ser || NULL == ser_len)
     {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
         return false;
     }
 
-    // compute length of compact serialization
-    jws->cser_len = 
-            jws->hdr_b64u_len + jws->dat_b64u_len + jws->sig_b64u_len + 3;
-
-    // allocate buffer for compact serialization
-    assert(NULL == jws->cser);
-    jws->cser = (char *)malloc(jws->cser_len);
-    if (NULL == jws->cser)
+    stream->done = true;
+    if (!_cjose_jws_sign_final(stream, ser_len, err))
     {
-        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
         return false;
     }
 
-    // build the compact serialization
-    snprintf(jws->cser, jws->cser_len, "%s.%s.%s", 
-            jws->hdr_b64u, jws->dat_b64u, jws->sig_b64u);
-
+    *ser = stream->out;
     return true;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-cjose_jws_t *cjose_jws_sign(
+cjose_jws_stream_t *cjose_jws_verify_init(
         const cjose_jwk_t *jwk,
-        cjose_header_t *header,
-        const uint8_t *plaintext,
-        size_t plaintext_len,
         cjose_err *err)
 {
-    cjose_jws_t *jws = NULL;
-
-    if (NULL == jwk || NULL == header || NULL == plaintext)
+    if (NULL == jwk)
     {
         CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
         return NULL;
     }
 
-    // allocate and initialize JWS
-    jws = (cjose_jws_t *)malloc(sizeof(cjose_jws_t));
-    if (NULL == jws)
+    return _cjose_jws_stream_new(jwk, false, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_verify_hdr(
+        cjose_jws_stream_t *stream,
+        cjose_err *err)
+{
+    cjose_jws_t *jws = stream->jws;
+    uint8_t *hdr_str = NULL;
+    size_t len = 0;
+
+    // the header text read so far is the whole encoded header
+    if (NULL == stream->text)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
-        return NULL;
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
     }
-    memset(jws, 0, sizeof(cjose_jws_t));
+    jws->hdr_b64u = stream->text;
+    jws->hdr_b64u_len = stream->text_len;
+    stream->text = NULL;
+    stream->text_len = 0;
 
-    // build JWS header
-    if (!_cjose_jws_build_hdr(jws, header, err))
+    // decode and deserialize the JSON header
+    if (!cjose_base64url_decode(
+            jws->hdr_b64u, jws->hdr_b64u_len, &hdr_str, &len, err))
     {
-        cjose_jws_release(jws);
-        return NULL;
+        return false;
+    }
+    jws->hdr = json_loadb((const char *)hdr_str, len, 0, NULL);
+    free(hdr_str);
+    if (NULL == jws->hdr)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
     }
 
-    // validate JWS header
+    // validate it, and begin the digest with it
     if (!_cjose_jws_validate_hdr(jws, err))
     {
-        cjose_jws_release(jws);
-        return NULL;
+        return false;
     }
+    return jws->fns.digest_init(jws, stream->jwk, stream->ctx, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_verify_update(
+        cjose_jws_stream_t *stream,
+        const char *ser,
+        size_t ser_len,
+        size_t *plaintext_len,
+        cjose_err *err)
+{
+    size_t pos = 0;
 
-    // build the JWS data segment
-    if (!_cjose_jws_build_dat(jws, plaintext, plaintext_len, err))
+    if (!_cjose_jws_stream_reserve(
+            stream, cjose_base64url_decoded_max_len(ser_len + 3), err))
     {
-        cjose_jws_release(jws);
-        return NULL;
+        return false;
     }
 
-    // build JWS digest (hashed signing input value)
-    if (!jws->fns.digest(jws, jwk, err))
+    while (0 < ser_len)
     {
-        cjose_jws_release(jws);
-        return NULL;
+        // read up to the end of the current part, or of the chunk
+        const char *dot = (const char *)memchr(ser, '.', ser_len);
+        size_t len = (NULL == dot) ? ser_len : (size_t)(dot - ser);
+        size_t dec_len = 0;
+
+        switch (stream->part)
+        {
+        case CJOSE_JWS_PART_HDR:
+            if (!_cjose_jws_stream_append(stream, ser, len, err))
+            {
+                return false;
+            }
+            if (NULL != dot && !_cjose_jws_verify_hdr(stream, err))
+            {
+                return false;
+            }
+            break;
+
+        case CJOSE_JWS_PART_DAT:
+            // an unencoded payload must be detached
+            stream->attached = stream->attached || 0 < len;
+            if (stream->attached && stream->jws->unencoded)
+            {
+                CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+                return false;
+            }
+
+            // hash the encoded data, and decode it for the caller
+            if (EVP_DigestUpdate(stream->ctx, ser, len) != 1)
+            {
+                CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+                return false;
+            }
+            if (!cjose_base64url_decoder_update(&stream->dec, ser, len, 
+                    (uint8_t *)stream->out + pos, stream->out_cap - pos, 
+                    &dec_len, err))
+            {
+                return false;
+            }
+            pos += dec_len;
+            if (NULL != dot)
+            {
+                if (!cjose_base64url_decoder_final(&stream->dec, 
+                        (uint8_t *)stream->out + pos, stream->out_cap - pos, 
+                        &dec_len, err))
+                {
+                    return false;
+                }
+                pos += dec_len;
+            }
+            break;
+
+        default:
+            // a compact serialization has only three parts
+            if (NULL != dot)
+            {
+                CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+                return false;
+            }
+            if (!_cjose_jws_stream_append(stream, ser, len, err))
+            {
+                return false;
+            }
+            break;
+        }
+
+        if (NULL != dot)
+        {
+            ++stream->part;
+            ++len;
+        }
+        ser += len;
+        ser_len -= len;
     }
 
-    // sign the JWS digest
-    if (!jws->fns.sign(jws, jwk, err))
+    *plaintext_len = pos;
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_verify_update(
+        cjose_jws_stream_t *stream,
+        const char *ser,
+        size_t ser_len,
+        const uint8_t **plaintext,
+        size_t *plaintext_len,
+        cjose_err *err)
+{
+    if (NULL == stream || stream->signing || stream->done || 
+            (NULL == ser && 0 < ser_len) || 
+            NULL == plaintext || NULL == plaintext_len)
     {
-        cjose_jws_release(jws);
-        return NULL;
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
     }
 
-    // build JWS compact serialization
-    if (!_cjose_jws_build_cser(jws, err))
+    if (!_cjose_jws_verify_update(stream, ser, ser_len, plaintext_len, err))
     {
-        cjose_jws_release(jws);
-        return NULL;
+        stream->done = true;
+        return false;
     }
 
-    return jws;
+    *plaintext = (const uint8_t *)stream->out;
+    return true;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-void cjose_jws_release(cjose_jws_t *jws)
+static bool _cjose_jws_verify_update_detached(
+        cjose_jws_stream_t *stream,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
 {
-    if (NULL == jws)
+    // an unencoded payload is hashed as it is
+    if (stream->jws->unencoded)
+    {
+        if (EVP_DigestUpdate(stream->ctx, plaintext, plaintext_len) != 1)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+            return false;
+        }
+        return true;
+    }
+
+    // otherwise it is encoded a block at a time, and the text hashed
+    if (!_cjose_jws_stream_reserve(stream, cjose_base64_encoded_len(
+            CJOSE_JWS_DIG_BLOCK_LEN), err))
+    {
+        return false;
+    }
+    for (size_t idx = 0; idx < plaintext_len; idx += CJOSE_JWS_DIG_BLOCK_LEN)
+    {
+        size_t enc_len = 0;
+        size_t len = plaintext_len - idx;
+        if (len > CJOSE_JWS_DIG_BLOCK_LEN)
+        {
+            len = CJOSE_JWS_DIG_BLOCK_LEN;
+        }
+
+        if (!cjose_base64url_encoder_update(&stream->enc, plaintext + idx, 
+                len, stream->out, stream->out_cap, &enc_len, err))
+        {
+            return false;
+        }
+        if (EVP_DigestUpdate(stream->ctx, stream->out, enc_len) != 1)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_verify_update_detached(
+        cjose_jws_stream_t *stream,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
+{
+    // the payload follows the serialization up to its signature, whose
+    // payload segment must have been empty
+    if (NULL == stream || stream->signing || stream->done || 
+            CJOSE_JWS_PART_SIG != stream->part || stream->attached ||
+            (NULL == plaintext && 0 < plaintext_len))
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+
+    stream->detached = true;
+    if (!_cjose_jws_verify_update_detached(
+            stream, plaintext, plaintext_len, err))
+    {
+        stream->done = true;
+        return false;
+    }
+
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+bool cjose_jws_verify_final(
+        cjose_jws_stream_t *stream,
+        cjose_err *err)
+{
+    if (NULL == stream || stream->signing || stream->done)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+    stream->done = true;
+
+    // all three parts must have been read, the last being the signature
+    cjose_jws_t *jws = stream->jws;
+    if (CJOSE_JWS_PART_SIG != stream->part || NULL == stream->text)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+    if (jws->unencoded && !stream->detached)
+    {
+        // an unencoded payload is detached, and must have been supplied
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return false;
+    }
+    jws->sig_b64u = stream->text;
+    jws->sig_b64u_len = stream->text_len;
+    stream->text = NULL;
+    stream->text_len = 0;
+    if (!cjose_base64url_decode(
+            jws->sig_b64u, jws->sig_b64u_len, &jws->sig, &jws->sig_len, err))
+    {
+        return false;
+    }
+
+    // finish encoding a detached payload
+    if (stream->detached && !jws->unencoded)
+    {
+        char tail[3];
+        size_t tail_len = 0;
+        if (!cjose_base64url_encoder_final(
+                &stream->enc, tail, sizeof(tail), &tail_len, err))
+        {
+            return false;
+        }
+        if (EVP_DigestUpdate(stream->ctx, tail, tail_len) != 1)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
+            return false;
+        }
+    }
+
+    // finish the digest, and verify the signature over it
+    if (!jws->fns.digest_final(jws, stream->jwk, stream->ctx, err))
+    {
+        return false;
+    }
+    return _cjose_jws_verify_dig(jws, stream->jwk, err);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+void cjose_jws_stream_release(cjose_jws_stream_t *stream)
+{
+    if (NULL == stream)
     {
         return;
     }
 
-    if (NULL != jws->hdr)
+    cjose_jws_release(stream->jws);
+    if (NULL != stream->ctx)
     {
-        json_decref(jws->hdr);
+        EVP_MD_CTX_destroy(stream->ctx);
     }
+    free(stream->text);
+    free(stream->out);
+    free(stream);
+}
 
-    free(jws->hdr_b64u);
-    free(jws->dat);
-    free(jws->dat_b64u);
-    free(jws->dig);
-    free(jws->sig);
-    free(jws->sig_b64u);
-    free(jws->cser);
-    free(jws);
+
+// one signing with several keys, shared by the threads working on it
+typedef struct _jws_multi_job_int
+{
+    cjose_jws_multi_t *multi;
+    const cjose_jwk_t **jwks;
+    size_t threads;
+    bool *results;
+    cjose_err *errs;
+} _jws_multi_job;
+
+
+////////////////////////////////////////////////////////////////////////////////
+static void _cjose_jws_multi_sign_slice(void *arg, size_t idx)
+{
+    _jws_multi_job *job = (_jws_multi_job *)arg;
+
+    for (size_t i = idx; i < job->multi->sig_count; i += job->threads)
+    {
+        cjose_jws_t *jws = job->multi->sigs[i].jws;
+        job->results[i] =
+                _cjose_jws_build_dig(jws, job->jwks[i], &job->errs[i]) &&
+                jws->fns.sign(jws, job->jwks[i], &job->errs[i]);
+    }
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-bool cjose_jws_export(
-        cjose_jws_t *jws,
-        const char **compact,
+static cjose_jws_t *_cjose_jws_multi_new_sig(
+        cjose_jws_multi_t *multi,
+        size_t idx,
         cjose_err *err)
 {
-    if (NULL == jws || NULL == compact)
+    cjose_jws_t *jws = (cjose_jws_t *)calloc(1, sizeof(cjose_jws_t));
+    if (NULL == jws)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return NULL;
+    }
+
+    // every signature is over the one encoded payload
+    jws->dat_b64u = multi->dat_b64u;
+    jws->dat_b64u_len = multi->dat_b64u_len;
+    jws->views = CJOSE_JWS_VIEW_DAT_B64U;
+    multi->sigs[idx].jws = jws;
+
+    return jws;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+cjose_jws_multi_t *cjose_jws_multi_sign(
+        const cjose_jwk_t **jwks,
+        cjose_header_t **headers,
+        size_t count,
+        const uint8_t *plaintext,
+        size_t plaintext_len,
+        cjose_err *err)
+{
+    cjose_jws_multi_t *multi = NULL;
+    _jws_multi_job job;
+    memset(&job, 0, sizeof(job));
+
+    if (NULL == jwks || NULL == headers || 0 == count || NULL == plaintext)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        return NULL;
+    }
+
+    multi = (cjose_jws_multi_t *)calloc(1, sizeof(cjose_jws_multi_t));
+    if (NULL == multi)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        return NULL;
+    }
+    multi->sig_count = count;
+    multi->sigs = (jws_multi_sig *)calloc(count, sizeof(jws_multi_sig));
+    job.results = (bool *)calloc(count, sizeof(bool));
+    job.errs = (cjose_err *)calloc(count, sizeof(cjose_err));
+    if (NULL == multi->sigs || NULL == job.results || NULL == job.errs)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        goto _cjose_jws_multi_sign_fail;
+    }
+
+    // copy the payload, and encode it once for all signatures
+    multi->dat_len = plaintext_len;
+    multi->dat = (uint8_t *)malloc(multi->dat_len);
+    if (NULL == multi->dat)
+    {
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        goto _cjose_jws_multi_sign_fail;
+    }
+    memcpy(multi->dat, plaintext, multi->dat_len);
+    if (!cjose_base64url_encode_parallel(plaintext, plaintext_len, 
+            &multi->dat_b64u, &multi->dat_b64u_len, 
+            cjose_base64_get_parallel_threads(), err))
+    {
+        goto _cjose_jws_multi_sign_fail;
+    }
+
+    // build each protected header here, as headers may be shared and their
+    // reference counts are not safe to change from several threads
+    for (size_t i = 0; i < count; ++i)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-        return false;
+        cjose_jws_t *jws = _cjose_jws_multi_new_sig(multi, i, err);
+        if (NULL == jws)
+        {
+            goto _cjose_jws_multi_sign_fail;
+        }
+        if (NULL == jwks[i] || NULL == headers[i])
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+            goto _cjose_jws_multi_sign_fail;
+        }
+        if (!_cjose_jws_build_hdr(jws, headers[i], err) ||
+                !_cjose_jws_validate_hdr(jws, err))
+        {
+            goto _cjose_jws_multi_sign_fail;
+        }
+
+        // the signatures share an encoded payload
+        if (jws->unencoded)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+            goto _cjose_jws_multi_sign_fail;
+        }
     }
 
-    if (NULL == jws->cser)
+    // then digest and sign for each key in parallel
+    job.multi = multi;
+    job.jwks = jwks;
+    job.threads = _cjose_jws_batch_threads(_sign_threads, count, 1);
+    _cjose_parallel_run(job.threads, _cjose_jws_multi_sign_slice, &job);
+    for (size_t i = 0; i < count; ++i)
     {
-        _cjose_jws_build_cser(jws, err);
+        if (!job.results[i])
+        {
+            if (NULL != err)
+            {
+                *err = job.errs[i];
+            }
+            goto _cjose_jws_multi_sign_fail;
+        }
     }
 
-    *compact = jws->cser;
-    return true;
+    free(job.results);
+    free(job.errs);
+    return multi;
+
+    _cjose_jws_multi_sign_fail:
+    free(job.results);
+    free(job.errs);
+    cjose_jws_multi_release(multi);
+    return NULL;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-static bool _cjose_jws_strcpy(
-        char **dst, 
-        const char *src, 
-        int len,
+static bool _cjose_jws_multi_sig_json(
+        const jws_multi_sig *sig,
+        json_t *json,
         cjose_err *err)
 {
-    *dst = (char *)malloc(len + 1);
-    if (NULL == dst)
+    // the members of a signature, in a general or flattened serialization
+    const cjose_jws_t *jws = sig->jws;
+    if (json_object_set_new(json, "protected", 
+                json_stringn(jws->hdr_b64u, jws->hdr_b64u_len)) != 0 ||
+            (NULL != sig->hdr && 
+                json_object_set(json, "header", sig->hdr) != 0) ||
+            json_object_set_new(json, "signature", 
+                json_stringn(jws->sig_b64u, jws->sig_b64u_len)) != 0)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
         return false;
     }
 
-    strncpy(*dst, src, len);
-    (*dst)[len] = 0;
-
     return true;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-cjose_jws_t *cjose_jws_import(
-        const char *cser,
-        size_t cser_len,
+bool cjose_jws_multi_export(
+        cjose_jws_multi_t *multi,
+        bool flattened,
+        const char **ser,
         cjose_err *err)
 {
-    cjose_jws_t *jws = NULL;
-    size_t len = 0;
+    bool retval = false;
+    json_t *json = NULL;
 
-    if (NULL == cser)
+    // only a single signature can be flattened
+    if (NULL == multi || NULL == ser || (flattened && 1 != multi->sig_count))
     {
         CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-        return NULL;
+        return false;
     }
 
-    // allocate and initialize a new JWS object
-    jws = (cjose_jws_t *)malloc(sizeof(cjose_jws_t));
-    if (NULL == jws)
+    json = json_object();
+    if (NULL == json || json_object_set_new(json, "payload", 
+            json_stringn(multi->dat_b64u, multi->dat_b64u_len)) != 0)
     {
         CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
-        return NULL;
+        goto _cjose_jws_multi_export_cleanup;
     }
-    memset(jws, 0, sizeof(cjose_jws_t));
 
-    // find the indexes of the dots
-    int idx = 0;
-    int d[2] = { 0, 0 };
-    for (int i = 0; i < cser_len && idx < 2; ++i)
+    if (flattened)
     {
-        if (cser[i] == '.')
+        if (!_cjose_jws_multi_sig_json(&multi->sigs[0], json, err))
         {
-            d[idx++] = i;
+            goto _cjose_jws_multi_export_cleanup;
+        }
+    }
+    else
+    {
+        json_t *sigs = json_array();
+        if (NULL == sigs || 
+                json_object_set_new(json, "signatures", sigs) != 0)
+        {
+            CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+            goto _cjose_jws_multi_export_cleanup;
+        }
+        for (size_t i = 0; i < multi->sig_count; ++i)
+        {
+            json_t *sig = json_object();
+            if (NULL == sig || json_array_append_new(sigs, sig) != 0)
+            {
+                CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+                goto _cjose_jws_multi_export_cleanup;
+            }
+            if (!_cjose_jws_multi_sig_json(&multi->sigs[i], sig, err))
+            {
+                goto _cjose_jws_multi_export_cleanup;
+            }
         }
     }
 
-    // fail if we didn't find both dots
-    if (0 == d[1])
+    char *out = json_dumps(json, JSON_COMPACT | JSON_PRESERVE_ORDER);
+    if (NULL == out)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-        cjose_jws_release(jws);
-        return NULL;
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        goto _cjose_jws_multi_export_cleanup;
     }
+    free(multi->ser);
+    multi->ser = out;
+    *ser = multi->ser;
 
-    // copy and decode header b64u segment
-    uint8_t *hdr_str = NULL;
-    jws->hdr_b64u_len = d[0];
-    _cjose_jws_strcpy(&jws->hdr_b64u, cser, jws->hdr_b64u_len, err);
-    if (!cjose_base64url_decode(
-            jws->hdr_b64u, jws->hdr_b64u_len, &hdr_str, &len, err) || 
-            NULL == hdr_str)
+    retval = true;
+
+    _cjose_jws_multi_export_cleanup:
+    if (NULL != json)
     {
-        cjose_jws_release(jws);
-        return NULL;        
+        json_decref(json);
     }
 
-    // deserialize JSON header
-    jws->hdr = json_loadb((const char *)hdr_str, len, 0, NULL);
-    free(hdr_str);
-    if (NULL == jws->hdr)
+    return retval;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_jws_multi_import_sig(
+        cjose_jws_multi_t *multi,
+        size_t idx,
+        json_t *json,
+        cjose_err *err)
+{
+    json_t *protected = json_object_get(json, "protected");
+    json_t *header = json_object_get(json, "header");
+    json_t *signature = json_object_get(json, "signature");
+    if (!json_is_string(protected) || !json_is_string(signature) ||
+            (NULL != header && !json_is_object(header)))
     {
         CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-        cjose_jws_release(jws);
-        return NULL;
+        return false;
     }
 
-    // validate the JSON header segment
-    if (!_cjose_jws_validate_hdr(jws, err))
+    cjose_jws_t *jws = _cjose_jws_multi_new_sig(multi, idx, err);
+    if (NULL == jws)
+    {
+        return false;
+    }
+
+    // copy and decode the protected header; it is validated on verify, so
+    // a signature with an algorithm not supported here can be ignored
+    uint8_t *hdr_str = NULL;
+    size_t hdr_len = 0;
+    jws->hdr_b64u_len = json_string_length(protected);
+    if (!_cjose_jws_strcpy(&jws->hdr_b64u, json_string_value(protected), 
+            jws->hdr_b64u_len, err) ||
+            !cjose_base64url_decode(
+                    jws->hdr_b64u, jws->hdr_b64u_len, &hdr_str, &hdr_len, err))
+    {
+        return false;
+    }
+    jws->hdr = json_loadb((const char *)hdr_str, hdr_len, 0, NULL);
+    free(hdr_str);
+    if (!json_is_object(jws->hdr))
     {
         CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-        cjose_jws_release(jws);
-        return NULL;        
+        return false;
     }
 
-    // copy and b64u decode data segment
-    jws->dat_b64u_len = d[1] - d[0] - 1;
-    _cjose_jws_strcpy(&jws->dat_b64u, cser + d[0] + 1, jws->dat_b64u_len, err);
-    if (!cjose_base64url_decode(
-            jws->dat_b64u, jws->dat_b64u_len, &jws->dat, &jws->dat_len, err))
+    // copy and decode the signature
+    jws->sig_b64u_len = json_string_length(signature);
+    if (!_cjose_jws_strcpy(&jws->sig_b64u, json_string_value(signature), 
+            jws->sig_b64u_len, err) ||
+            !cjose_base64url_decode(jws->sig_b64u, jws->sig_b64u_len, 
+                    &jws->sig, &jws->sig_len, err))
     {
-        cjose_jws_release(jws);
-        return NULL;
+        return false;
     }
 
-    // copy and b64u decode signature segment
-    jws->sig_b64u_len = cser_len - d[1] - 1;
-    _cjose_jws_strcpy(&jws->sig_b64u, cser + d[1] + 1, jws->sig_b64u_len, err);
-    if (!cjose_base64url_decode(
-            jws->sig_b64u, jws->sig_b64u_len, &jws->sig, &jws->sig_len, err))
+    // keep any unprotected header, for its kid
+    if (NULL != header)
     {
-        cjose_jws_release(jws);
-        return NULL;
+        multi->sigs[idx].hdr = json_incref(header);
     }
 
-    return jws;
+    return true;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-static bool _cjose_jws_verify_sig_ps256(
-            cjose_jws_t *jws, 
-            const cjose_jwk_t *jwk, 
-            cjose_err *err)
+cjose_jws_multi_t *cjose_jws_multi_import(
+        const char *ser,
+        size_t ser_len,
+        cjose_err *err)
 {
-    bool retval = false;
-    uint8_t *em = NULL;
-    size_t em_len = 0;
+    cjose_jws_multi_t *multi = NULL;
+    json_t *json = NULL;
 
-    // ensure jwk is RSA
-    if (jwk->kty != CJOSE_JWK_KTY_RSA)
+    if (NULL == ser)
     {
         CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-        goto _cjose_jws_verify_sig_ps256_cleanup;
+        return NULL;
     }
 
-    // use SHA-256 digest algorithm
-    const EVP_MD *digest_alg = EVP_sha256();
-    if (NULL == digest_alg)
+    json = json_loadb(ser, ser_len, 0, NULL);
+    json_t *payload = json_object_get(json, "payload");
+    json_t *sigs = json_object_get(json, "signatures");
+    if (!json_is_string(payload) || 
+            (NULL != sigs && (!json_is_array(sigs) || 0 == json_array_size(sigs))))
     {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_verify_sig_ps256_cleanup;
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
+        goto _cjose_jws_multi_import_fail;
     }
 
-    // allocate buffer for encoded message
-    em_len = RSA_size((RSA *)jwk->keydata);
-    em = (uint8_t *)malloc(em_len);
-    if (NULL == em)
+    multi = (cjose_jws_multi_t *)calloc(1, sizeof(cjose_jws_multi_t));
+    if (NULL == multi)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_verify_sig_ps256_cleanup;
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        goto _cjose_jws_multi_import_fail;
     }
 
-    // decrypt signature
-    if (RSA_public_decrypt(jws->sig_len, jws->sig, em, 
-            (RSA *)jwk->keydata, RSA_NO_PADDING) != em_len)
+    // copy the encoded payload; it is decoded on first request
+    multi->dat_b64u_len = json_string_length(payload);
+    if (!_cjose_jws_strcpy(&multi->dat_b64u, json_string_value(payload), 
+            multi->dat_b64u_len, err))
     {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_verify_sig_ps256_cleanup;
+        goto _cjose_jws_multi_import_fail;
     }
 
-    // verify decrypted signature data against PSS encoded digest
-    if (RSA_verify_PKCS1_PSS(
-           (RSA *)jwk->keydata, jws->dig, digest_alg, em, -1) != 1)
+    // a flattened serialization is a single signature alongside the payload
+    multi->sig_count = (NULL != sigs) ? json_array_size(sigs) : 1;
+    multi->sigs = (jws_multi_sig *)calloc(
+            multi->sig_count, sizeof(jws_multi_sig));
+    if (NULL == multi->sigs)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_verify_sig_ps256_cleanup;
+        CJOSE_ERROR(err, CJOSE_ERR_NO_MEMORY);
+        goto _cjose_jws_multi_import_fail;
+    }
+    for (size_t i = 0; i < multi->sig_count; ++i)
+    {
+        json_t *sig = (NULL != sigs) ? json_array_get(sigs, i) : json;
+        if (!_cjose_jws_multi_import_sig(multi, i, sig, err))
+        {
+            goto _cjose_jws_multi_import_fail;
+        }
     }
-        
-    // if we got this far - success
-    retval = true;
 
-    _cjose_jws_verify_sig_ps256_cleanup:
-    free(em);
+    json_decref(json);
+    return multi;
 
-    return retval;
+    _cjose_jws_multi_import_fail:
+    if (NULL != json)
+    {
+        json_decref(json);
+    }
+    cjose_jws_multi_release(multi);
+    return NULL;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-int _const_memcmp(const uint8_t *a, const uint8_t *b, const size_t size) 
+static const char *_cjose_jws_multi_kid(const jws_multi_sig *sig)
 {
-  unsigned char result = 0; 
-  for (size_t i = 0; i < size; i++) {
-    result |= a[i] ^ b[i];
-  }
-  return result;
+    // the kid may be in the protected or the unprotected header
+    const char *kid = json_string_value(
+            json_object_get(sig->jws->hdr, CJOSE_HDR_KID));
+    if (NULL == kid && NULL != sig->hdr)
+    {
+        kid = json_string_value(json_object_get(sig->hdr, CJOSE_HDR_KID));
+    }
+    return kid;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-static bool _cjose_jws_verify_sig_rs256(
-            cjose_jws_t *jws, 
-            const cjose_jwk_t *jwk, 
-            cjose_err *err)
+bool cjose_jws_multi_verify(
+        cjose_jws_multi_t *multi,
+        const cjose_jwk_t *jwk,
+        const char *kid,
+        cjose_err *err)
 {
-    return true;
-
-    bool retval = false;
-    uint8_t *dig = NULL;
-    size_t dig_len = 0;
-
-    // ensure jwk is RSA
-    if (jwk->kty != CJOSE_JWK_KTY_RSA)
+    if (NULL == multi || NULL == jwk)
     {
         CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-        goto _cjose_jws_verify_sig_rs256_cleanup;
+        return false;
     }
 
-    // allocate buffer for decrypted digest
-    dig_len = RSA_size((RSA *)jwk->keydata);
-    dig = (uint8_t *)malloc(dig_len);
-    if (NULL == dig)
+    // verify only the signatures with the given kid, or else try each
+    bool tried = false;
+    for (size_t i = 0; i < multi->sig_count; ++i)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_verify_sig_rs256_cleanup;
-    }
+        if (NULL != kid)
+        {
+            const char *sig_kid = _cjose_jws_multi_kid(&multi->sigs[i]);
+            if (NULL == sig_kid || strcmp(kid, sig_kid) != 0)
+            {
+                continue;
+            }
+        }
 
-    // decrypt digest - check it's at least the right length
-    dig_len = RSA_public_decrypt(jws->sig_len, jws->sig, dig, 
-            (RSA *)jwk->keydata, RSA_PKCS1_PADDING);
-    if (-1 == dig_len)
-    {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_verify_sig_rs256_cleanup;
+        tried = true;
+        if (_cjose_jws_verify(multi->sigs[i].jws, jwk, err))
+        {
+            return true;
+        }
     }
 
-    // verify decrypted digest matches computed digest
-    if ((_const_memcmp(jws->dig, dig, jws->dig_len) != 0) ||
-        (dig_len != jws->dig_len))
+    if (!tried)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_CRYPTO);
-        goto _cjose_jws_verify_sig_rs256_cleanup;
+        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
     }
-        
-    // if we got this far - success
-    retval = true;
-
-    _cjose_jws_verify_sig_rs256_cleanup:
-    free(dig);
-
-    return retval;
+    return false;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-bool cjose_jws_verify(
-        cjose_jws_t *jws,
-        const cjose_jwk_t *jwk,
+bool cjose_jws_multi_get_plaintext(
+        const cjose_jws_multi_t *multi,
+        uint8_t **plaintext,
+        size_t *plaintext_len,
         cjose_err *err)
 {
-    if (NULL == jws || NULL == jwk)
+    if (NULL == multi || NULL == plaintext || NULL == plaintext_len)
     {
         CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
         return false;
     }
 
-    // validate JWS header
-    if (!_cjose_jws_validate_hdr(jws, err))
-    {
-        cjose_jws_release(jws);
-        return false;
-    }
-
-    // build JWS digest from header and payload (hashed signing input value)
-    if (!jws->fns.digest(jws, jwk, err))
+    // an imported payload is decoded on first request and kept, as with
+    // cjose_jws_get_plaintext
+    if (NULL == multi->dat)
     {
-        cjose_jws_release(jws);
-        return false;
+        cjose_jws_multi_t *mut = (cjose_jws_multi_t *)multi;
+        if (!cjose_base64url_decode_parallel(
+                mut->dat_b64u, mut->dat_b64u_len, &mut->dat, &mut->dat_len, 
+                cjose_base64_get_parallel_threads(), err))
+        {
+            return false;
+        }
     }
 
-    // verify JWS signature
-    if (!jws->fns.verify(jws, jwk, err))
-    {
-        cjose_jws_release(jws);
-        return false;
-    }
+    *plaintext = multi->dat;
+    *plaintext_len = multi->dat_len;
 
     return true;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-bool cjose_jws_get_plaintext(
-        const cjose_jws_t *jws,
-        uint8_t **plaintext,
-        size_t *plaintext_len,
-        cjose_err *err)
+void cjose_jws_multi_release(cjose_jws_multi_t *multi)
 {
-    if (NULL == jws || NULL == plaintext || NULL == jws->dat)
+    if (NULL == multi)
     {
-        CJOSE_ERROR(err, CJOSE_ERR_INVALID_ARG);
-        return false;
+        return;
     }
 
-    *plaintext = jws->dat;
-    *plaintext_len = jws->dat_len;
-
-    return true;
+    for (size_t i = 0; NULL != multi->sigs && i < multi->sig_count; ++i)
+    {
+        cjose_jws_release(multi->sigs[i].jws);
+        if (NULL != multi->sigs[i].hdr)
+        {
+            json_decref(multi->sigs[i].hdr);
+        }
+    }
+    free(multi->sigs);
+    free(multi->dat);
+    free(multi->dat_b64u);
+    free(multi->ser);
+    free(multi);
 }
@@ -0,0 +1,205 @@
+/*!
+ * Copyrights
+ *
+ * Portions created or assigned to Cisco Systems, Inc. are
+ * Copyright (c) 2014-2016 Cisco Systems, Inc.  All Rights Reserved.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <assert.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include <openssl/err.h>
+#include "include/thread_int.h"
+
+
+// one call to make on a worker thread
+typedef struct _parallel_task_int
+{
+    void (*fn)(void *arg, size_t idx);
+    void *arg;
+    size_t idx;
+} _parallel_task;
+
+
+#ifdef _WIN32
+typedef HANDLE _thread_t;
+#else
+typedef pthread_t _thread_t;
+#endif
+
+
+struct _cjose_mutex_int
+{
+#ifdef _WIN32
+    CRITICAL_SECTION cs;
+#else
+    pthread_mutex_t mutex;
+#endif
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+#ifdef _WIN32
+static DWORD WINAPI _cjose_parallel_thread(LPVOID param)
+#else
+static void *_cjose_parallel_thread(void *param)
+#endif
+{
+    _parallel_task *task = (_parallel_task *)param;
+    task->fn(task->arg, task->idx);
+
+    // OpenSSL keeps an error queue for every thread that has used it, which
+    // a thread must free before it exits (a failed verification leaves one)
+    ERR_remove_thread_state(NULL);
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static bool _cjose_thread_start(_thread_t *thread, _parallel_task *task)
+{
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, _cjose_parallel_thread, task, 0, NULL);
+    return (NULL != *thread);
+#else
+    return (0 == pthread_create(thread, NULL, _cjose_parallel_thread, task));
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+static void _cjose_thread_join(_thread_t thread)
+{
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+size_t _cjose_cpu_count()
+{
+    long count = 1;
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    count = (long)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    if (count < 1)
+    {
+        return 1;
+    }
+    return (count > CJOSE_PARALLEL_MAX) ? CJOSE_PARALLEL_MAX : (size_t)count;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+void _cjose_parallel_run(
+        size_t count,
+        void (*fn)(void *arg, size_t idx),
+        void *arg)
+{
+    _parallel_task tasks[CJOSE_PARALLEL_MAX];
+    _thread_t threads[CJOSE_PARALLEL_MAX];
+    bool started[CJOSE_PARALLEL_MAX];
+
+    assert(count <= CJOSE_PARALLEL_MAX);
+
+    // start a thread for every index but the first, running any that
+    // cannot be started right here instead
+    for (size_t idx = 1; idx < count; ++idx)
+    {
+        tasks[idx].fn = fn;
+        tasks[idx].arg = arg;
+        tasks[idx].idx = idx;
+        started[idx] = _cjose_thread_start(&threads[idx], &tasks[idx]);
+        if (!started[idx])
+        {
+            fn(arg, idx);
+        }
+    }
+
+    if (0 < count)
+    {
+        fn(arg, 0);
+    }
+
+    for (size_t idx = 1; idx < count; ++idx)
+    {
+        if (started[idx])
+        {
+            _cjose_thread_join(threads[idx]);
+        }
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+_cjose_mutex *_cjose_mutex_new()
+{
+    _cjose_mutex *mutex = (_cjose_mutex *)malloc(sizeof(_cjose_mutex));
+    if (NULL == mutex)
+    {
+        return NULL;
+    }
+#ifdef _WIN32
+    InitializeCriticalSection(&mutex->cs);
+#else
+    if (0 != pthread_mutex_init(&mutex->mutex, NULL))
+    {
+        free(mutex);
+        return NULL;
+    }
+#endif
+    return mutex;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+void _cjose_mutex_free(_cjose_mutex *mutex)
+{
+    if (NULL == mutex)
+    {
+        return;
+    }
+#ifdef _WIN32
+    DeleteCriticalSection(&mutex->cs);
+#else
+    pthread_mutex_destroy(&mutex->mutex);
+#endif
+    free(mutex);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+void _cjose_mutex_lock(_cjose_mutex *mutex)
+{
+#ifdef _WIN32
+    EnterCriticalSection(&mutex->cs);
+#else
+    pthread_mutex_lock(&mutex->mutex);
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+void _cjose_mutex_unlock(_cjose_mutex *mutex)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(&mutex->cs);
+#else
+    pthread_mutex_unlock(&mutex->mutex);
+#endif
+}
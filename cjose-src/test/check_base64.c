@@ -2,6 +2,7 @@
 #include "check_cjose.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <cjose/base64.h>
 
@@ -426,6 +427,382 @@ START_TEST(test_cjose_base64url_decode)
 }
 END_TEST
 
+static size_t _reference_encode(
+        const uint8_t *input, size_t inlen, char *output, bool url)
+{
+    const char *alphabet = url ?
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_" :
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t pos = 0;
+    for (size_t idx = 0; idx < inlen; idx += 3)
+    {
+        size_t left = inlen - idx;
+        uint32_t packed = input[idx] << 16;
+        packed |= (1 < left) ? input[idx+1] << 8 : 0;
+        packed |= (2 < left) ? input[idx+2] : 0;
+        output[pos++] = alphabet[(packed >> 18) & 0x3f];
+        output[pos++] = alphabet[(packed >> 12) & 0x3f];
+        if (1 < left)
+        {
+            output[pos++] = alphabet[(packed >> 6) & 0x3f];
+        }
+        else if (!url)
+        {
+            output[pos++] = '=';
+        }
+        if (2 < left)
+        {
+            output[pos++] = alphabet[packed & 0x3f];
+        }
+        else if (!url)
+        {
+            output[pos++] = '=';
+        }
+    }
+    output[pos] = '\0';
+    return pos;
+}
+
+START_TEST(test_cjose_base64_encode_long)
+{
+    cjose_err err;
+    char *output = NULL;
+    size_t outlen = 0;
+
+    // long enough to exercise every vectorized block size and tail length
+    uint8_t *input = (uint8_t *)malloc(1024);
+    char *expected = (char *)malloc(2048);
+    for (size_t idx = 0; idx < 1024; ++idx)
+    {
+        input[idx] = (uint8_t)(idx * 7 + (idx >> 3));
+    }
+
+    for (size_t inlen = 0; inlen <= 1024; ++inlen)
+    {
+        size_t explen = _reference_encode(input, inlen, expected, false);
+        ck_assert(cjose_base64_encode(input, inlen, &output, &outlen, &err));
+        ck_assert_int_eq(explen, outlen);
+        ck_assert_str_eq(expected, output);
+        free(output);
+
+        explen = _reference_encode(input, inlen, expected, true);
+        ck_assert(cjose_base64url_encode(input, inlen, &output, &outlen, &err));
+        ck_assert_int_eq(explen, outlen);
+        ck_assert_str_eq(expected, output);
+        free(output);
+    }
+
+    free(expected);
+    free(input);
+}
+END_TEST
+
+START_TEST(test_cjose_base64_decode_long)
+{
+    cjose_err err;
+    uint8_t *output = NULL;
+    size_t outlen = 0;
+
+    uint8_t *input = (uint8_t *)malloc(512);
+    char *encoded = (char *)malloc(1024);
+    for (size_t idx = 0; idx < 512; ++idx)
+    {
+        input[idx] = (uint8_t)(idx * 13 + (idx >> 2));
+    }
+
+    // round trip every length through the vectorized block sizes
+    for (size_t inlen = 0; inlen <= 512; ++inlen)
+    {
+        size_t enclen = _reference_encode(input, inlen, encoded, false);
+        ck_assert(cjose_base64_decode(encoded, enclen, &output, &outlen, &err));
+        ck_assert_int_eq(inlen, outlen);
+        ck_assert_bin_eq(input, output, inlen);
+        free(output);
+
+        enclen = _reference_encode(input, inlen, encoded, true);
+        ck_assert(cjose_base64url_decode(encoded, enclen, &output, &outlen, &err));
+        ck_assert_int_eq(inlen, outlen);
+        ck_assert_bin_eq(input, output, inlen);
+        free(output);
+    }
+
+    // a bad character anywhere in a long input is rejected
+    size_t enclen = _reference_encode(input, 384, encoded, true);
+    const char bad[] = { '+', '/', '=', '.', '\x80' };
+    for (size_t idx = 0; idx < enclen; ++idx)
+    {
+        const char orig = encoded[idx];
+        encoded[idx] = bad[idx % sizeof(bad)];
+        output = NULL;
+        outlen = 0;
+        if ('=' == encoded[idx])
+        {
+            // decoding stops at the first pad character
+            if (1 != idx % 4)
+            {
+                ck_assert(cjose_base64url_decode(
+                        encoded, enclen, &output, &outlen, &err));
+                ck_assert_int_eq((idx / 4) * 3 + (idx % 4 ? idx % 4 - 1 : 0),
+                        outlen);
+                free(output);
+            }
+        }
+        else
+        {
+            ck_assert(!cjose_base64url_decode(
+                    encoded, enclen, &output, &outlen, &err));
+            ck_assert(NULL == output);
+            ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+        }
+        encoded[idx] = orig;
+    }
+
+    free(encoded);
+    free(input);
+}
+END_TEST
+
+START_TEST(test_cjose_base64_into)
+{
+    cjose_err err;
+    char encoded[64];
+    uint8_t decoded[64];
+    size_t outlen = 0;
+
+    // sizes match what the allocating functions produce
+    ck_assert_int_eq(16, cjose_base64_encoded_len(11));
+    ck_assert_int_eq(15, cjose_base64url_encoded_len(11));
+    ck_assert_int_eq(16, cjose_base64url_encoded_len(12));
+    ck_assert_int_eq(2, cjose_base64url_encoded_len(1));
+    ck_assert_int_eq(0, cjose_base64url_encoded_len(0));
+    ck_assert_int_eq(12, cjose_base64_decoded_max_len(16));
+    ck_assert_int_eq(11, cjose_base64url_decoded_max_len(15));
+    ck_assert_int_eq(1, cjose_base64url_decoded_max_len(2));
+    ck_assert_int_eq(0, cjose_base64url_decoded_max_len(0));
+
+    // encode into an exactly sized buffer
+    const uint8_t *input = (const uint8_t *)"hello\xfethere";
+    ck_assert(cjose_base64url_encode_into(
+            input, 11, encoded, 15, &outlen, &err));
+    ck_assert_int_eq(15, outlen);
+    ck_assert(0 == strncmp("aGVsbG_-dGhlcmU", encoded, outlen));
+    ck_assert(cjose_base64_encode_into(
+            input, 11, encoded, sizeof(encoded), &outlen, &err));
+    ck_assert_int_eq(16, outlen);
+    ck_assert(0 == strncmp("aGVsbG/+dGhlcmU=", encoded, outlen));
+
+    // encode into a buffer that is too small
+    ck_assert(!cjose_base64url_encode_into(
+            input, 11, encoded, 14, &outlen, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+
+    // decode into an exactly sized buffer
+    ck_assert(cjose_base64url_decode_into(
+            "aGVsbG_-dGhlcmU", 15, decoded, 11, &outlen, &err));
+    ck_assert_int_eq(11, outlen);
+    ck_assert_bin_eq(input, decoded, 11);
+    ck_assert(cjose_base64_decode_into(
+            "aGVsbG/+dGhlcmU=", 16, decoded, 11, &outlen, &err));
+    ck_assert_int_eq(11, outlen);
+    ck_assert_bin_eq(input, decoded, 11);
+
+    // decode into a buffer that is too small
+    ck_assert(!cjose_base64url_decode_into(
+            "aGVsbG_-dGhlcmU", 15, decoded, 10, &outlen, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+
+    // empty input needs no buffer
+    outlen = 1;
+    ck_assert(cjose_base64url_encode_into(NULL, 0, NULL, 0, &outlen, &err));
+    ck_assert_int_eq(0, outlen);
+    outlen = 1;
+    ck_assert(cjose_base64url_decode_into("", 0, NULL, 0, &outlen, &err));
+    ck_assert_int_eq(0, outlen);
+
+    // invalid characters are still rejected
+    ck_assert(!cjose_base64url_decode_into(
+            "aGVsbG/+dGhlcmU", 15, decoded, sizeof(decoded), &outlen, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+}
+END_TEST
+
+START_TEST(test_cjose_base64url_decode_inplace)
+{
+    cjose_err err;
+    size_t outlen = 0;
+
+    uint8_t *input = (uint8_t *)malloc(512);
+    char *encoded = (char *)malloc(1024);
+    for (size_t idx = 0; idx < 512; ++idx)
+    {
+        input[idx] = (uint8_t)(idx * 7 + (idx >> 3));
+    }
+
+    // the decoded octets overwrite the start of the buffer at every length
+    for (size_t inlen = 0; inlen <= 512; ++inlen)
+    {
+        size_t enclen = _reference_encode(input, inlen, encoded, true);
+        ck_assert(cjose_base64url_decode_inplace(
+                encoded, enclen, &outlen, &err));
+        ck_assert_int_eq(inlen, outlen);
+        ck_assert_bin_eq(input, (uint8_t *)encoded, inlen);
+    }
+
+    // invalid input is rejected
+    size_t enclen = _reference_encode(input, 300, encoded, true);
+    encoded[enclen - 10] = '+';
+    ck_assert(!cjose_base64url_decode_inplace(
+            encoded, enclen, &outlen, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+    ck_assert(!cjose_base64url_decode_inplace(NULL, 4, &outlen, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+
+    free(encoded);
+    free(input);
+}
+END_TEST
+
+START_TEST(test_cjose_base64url_parallel)
+{
+    cjose_err err;
+    char *encoded = NULL, *expected = NULL;
+    uint8_t *decoded = NULL, *serial = NULL;
+    size_t enclen = 0, explen = 0, declen = 0, serlen = 0;
+
+    // large enough to be split, and not a multiple of 3
+    const size_t inlen = 3 * CJOSE_BASE64_PARALLEL_MIN + 1;
+    uint8_t *input = (uint8_t *)malloc(inlen);
+    for (size_t idx = 0; idx < inlen; ++idx)
+    {
+        input[idx] = (uint8_t)(idx * 31 + (idx >> 9));
+    }
+    ck_assert(cjose_base64url_encode(input, inlen, &expected, &explen, &err));
+
+    // the result matches the serial encoder for any thread count
+    const size_t threads[] = { 0, 1, 2, 3, 7 };
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t)
+    {
+        ck_assert(cjose_base64url_encode_parallel(
+                input, inlen, &encoded, &enclen, threads[t], &err));
+        ck_assert_int_eq(explen, enclen);
+        ck_assert_str_eq(expected, encoded);
+        ck_assert(!cjose_base64url_encode_parallel_into(
+                input, inlen, encoded, enclen - 1, &enclen, threads[t], &err));
+        ck_assert(cjose_base64url_encode_parallel_into(
+                input, inlen, encoded, explen, &enclen, threads[t], &err));
+        ck_assert_int_eq(explen, enclen);
+        ck_assert(memcmp(expected, encoded, explen) == 0);
+        free(encoded);
+
+        ck_assert(cjose_base64url_decode_parallel(
+                expected, explen, &decoded, &declen, threads[t], &err));
+        ck_assert_int_eq(inlen, declen);
+        ck_assert_bin_eq(input, decoded, inlen);
+        free(decoded);
+    }
+
+    // a bad character in any slice is rejected
+    expected[explen / 2 + 1] = '+';
+    ck_assert(!cjose_base64url_decode_parallel(
+            expected, explen, &decoded, &declen, 4, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+
+    // padding ends the input early, as it does for the serial decoder
+    expected[explen / 2 + 1] = '=';
+    expected[explen / 2 + 2] = '=';
+    ck_assert(cjose_base64url_decode(
+            expected, explen, &serial, &serlen, &err));
+    ck_assert(cjose_base64url_decode_parallel(
+            expected, explen, &decoded, &declen, 4, &err));
+    ck_assert_int_eq(serlen, declen);
+    ck_assert_bin_eq(serial, decoded, serlen);
+    free(serial);
+    free(decoded);
+
+    free(expected);
+    free(input);
+}
+END_TEST
+
+START_TEST(test_cjose_base64url_streaming)
+{
+    cjose_err err;
+    cjose_base64url_encoder_t enc;
+    cjose_base64url_decoder_t dec;
+    size_t len = 0;
+
+    uint8_t *input = (uint8_t *)malloc(700);
+    char *expected = (char *)malloc(1024);
+    char *encoded = (char *)malloc(1024);
+    uint8_t *decoded = (uint8_t *)malloc(700);
+    for (size_t idx = 0; idx < 700; ++idx)
+    {
+        input[idx] = (uint8_t)(idx * 31 + (idx >> 5));
+    }
+    size_t explen = _reference_encode(input, 700, expected, true);
+
+    // feed the same data in chunks of varying sizes
+    for (size_t chunk = 1; chunk <= 67; ++chunk)
+    {
+        size_t pos = 0;
+        cjose_base64url_encoder_init(&enc);
+        for (size_t idx = 0; idx < 700; idx += chunk)
+        {
+            size_t inlen = (700 - idx < chunk) ? 700 - idx : chunk;
+            ck_assert(cjose_base64url_encoder_update(&enc, input + idx, inlen,
+                    encoded + pos, cjose_base64_encoded_len(inlen), &len, &err));
+            pos += len;
+        }
+        ck_assert(cjose_base64url_encoder_final(
+                &enc, encoded + pos, 3, &len, &err));
+        pos += len;
+        ck_assert_int_eq(explen, pos);
+        ck_assert(0 == strncmp(expected, encoded, explen));
+
+        pos = 0;
+        cjose_base64url_decoder_init(&dec);
+        for (size_t idx = 0; idx < explen; idx += chunk)
+        {
+            size_t inlen = (explen - idx < chunk) ? explen - idx : chunk;
+            ck_assert(cjose_base64url_decoder_update(&dec, expected + idx,
+                    inlen, decoded + pos, 
+                    cjose_base64url_decoded_max_len(inlen + 3), &len, &err));
+            pos += len;
+        }
+        ck_assert(cjose_base64url_decoder_final(
+                &dec, decoded + pos, 2, &len, &err));
+        pos += len;
+        ck_assert_int_eq(700, pos);
+        ck_assert_bin_eq(input, decoded, 700);
+    }
+
+    // invalid characters and padding are rejected
+    cjose_base64url_decoder_init(&dec);
+    ck_assert(cjose_base64url_decoder_update(
+            &dec, "aGV", 3, decoded, 700, &len, &err));
+    ck_assert(!cjose_base64url_decoder_update(
+            &dec, "/s", 2, decoded, 700, &len, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+    cjose_base64url_decoder_init(&dec);
+    ck_assert(!cjose_base64url_decoder_update(
+            &dec, "AQ==", 4, decoded, 700, &len, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+
+    // a single left over character cannot be decoded
+    cjose_base64url_decoder_init(&dec);
+    ck_assert(cjose_base64url_decoder_update(
+            &dec, "aGVsb", 5, decoded, 700, &len, &err));
+    ck_assert_int_eq(3, len);
+    ck_assert(!cjose_base64url_decoder_final(&dec, decoded, 2, &len, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+
+    free(decoded);
+    free(encoded);
+    free(expected);
+    free(input);
+}
+END_TEST
+
 Suite *cjose_base64_suite()
 {
     Suite *suite = suite_create("base64");
@@ -433,8 +810,14 @@ Suite *cjose_base64_suite()
     TCase *tc_b64 = tcase_create("core");
     tcase_add_test(tc_b64, test_cjose_base64_encode);
     tcase_add_test(tc_b64, test_cjose_base64url_encode);
+    tcase_add_test(tc_b64, test_cjose_base64_encode_long);
     tcase_add_test(tc_b64, test_cjose_base64_decode);
     tcase_add_test(tc_b64, test_cjose_base64url_decode);
+    tcase_add_test(tc_b64, test_cjose_base64_decode_long);
+    tcase_add_test(tc_b64, test_cjose_base64_into);
+    tcase_add_test(tc_b64, test_cjose_base64url_decode_inplace);
+    tcase_add_test(tc_b64, test_cjose_base64url_parallel);
+    tcase_add_test(tc_b64, test_cjose_base64url_streaming);
     suite_add_tcase(suite, tc_b64);
 
     return suite;
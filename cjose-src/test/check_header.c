@@ -64,6 +64,36 @@ START_TEST(test_cjose_header_set_get)
 END_TEST
 
 
+START_TEST(test_cjose_header_set_b64)
+{
+    cjose_err err;
+
+    cjose_header_t *header = cjose_header_new(&err);
+    ck_assert_msg(NULL != header, "cjose_header_new failed");
+
+    // setting it twice lists it as critical once
+    ck_assert_msg(cjose_header_set_b64(header, true, &err),
+            "cjose_header_set_b64 failed");
+    ck_assert_msg(cjose_header_set_b64(header, false, &err),
+            "cjose_header_set_b64 failed");
+
+    json_t *b64 = json_object_get(header, CJOSE_HDR_B64);
+    ck_assert(json_is_false(b64));
+    json_t *crit = json_object_get(header, CJOSE_HDR_CRIT);
+    ck_assert(json_is_array(crit) && 1 == json_array_size(crit));
+    ck_assert_str_eq(CJOSE_HDR_B64, json_string_value(json_array_get(crit, 0)));
+
+    // a "crit" that is not an array is not added to
+    ck_assert(cjose_header_set(header, CJOSE_HDR_CRIT, "b64", &err));
+    ck_assert(!cjose_header_set_b64(header, false, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+    ck_assert(!cjose_header_set_b64(NULL, false, &err));
+
+    cjose_header_release(header);
+}
+END_TEST
+
+
 Suite *cjose_header_suite()
 {
     Suite *suite = suite_create("header");
@@ -71,6 +101,7 @@ Suite *cjose_header_suite()
     TCase *tc_header = tcase_create("core");
     tcase_add_test(tc_header, test_cjose_header_new_release);
     tcase_add_test(tc_header, test_cjose_header_set_get);
+    tcase_add_test(tc_header, test_cjose_header_set_b64);
     suite_add_tcase(suite, tc_header);
 
     return suite;
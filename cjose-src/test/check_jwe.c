@@ -233,6 +233,400 @@ START_TEST(test_cjose_jwe_self_encrypt_self_decrypt_many)
 }
 END_TEST
 
+START_TEST(test_cjose_jwe_encrypt_into)
+{
+    cjose_err err;
+
+    const char *algs[] = { CJOSE_HDR_ALG_RSA_OAEP, CJOSE_HDR_ALG_DIR };
+    const char *keys[] = { JWK_RSA, JWK_OCT };
+    const size_t lens[] = { 4096, 1000, 4096, 0, 17 };
+    uint8_t plain[4096];
+    for (size_t i = 0; i < sizeof(plain); ++i)
+    {
+        plain[i] = (uint8_t)(i * 13);
+    }
+
+    for (int k = 0; k < 2; ++k)
+    {
+        cjose_jwk_t *jwk = cjose_jwk_import(keys[k], strlen(keys[k]), &err);
+        ck_assert(NULL != jwk);
+        cjose_header_t *hdr = cjose_header_new(&err);
+        ck_assert(cjose_header_set(hdr, CJOSE_HDR_ALG, algs[k], &err));
+        ck_assert(cjose_header_set(
+                hdr, CJOSE_HDR_ENC, CJOSE_HDR_ENC_A256GCM, &err));
+
+        // encrypt payloads of several sizes into one JWE
+        cjose_jwe_t *jwe = cjose_jwe_new(&err);
+        ck_assert(NULL != jwe);
+        uint8_t *ct = NULL;
+        for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); ++i)
+        {
+            ck_assert_msg(cjose_jwe_encrypt_into(
+                    jwe, jwk, hdr, plain, lens[i], &err),
+                    "cjose_jwe_encrypt_into failed: "
+                    "%s, file: %s, function: %s, line: %ld", 
+                    err.message, err.file, err.function, err.line);
+
+            // the ciphertext buffer is kept once it is big enough
+            if (0 < i)
+            {
+                ck_assert(ct == jwe->part[3].raw);
+            }
+            ct = jwe->part[3].raw;
+
+            // and each one decrypts
+            size_t len = 0;
+            ck_assert(cjose_jwe_export_into(jwe, NULL, 0, &len, &err));
+            char *cser = (char *)malloc(len);
+            ck_assert(cjose_jwe_export_into(jwe, cser, len, &len, &err));
+            cjose_jwe_t *jwe2 = cjose_jwe_import_consume(cser, len, &err);
+            ck_assert(NULL != jwe2);
+            size_t plain2_len = 0;
+            uint8_t *plain2 = cjose_jwe_decrypt(jwe2, jwk, &plain2_len, &err);
+            ck_assert(NULL != plain2);
+            ck_assert(plain2_len == lens[i]);
+            ck_assert(memcmp(plain, plain2, plain2_len) == 0);
+            free(plain2);
+
+            // a JWE imported in place can be encrypted into too
+            ck_assert(cjose_jwe_encrypt_into(
+                    jwe2, jwk, hdr, plain, lens[i], &err));
+            cjose_jwe_release(jwe2);
+            free(cser);
+        }
+
+        ck_assert(!cjose_jwe_encrypt_into(NULL, jwk, hdr, plain, 1, &err));
+        ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+
+        cjose_jwe_reset(jwe);
+        cjose_jwe_release(jwe);
+        cjose_header_release(hdr);
+        cjose_jwk_release(jwk);
+    }
+}
+END_TEST
+
+
+START_TEST(test_cjose_jwe_dir_keyed_context)
+{
+    cjose_err err;
+
+    static const char *plain = 
+        "The mind is everything. What you think you become.";
+    size_t plain_len = strlen(plain);
+
+    // only a 256-bit oct key has a keyed A256GCM context
+    cjose_jwk_t *jwk = cjose_jwk_create_oct_random(128, &err);
+    ck_assert(NULL != jwk);
+    ck_assert(NULL == jwk->gcm);
+    cjose_jwk_release(jwk);
+    jwk = cjose_jwk_import(JWK_OCT, strlen(JWK_OCT), &err);
+    ck_assert(NULL != jwk);
+    ck_assert(NULL != jwk->gcm);
+
+    cjose_header_t *hdr = cjose_header_new(&err);
+    ck_assert(cjose_header_set(hdr, CJOSE_HDR_ALG, CJOSE_HDR_ALG_DIR, &err));
+    ck_assert(cjose_header_set(
+            hdr, CJOSE_HDR_ENC, CJOSE_HDR_ENC_A256GCM, &err));
+
+    // the key is not copied into the JWE, and each message has its own IV
+    cjose_jwe_t *jwe1 = cjose_jwe_encrypt(
+            jwk, hdr, (uint8_t *)plain, plain_len, &err);
+    ck_assert(NULL != jwe1);
+    ck_assert(0 == jwe1->cek_len);
+    cjose_jwe_t *jwe2 = cjose_jwe_encrypt(
+            jwk, hdr, (uint8_t *)plain, plain_len, &err);
+    ck_assert(NULL != jwe2);
+    ck_assert(memcmp(jwe1->part[2].raw, jwe2->part[2].raw, 
+            jwe1->part[2].raw_len) != 0);
+    ck_assert(memcmp(jwe1->part[3].raw, jwe2->part[3].raw, 
+            jwe1->part[3].raw_len) != 0);
+
+    // both decrypt with the key's context
+    char *cser = NULL;
+    for (int i = 0; i < 2; ++i)
+    {
+        cser = cjose_jwe_export(0 == i ? jwe1 : jwe2, &err);
+        ck_assert(NULL != cser);
+        cjose_jwe_t *jwe = cjose_jwe_import(cser, strlen(cser), &err);
+        ck_assert(NULL != jwe);
+        size_t dec_len = 0;
+        uint8_t *dec = cjose_jwe_decrypt(jwe, jwk, &dec_len, &err);
+        ck_assert_msg(NULL != dec, "cjose_jwe_decrypt failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+        ck_assert(dec_len == plain_len && memcmp(plain, dec, dec_len) == 0);
+        free(dec);
+        free(cser);
+        cjose_jwe_release(jwe);
+    }
+
+    // a tampered tag still fails
+    jwe1->part[4].raw[0] ^= 0x01;
+    jwe1->part[4].b64u_len = 0;
+    cser = cjose_jwe_export(jwe1, &err);
+    ck_assert(NULL != cser);
+    cjose_jwe_t *jwe = cjose_jwe_import(cser, strlen(cser), &err);
+    ck_assert(NULL != jwe);
+    size_t dec_len = 0;
+    ck_assert(NULL == cjose_jwe_decrypt(jwe, jwk, &dec_len, &err));
+    free(cser);
+    cjose_jwe_release(jwe);
+
+    cjose_jwe_release(jwe1);
+    cjose_jwe_release(jwe2);
+    cjose_header_release(hdr);
+    cjose_jwk_release(jwk);
+}
+END_TEST
+
+
+static void _stream_append(
+        char **buf, size_t *buf_len, const void *piece, size_t piece_len)
+{
+    *buf = (char *)realloc(*buf, *buf_len + piece_len + 1);
+    memcpy(*buf + *buf_len, piece, piece_len);
+    *buf_len += piece_len;
+    (*buf)[*buf_len] = 0;
+}
+
+
+START_TEST(test_cjose_jwe_decrypt_into)
+{
+    cjose_err err;
+
+    static const char *plain = 
+        "The mind is everything. What you think you become.";
+    size_t plain_len = strlen(plain);
+
+    cjose_jwk_t *jwk = cjose_jwk_import(JWK_OCT, strlen(JWK_OCT), &err);
+    ck_assert(NULL != jwk);
+    cjose_header_t *hdr = cjose_header_new(&err);
+    ck_assert(cjose_header_set(hdr, CJOSE_HDR_ALG, CJOSE_HDR_ALG_DIR, &err));
+    ck_assert(cjose_header_set(
+            hdr, CJOSE_HDR_ENC, CJOSE_HDR_ENC_A256GCM, &err));
+    cjose_jwe_t *jwe = cjose_jwe_encrypt(
+            jwk, hdr, (uint8_t *)plain, plain_len, &err);
+    ck_assert(NULL != jwe);
+    char *cser = cjose_jwe_export(jwe, &err);
+    ck_assert(NULL != cser);
+    cjose_jwe_release(jwe);
+    jwe = cjose_jwe_import(cser, strlen(cser), &err);
+    ck_assert(NULL != jwe);
+
+    // the size needed is known before decrypting
+    size_t dec_len = 0;
+    ck_assert(cjose_jwe_decrypt_into(jwe, NULL, NULL, 0, &dec_len, &err));
+    ck_assert(dec_len == plain_len);
+
+    // a buffer too small is not written to
+    uint8_t dec[256];
+    memset(dec, 0xAA, sizeof(dec));
+    dec_len = 0;
+    ck_assert(!cjose_jwe_decrypt_into(
+            jwe, jwk, dec, plain_len - 1, &dec_len, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+    ck_assert(dec_len == plain_len);
+    ck_assert(0xAA == dec[0]);
+
+    ck_assert_msg(cjose_jwe_decrypt_into(
+            jwe, jwk, dec, sizeof(dec), &dec_len, &err), 
+            "cjose_jwe_decrypt_into failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert(dec_len == plain_len && memcmp(plain, dec, dec_len) == 0);
+    cjose_jwe_release(jwe);
+
+    // content that fails to authenticate is not left in the buffer
+    jwe = cjose_jwe_import(cser, strlen(cser), &err);
+    ck_assert(NULL != jwe);
+    jwe->part[4].raw[0] ^= 0x01;
+    memset(dec, 0xAA, sizeof(dec));
+    ck_assert(!cjose_jwe_decrypt_into(
+            jwe, jwk, dec, sizeof(dec), &dec_len, &err));
+    for (size_t i = 0; i < plain_len; ++i)
+    {
+        ck_assert(0 == dec[i]);
+    }
+    cjose_jwe_release(jwe);
+
+    free(cser);
+    cjose_header_release(hdr);
+    cjose_jwk_release(jwk);
+}
+END_TEST
+
+START_TEST(test_cjose_jwe_stream)
+{
+    cjose_err err;
+
+    const char *algs[] = { CJOSE_HDR_ALG_DIR, CJOSE_HDR_ALG_RSA_OAEP };
+    const char *keys[] = { JWK_OCT, JWK_RSA };
+
+    // content of no, a few, and several blocks of octets
+    size_t big_len = 3 * CJOSE_JWE_STREAM_BLOCK_LEN + 7;
+    char *big = (char *)malloc(big_len + 1);
+    for (size_t i = 0; i < big_len; ++i)
+    {
+        big[i] = (char)('a' + i % 26);
+    }
+    big[big_len] = 0;
+    const char *plains[] = { "", "The mind is everything.", big };
+    const size_t chunks[] = { 1, 7, 4096, 1 << 20 };
+
+    for (int a = 0; a < 2; ++a)
+    {
+        cjose_jwk_t *jwk = cjose_jwk_import(keys[a], strlen(keys[a]), &err);
+        ck_assert(NULL != jwk);
+        cjose_header_t *hdr = cjose_header_new(&err);
+        ck_assert(cjose_header_set(hdr, CJOSE_HDR_ALG, algs[a], &err));
+        ck_assert(cjose_header_set(
+                hdr, CJOSE_HDR_ENC, CJOSE_HDR_ENC_A256GCM, &err));
+
+        for (int p = 0; p < 3; ++p)
+        for (int c = 0; c < 4; ++c)
+        {
+            const char *plain = plains[p];
+            size_t plain_len = strlen(plain);
+            size_t chunk = chunks[c];
+
+            // encrypt the content a chunk at a time
+            cjose_jwe_stream_t *stream = cjose_jwe_encrypt_init(jwk, hdr, &err);
+            ck_assert_msg(NULL != stream, "cjose_jwe_encrypt_init failed: "
+                    "%s, file: %s, function: %s, line: %ld", 
+                    err.message, err.file, err.function, err.line);
+            char *cser = NULL;
+            size_t cser_len = 0;
+            const char *ser = NULL;
+            size_t ser_len = 0;
+            for (size_t idx = 0; idx < plain_len; idx += chunk)
+            {
+                size_t len = 
+                        (plain_len - idx < chunk) ? plain_len - idx : chunk;
+                ck_assert_msg(cjose_jwe_encrypt_update(stream, 
+                        (const uint8_t *)plain + idx, len, 
+                        &ser, &ser_len, &err),
+                        "cjose_jwe_encrypt_update failed: "
+                        "%s, file: %s, function: %s, line: %ld", 
+                        err.message, err.file, err.function, err.line);
+                _stream_append(&cser, &cser_len, ser, ser_len);
+            }
+            ck_assert_msg(
+                    cjose_jwe_encrypt_final(stream, &ser, &ser_len, &err),
+                    "cjose_jwe_encrypt_final failed: "
+                    "%s, file: %s, function: %s, line: %ld", 
+                    err.message, err.file, err.function, err.line);
+            _stream_append(&cser, &cser_len, ser, ser_len);
+            ck_assert(!cjose_jwe_encrypt_update(
+                    stream, (const uint8_t *)plain, 1, &ser, &ser_len, &err));
+            cjose_jwe_stream_release(stream);
+
+            // it decrypts as a whole
+            cjose_jwe_t *jwe = cjose_jwe_import(cser, cser_len, &err);
+            ck_assert(NULL != jwe);
+            size_t dec_len = 0;
+            uint8_t *dec = cjose_jwe_decrypt(jwe, jwk, &dec_len, &err);
+            ck_assert_msg(NULL != dec, "cjose_jwe_decrypt failed: "
+                    "%s, file: %s, function: %s, line: %ld", 
+                    err.message, err.file, err.function, err.line);
+            ck_assert(dec_len == plain_len && memcmp(plain, dec, dec_len) == 0);
+            free(dec);
+            cjose_jwe_release(jwe);
+
+            // it decrypts a chunk at a time, as does a JWE encrypted as a
+            // whole, unless it has been tampered with
+            for (int t = 0; t < 3; ++t)
+            {
+                if (1 == t)
+                {
+                    jwe = cjose_jwe_encrypt(
+                            jwk, hdr, (const uint8_t *)plain, plain_len, &err);
+                    ck_assert(NULL != jwe);
+                    char *whole = cjose_jwe_export(jwe, &err);
+                    ck_assert(NULL != whole);
+                    cjose_jwe_release(jwe);
+                    free(cser);
+                    cser = whole;
+                    cser_len = strlen(cser);
+                }
+                if (2 == t)
+                {
+                    // change the first character of the tag
+                    char *dot = strrchr(cser, '.');
+                    dot[1] = ('A' == dot[1]) ? 'Q' : 'A';
+                }
+
+                stream = cjose_jwe_decrypt_init(jwk, &err);
+                ck_assert(NULL != stream);
+                char *dat = NULL;
+                size_t dat_len = 0;
+                const uint8_t *piece = NULL;
+                size_t piece_len = 0;
+                for (size_t idx = 0; idx < cser_len; idx += chunk)
+                {
+                    size_t len = 
+                            (cser_len - idx < chunk) ? cser_len - idx : chunk;
+                    ck_assert_msg(cjose_jwe_decrypt_update(stream, cser + idx, 
+                            len, &piece, &piece_len, &err),
+                            "cjose_jwe_decrypt_update failed: "
+                            "%s, file: %s, function: %s, line: %ld", 
+                            err.message, err.file, err.function, err.line);
+                    _stream_append(&dat, &dat_len, piece, piece_len);
+                }
+                if (2 == t)
+                {
+                    ck_assert(!cjose_jwe_decrypt_final(stream, &err));
+                    ck_assert(CJOSE_ERR_CRYPTO == err.code);
+                }
+                else
+                {
+                    ck_assert_msg(cjose_jwe_decrypt_final(stream, &err),
+                            "cjose_jwe_decrypt_final failed: "
+                            "%s, file: %s, function: %s, line: %ld", 
+                            err.message, err.file, err.function, err.line);
+                    ck_assert(dat_len == plain_len);
+                    ck_assert(0 == plain_len || 
+                            memcmp(plain, dat, dat_len) == 0);
+                }
+                cjose_jwe_stream_release(stream);
+                free(dat);
+            }
+
+            free(cser);
+        }
+
+        cjose_header_release(hdr);
+        cjose_jwk_release(jwk);
+    }
+
+    // a truncated serialization does not decrypt
+    cjose_jwk_t *jwk = cjose_jwk_import(JWK_OCT, strlen(JWK_OCT), &err);
+    cjose_header_t *hdr = cjose_header_new(&err);
+    ck_assert(cjose_header_set(hdr, CJOSE_HDR_ALG, CJOSE_HDR_ALG_DIR, &err));
+    ck_assert(cjose_header_set(
+            hdr, CJOSE_HDR_ENC, CJOSE_HDR_ENC_A256GCM, &err));
+    cjose_jwe_t *jwe = cjose_jwe_encrypt(
+            jwk, hdr, (const uint8_t *)big, big_len, &err);
+    char *cser = cjose_jwe_export(jwe, &err);
+    ck_assert(NULL != cser);
+    cjose_jwe_stream_t *stream = cjose_jwe_decrypt_init(jwk, &err);
+    const uint8_t *piece = NULL;
+    size_t piece_len = 0;
+    ck_assert(cjose_jwe_decrypt_update(
+            stream, cser, strrchr(cser, '.') - cser, &piece, &piece_len, &err));
+    ck_assert(!cjose_jwe_decrypt_final(stream, &err));
+    ck_assert(CJOSE_ERR_INVALID_ARG == err.code);
+    cjose_jwe_stream_release(stream);
+
+    free(cser);
+    cjose_jwe_release(jwe);
+    cjose_header_release(hdr);
+    cjose_jwk_release(jwk);
+    free(big);
+}
+END_TEST
+
+
 START_TEST(test_cjose_jwe_encrypt_with_bad_header)
 {
     cjose_header_t *hdr = NULL;
@@ -443,6 +837,18 @@ START_TEST(test_cjose_jwe_import_export_compare)
             strncmp(JWE_RSA, cser, strlen(JWE_RSA)) == 0,
             "export of imported JWE doesn't match original");
 
+    // export into a buffer, after asking for its size
+    size_t len = 0;
+    ck_assert(cjose_jwe_export_into(jwe, NULL, 0, &len, &err));
+    ck_assert(len == strlen(JWE_RSA));
+    char *buf = (char *)malloc(len);
+    ck_assert(!cjose_jwe_export_into(jwe, buf, len - 1, &len, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+    ck_assert(len == strlen(JWE_RSA));
+    ck_assert(cjose_jwe_export_into(jwe, buf, len, &len, &err));
+    ck_assert(memcmp(JWE_RSA, buf, len) == 0);
+    free(buf);
+
     cjose_jwk_release(jwk);
     cjose_jwe_release(jwe);
     free(cser);
@@ -450,6 +856,110 @@ START_TEST(test_cjose_jwe_import_export_compare)
 END_TEST
 
 
+START_TEST(test_cjose_jwe_import_consume)
+{
+    cjose_err err;
+
+    // import the common key
+    cjose_jwk_t *jwk = cjose_jwk_import(JWK_RSA, strlen(JWK_RSA), &err);
+    ck_assert_msg(NULL != jwk, "cjose_jwk_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    // import a writable copy of the jwe created with the common key
+    char *buf = strdup(JWE_RSA);
+    cjose_jwe_t *jwe = cjose_jwe_import_consume(buf, strlen(buf), &err);
+    ck_assert_msg(NULL != jwe, "cjose_jwe_import_consume failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    // re-export the jwe object, re-encoding the parts decoded in place
+    char *cser = cjose_jwe_export(jwe, &err);
+    ck_assert_msg(NULL != cser,
+            "re-export of imported JWE failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_str_eq(JWE_RSA, cser);
+
+    // decrypt the imported jwe
+    size_t plain_len = 0;
+    uint8_t *plain = cjose_jwe_decrypt(jwe, jwk, &plain_len, &err);
+    ck_assert_msg(NULL != plain, "cjose_jwe_decrypt failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_msg(
+            plain_len == strlen(PLAINTEXT) &&
+            strncmp(PLAINTEXT, plain, plain_len) == 0,
+            "decrypted plaintext does not match the original");
+
+    cjose_jwk_release(jwk);
+    cjose_jwe_release(jwe);
+    free(plain);
+    free(cser);
+    free(buf);
+}
+END_TEST
+
+
+START_TEST(test_cjose_jwe_import_view)
+{
+    cjose_err err;
+
+    // import the common key
+    cjose_jwk_t *jwk = cjose_jwk_import(JWK_RSA, strlen(JWK_RSA), &err);
+    ck_assert_msg(NULL != jwk, "cjose_jwk_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    // import the jwe created with the common key, followed by bytes that are
+    // not part of it
+    size_t buf_len = strlen(JWE_RSA);
+    char *buf = (char *)malloc(buf_len + 2);
+    memcpy(buf, JWE_RSA, buf_len);
+    memcpy(buf + buf_len, ".x", 2);
+    cjose_jwe_t *jwe = cjose_jwe_import_view(buf, buf_len, &err);
+    ck_assert_msg(NULL != jwe, "cjose_jwe_import_view failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    // the encoded parts are the caller's, and the decoded parts share a slab
+    for (int i = 0; i < 5; ++i)
+    {
+        ck_assert(jwe->part[i].b64u >= buf && 
+                jwe->part[i].b64u + jwe->part[i].b64u_len <= buf + buf_len);
+        ck_assert(jwe->part[i].raw >= jwe->slab && 
+                jwe->part[i].raw + jwe->part[i].raw_len <= 
+                jwe->slab + jwe->slab_cap);
+    }
+
+    // re-export the jwe object from the caller's buffer
+    char *cser = cjose_jwe_export(jwe, &err);
+    ck_assert_msg(NULL != cser,
+            "re-export of imported JWE failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_str_eq(JWE_RSA, cser);
+
+    // decrypt the imported jwe, leaving the caller's buffer as it was
+    size_t plain_len = 0;
+    uint8_t *plain = cjose_jwe_decrypt(jwe, jwk, &plain_len, &err);
+    ck_assert_msg(NULL != plain, "cjose_jwe_decrypt failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_msg(
+            plain_len == strlen(PLAINTEXT) &&
+            strncmp(PLAINTEXT, plain, plain_len) == 0,
+            "decrypted plaintext does not match the original");
+    ck_assert(memcmp(JWE_RSA, buf, buf_len) == 0);
+
+    cjose_jwk_release(jwk);
+    cjose_jwe_release(jwe);
+    free(plain);
+    free(cser);
+    free(buf);
+}
+END_TEST
+
 START_TEST(test_cjose_jwe_import_invalid_serialization)
 {
     cjose_err err;
@@ -477,6 +987,12 @@ START_TEST(test_cjose_jwe_import_invalid_serialization)
                 NULL == jwe, "cjose_jwe_import of bad JWE succeeded (%d)", i);
         ck_assert_msg(err.code == CJOSE_ERR_INVALID_ARG, 
                 "cjose_jwe_import returned wrong err.code");
+
+        jwe = cjose_jwe_import_view(JWE_BAD[i], strlen(JWE_BAD[i]), &err);
+        ck_assert_msg(NULL == jwe, 
+                "cjose_jwe_import_view of bad JWE succeeded (%d)", i);
+        ck_assert_msg(err.code == CJOSE_ERR_INVALID_ARG, 
+                "cjose_jwe_import_view returned wrong err.code");
     }
 }
 END_TEST
@@ -561,10 +1077,16 @@ Suite *cjose_jwe_suite()
     tcase_add_test(tc_jwe, test_cjose_jwe_self_encrypt_self_decrypt_empty);
     tcase_add_test(tc_jwe, test_cjose_jwe_self_encrypt_self_decrypt_large);
     tcase_add_test(tc_jwe, test_cjose_jwe_self_encrypt_self_decrypt_many);
+    tcase_add_test(tc_jwe, test_cjose_jwe_encrypt_into);
+    tcase_add_test(tc_jwe, test_cjose_jwe_dir_keyed_context);
+    tcase_add_test(tc_jwe, test_cjose_jwe_decrypt_into);
+    tcase_add_test(tc_jwe, test_cjose_jwe_stream);
     tcase_add_test(tc_jwe, test_cjose_jwe_encrypt_with_bad_header);
     tcase_add_test(tc_jwe, test_cjose_jwe_encrypt_with_bad_key);
     tcase_add_test(tc_jwe, test_cjose_jwe_encrypt_with_bad_content);
     tcase_add_test(tc_jwe, test_cjose_jwe_import_export_compare);
+    tcase_add_test(tc_jwe, test_cjose_jwe_import_consume);
+    tcase_add_test(tc_jwe, test_cjose_jwe_import_view);
     tcase_add_test(tc_jwe, test_cjose_jwe_import_invalid_serialization);
     tcase_add_test(tc_jwe, test_cjose_jwe_decrypt_bad_params);
     suite_add_tcase(suite, tc_jwe);
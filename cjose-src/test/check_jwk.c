@@ -6,7 +6,9 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <openssl/ec.h>
 #include <openssl/evp.h>
+#include <openssl/rsa.h>
 #include <check.h>
 #include <cjose/jwk.h>
 #include <cjose/base64.h>
@@ -184,6 +186,67 @@ START_TEST (test_cjose_jwk_create_RSA_random)
 }
 END_TEST
 
+START_TEST (test_cjose_jwk_RSA_warmup)
+{
+    cjose_err err;
+    uint8_t         msg[32];
+    uint8_t         sig[256];
+    uint8_t         out[256];
+
+    ck_assert(!cjose_jwk_get_RSA_warmup());
+    cjose_jwk_set_RSA_warmup(true);
+    ck_assert(cjose_jwk_get_RSA_warmup());
+
+    // a warmed up key, created and then imported, works as any other
+    cjose_jwk_t *jwk = cjose_jwk_create_RSA_random(2048, NULL, 0, &err);
+    ck_assert(NULL != jwk);
+    char *json = cjose_jwk_to_json(jwk, true, &err);
+    ck_assert(NULL != json);
+    cjose_jwk_t *imported = cjose_jwk_import(json, strlen(json), &err);
+    ck_assert(NULL != imported);
+    ck_assert(2048 == imported->keysize);
+
+    // both have their Montgomery contexts and blinding set up before any use
+    for (int i = 0; i < 2; ++i)
+    {
+        RSA *rsa = (RSA *)(0 == i ? jwk : imported)->keydata;
+        ck_assert(NULL != rsa->_method_mod_n);
+        ck_assert(NULL != rsa->_method_mod_p);
+        ck_assert(NULL != rsa->_method_mod_q);
+        ck_assert(NULL != rsa->blinding);
+        ck_assert(NULL != rsa->mt_blinding);
+    }
+
+    // a key imported with warm-up off leaves them to its first use
+    cjose_jwk_set_RSA_warmup(false);
+    cjose_jwk_t *cold = cjose_jwk_import(json, strlen(json), &err);
+    ck_assert(NULL != cold);
+    RSA *cold_rsa = (RSA *)cold->keydata;
+    ck_assert(NULL == cold_rsa->_method_mod_n);
+    ck_assert(NULL == cold_rsa->_method_mod_p);
+    ck_assert(NULL == cold_rsa->_method_mod_q);
+    ck_assert(NULL == cold_rsa->blinding);
+    ck_assert(NULL == cold_rsa->mt_blinding);
+    cjose_jwk_release(cold);
+    free(json);
+
+    memset(msg, 0x5a, sizeof(msg));
+    for (int i = 0; i < 2; ++i)
+    {
+        RSA *rsa = (RSA *)(0 == i ? jwk : imported)->keydata;
+        int len = RSA_private_encrypt(
+                sizeof(msg), msg, sig, rsa, RSA_PKCS1_PADDING);
+        ck_assert(256 == len);
+        ck_assert(sizeof(msg) == RSA_public_decrypt(
+                len, sig, out, rsa, RSA_PKCS1_PADDING));
+        ck_assert(0 == memcmp(msg, out, sizeof(msg)));
+    }
+
+    cjose_jwk_release(imported);
+    cjose_jwk_release(jwk);
+}
+END_TEST
+
 const char * EC_P256_d = "RSSjcBQW_EBxm1gzYhejCdWtj3Id_GuwldwEgSuKCEM";
 const char * EC_P256_x = "ii8jCnvs4FLc0rteSWxanup22pNDhzizmlGN-bfTcFk";
 const char * EC_P256_y = "KbkZ7r_DQ-t67pnxPnFDHObTLBqn44BSjcqn0STUkaM";
@@ -269,6 +332,10 @@ START_TEST (test_cjose_jwk_create_EC_P384_random)
     ck_assert(384 == jwk->keysize);
     ck_assert(NULL != jwk->keydata);
 
+    // a generated key signs, so its generator multiples are precomputed
+    EC_KEY *ec = ((ec_keydata *)jwk->keydata)->key;
+    ck_assert(EC_GROUP_have_precompute_mult(EC_KEY_get0_group(ec)));
+
     // cleanup
     cjose_jwk_release(jwk);
 }
@@ -1065,6 +1132,7 @@ Suite *cjose_jwk_suite()
     tcase_add_test(tc_jwk, test_cjose_jwk_name_for_kty);
     tcase_add_test(tc_jwk, test_cjose_jwk_create_RSA_spec);
     tcase_add_test(tc_jwk, test_cjose_jwk_create_RSA_random);
+    tcase_add_test(tc_jwk, test_cjose_jwk_RSA_warmup);
     tcase_add_test(tc_jwk, test_cjose_jwk_create_EC_P256_spec);
     tcase_add_test(tc_jwk, test_cjose_jwk_create_EC_P256_random);
     tcase_add_test(tc_jwk, test_cjose_jwk_create_EC_P384_spec);
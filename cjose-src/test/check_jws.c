@@ -12,7 +12,9 @@
 #include <jansson.h>
 #include "include/jwk_int.h"
 #include "include/jws_int.h"
+#include "include/cache_int.h"
 #include <openssl/rand.h>
+#include <openssl/hmac.h>
 
 // a JWK to be re-used for unit tests
 static const char *JWK_COMMON = 
@@ -148,6 +150,963 @@ START_TEST(test_cjose_jws_self_sign_self_verify_many)
 END_TEST
 
 
+START_TEST(test_cjose_jws_self_sign_self_verify_blocks)
+{
+    cjose_err err;
+
+    // payloads around the blocks the signing input is hashed in, and one
+    // large enough to be encoded on several threads
+    const size_t lens[] = { 
+        CJOSE_JWS_DIG_BLOCK_LEN - 1, 
+        CJOSE_JWS_DIG_BLOCK_LEN, 
+        CJOSE_JWS_DIG_BLOCK_LEN + 1, 
+        5 * CJOSE_JWS_DIG_BLOCK_LEN + 2,
+        CJOSE_BASE64_PARALLEL_MIN + 1
+    };
+    for (int i = 0; i < sizeof(lens) / sizeof(lens[0]); ++i)
+    {
+        char *plain = (char *)malloc(lens[i] + 1);
+        for (size_t idx = 0; idx < lens[i]; ++idx)
+        {
+            plain[idx] = 'a' + (idx * 7) % 26;
+        }
+        plain[lens[i]] = 0;
+
+        cjose_base64_set_parallel_threads(1);
+        _self_sign_self_verify(plain, CJOSE_HDR_ALG_PS256, &err);
+        cjose_base64_set_parallel_threads(0);
+        _self_sign_self_verify(plain, CJOSE_HDR_ALG_PS256, &err);
+        free(plain);
+    }
+    cjose_base64_set_parallel_threads(1);
+}
+END_TEST
+
+
+START_TEST(test_cjose_jws_hmac_rfc7515)
+{
+    cjose_err err;
+
+    // the HS256 example of RFC 7515, appendix A.1
+    static const char *JWK_HS256 = 
+        "{ \"kty\": \"oct\", "
+        "\"k\": \"AyM1SysPpbyDfgZld3umj1qzKObwVMkoqQ-EstJQLr_T-1qS0gZH75aKtMN3Yj0iPS4hcgUuTwjAzZr1Z9CAow\" }";
+    static const char *JWS_HS256 = 
+        "eyJ0eXAiOiJKV1QiLA0KICJhbGciOiJIUzI1NiJ9."
+        "eyJpc3MiOiJqb2UiLA0KICJleHAiOjEzMDA4MTkzODAsDQogImh0dHA6Ly9leGFtcGxlLmNvbS9pc19yb290Ijp0cnVlfQ."
+        "dBjftJeZ4CVP-mB92K27uhbUJU1p1r_wW1gFWFOEjXk";
+    static const char *PLAIN_HS256 = 
+        "{\"iss\":\"joe\",\r\n \"exp\":1300819380,\r\n "
+        "\"http://example.com/is_root\":true}";
+
+    cjose_jwk_t *jwk = cjose_jwk_import(JWK_HS256, strlen(JWK_HS256), &err);
+    ck_assert_msg(NULL != jwk, "cjose_jwk_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    cjose_jws_t *jws = cjose_jws_import(JWS_HS256, strlen(JWS_HS256), &err);
+    ck_assert_msg(NULL != jws, "cjose_jws_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    ck_assert_msg(cjose_jws_verify(jws, jwk, &err), "cjose_jws_verify failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    uint8_t *plaintext = NULL;
+    size_t plaintext_len = 0;
+    ck_assert_msg(
+            cjose_jws_get_plaintext(jws, &plaintext, &plaintext_len, &err),
+            "cjose_jws_get_plaintext failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_msg(
+            plaintext_len == strlen(PLAIN_HS256) &&
+            strncmp(PLAIN_HS256, plaintext, plaintext_len) == 0,
+            "verified plaintext from JWS doesn't match the original");
+
+    cjose_jws_release(jws);
+    cjose_jwk_release(jwk);
+}
+END_TEST
+
+
+START_TEST(test_cjose_jws_hmac_self_sign_self_verify)
+{
+    cjose_err err;
+
+    const char *algs[] = { 
+        CJOSE_HDR_ALG_HS256, CJOSE_HDR_ALG_HS384, CJOSE_HDR_ALG_HS512 
+    };
+    const EVP_MD *mds[] = { EVP_sha256(), EVP_sha384(), EVP_sha512() };
+
+    // a key no longer than any block, and one longer than every block
+    uint8_t key[200];
+    const size_t key_lens[] = { 64, sizeof(key) };
+    for (size_t i = 0; i < sizeof(key); ++i)
+    {
+        key[i] = (uint8_t)(i * 13);
+    }
+
+    // one payload within a hashing block, and one spanning several
+    size_t big_len = 2 * CJOSE_JWS_DIG_BLOCK_LEN + 5;
+    char *big = (char *)malloc(big_len + 1);
+    memset(big, 'x', big_len);
+    big[big_len] = 0;
+    const char *plains[] = { PLAIN_COMMON, big };
+
+    for (int a = 0; a < 3; ++a)
+    for (int k = 0; k < 2; ++k)
+    for (int p = 0; p < 2; ++p)
+    {
+        cjose_jwk_t *jwk = cjose_jwk_create_oct_spec(key, key_lens[k], &err);
+        ck_assert_msg(NULL != jwk, "cjose_jwk_create_oct_spec failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+
+        cjose_header_t *hdr = cjose_header_new(&err);
+        ck_assert_msg(
+                cjose_header_set(hdr, CJOSE_HDR_ALG, algs[a], &err),
+                "cjose_header_set failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+
+        cjose_jws_t *jws1 = cjose_jws_sign(
+                jwk, hdr, plains[p], strlen(plains[p]), &err);
+        ck_assert_msg(NULL != jws1, "cjose_jws_sign failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+
+        // the signature is the HMAC of the signing input
+        uint8_t mac[EVP_MAX_MD_SIZE];
+        unsigned int mac_len = 0;
+        size_t input_len = jws1->hdr_b64u_len + 1 + jws1->dat_b64u_len;
+        char *input = (char *)malloc(input_len);
+        memcpy(input, jws1->hdr_b64u, jws1->hdr_b64u_len);
+        input[jws1->hdr_b64u_len] = '.';
+        memcpy(input + jws1->hdr_b64u_len + 1, 
+                jws1->dat_b64u, jws1->dat_b64u_len);
+        HMAC(mds[a], key, key_lens[k], 
+                (const uint8_t *)input, input_len, mac, &mac_len);
+        free(input);
+        ck_assert(jws1->sig_len == mac_len && 
+                memcmp(jws1->sig, mac, mac_len) == 0);
+
+        // round trip and verify with the same key
+        const char *compact = NULL;
+        ck_assert(cjose_jws_export(jws1, &compact, &err));
+        cjose_jws_t *jws2 = cjose_jws_import(compact, strlen(compact), &err);
+        ck_assert_msg(NULL != jws2, "cjose_jws_import failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+        ck_assert_msg(cjose_jws_verify(jws2, jwk, &err), 
+                "cjose_jws_verify failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+        cjose_jws_release(jws2);
+
+        // a changed signature does not verify (verify releases the JWS
+        // on failure)
+        char *bad = strdup(compact);
+        char *last = bad + strlen(bad) - 2;
+        *last = ('A' == *last) ? 'B' : 'A';
+        jws2 = cjose_jws_import(bad, strlen(bad), &err);
+        ck_assert_msg(NULL != jws2, "cjose_jws_import failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+        ck_assert_msg(!cjose_jws_verify(jws2, jwk, &err), 
+                "cjose_jws_verify succeeded with a changed signature");
+        free(bad);
+
+        // nor does the original with another key
+        cjose_jwk_t *other = cjose_jwk_create_oct_random(512, &err);
+        ck_assert(NULL != other);
+        jws2 = cjose_jws_import(compact, strlen(compact), &err);
+        ck_assert(NULL != jws2);
+        ck_assert_msg(!cjose_jws_verify(jws2, other, &err), 
+                "cjose_jws_verify succeeded with the wrong key");
+        cjose_jwk_release(other);
+
+        cjose_jws_release(jws1);
+        cjose_header_release(hdr);
+        cjose_jwk_release(jwk);
+    }
+
+    // a key shorter than the hash output neither signs nor verifies
+    for (int a = 0; a < 3; ++a)
+    {
+        cjose_jwk_t *jwk = cjose_jwk_create_oct_spec(key, 64, &err);
+        cjose_jwk_t *short_jwk = cjose_jwk_create_oct_spec(
+                key, EVP_MD_size(mds[a]) - 1, &err);
+        ck_assert(NULL != jwk && NULL != short_jwk);
+        cjose_header_t *hdr = cjose_header_new(&err);
+        ck_assert(cjose_header_set(hdr, CJOSE_HDR_ALG, algs[a], &err));
+
+        ck_assert(NULL == cjose_jws_sign(short_jwk, hdr, 
+                PLAIN_COMMON, strlen(PLAIN_COMMON), &err));
+        ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+
+        cjose_jws_t *jws = cjose_jws_sign(
+                jwk, hdr, PLAIN_COMMON, strlen(PLAIN_COMMON), &err);
+        ck_assert(NULL != jws);
+        ck_assert(!cjose_jws_verify(jws, short_jwk, &err));
+        ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+
+        cjose_header_release(hdr);
+        cjose_jwk_release(short_jwk);
+        cjose_jwk_release(jwk);
+    }
+    free(big);
+}
+END_TEST
+
+
+START_TEST(test_cjose_jws_ecdsa_rfc7515)
+{
+    cjose_err err;
+
+    // the ES256 example of RFC 7515, appendix A.3 (public key only)
+    static const char *JWK_ES256 = 
+        "{ \"kty\": \"EC\", \"crv\": \"P-256\", "
+        "\"x\": \"f83OJ3D2xF1Bg8vub9tLe1gHMzV76e8Tus9uPHvRVEU\", "
+        "\"y\": \"x_FEzRu9m36HLN_tue659LNpXW6pCyStikYjKIWI5a0\" }";
+    static const char *JWS_ES256 = 
+        "eyJhbGciOiJFUzI1NiJ9."
+        "eyJpc3MiOiJqb2UiLA0KICJleHAiOjEzMDA4MTkzODAsDQogImh0dHA6Ly9leGFtcGxlLmNvbS9pc19yb290Ijp0cnVlfQ."
+        "DtEhU3ljbEg8L38VWAfUAqOyKAM6-Xx-F4GawxaepmXFCgfTjDxw5djxLa8ISlSApmWQxfKTUJqPP3-Kg6NU1Q";
+
+    cjose_jwk_t *jwk = cjose_jwk_import(JWK_ES256, strlen(JWK_ES256), &err);
+    ck_assert_msg(NULL != jwk, "cjose_jwk_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    cjose_jws_t *jws = cjose_jws_import(JWS_ES256, strlen(JWS_ES256), &err);
+    ck_assert_msg(NULL != jws, "cjose_jws_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    ck_assert_msg(cjose_jws_verify(jws, jwk, &err), "cjose_jws_verify failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    cjose_jws_release(jws);
+    cjose_jwk_release(jwk);
+}
+END_TEST
+
+
+START_TEST(test_cjose_jws_ecdsa_self_sign_self_verify)
+{
+    cjose_err err;
+
+    const char *algs[] = { 
+        CJOSE_HDR_ALG_ES256, CJOSE_HDR_ALG_ES384, CJOSE_HDR_ALG_ES512 
+    };
+    const cjose_jwk_ec_curve crvs[] = { 
+        CJOSE_JWK_EC_P_256, CJOSE_JWK_EC_P_384, CJOSE_JWK_EC_P_521 
+    };
+    const size_t sig_lens[] = { 64, 96, 132 };
+
+    for (int i = 0; i < 3; ++i)
+    {
+        // create a signing key, and import its public half for verifying
+        cjose_jwk_t *jwk = cjose_jwk_create_EC_random(crvs[i], &err);
+        ck_assert_msg(NULL != jwk, "cjose_jwk_create_EC_random failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+        char *pub_json = cjose_jwk_to_json(jwk, false, &err);
+        ck_assert(NULL != pub_json);
+        cjose_jwk_t *pub = cjose_jwk_import(pub_json, strlen(pub_json), &err);
+        ck_assert_msg(NULL != pub, "cjose_jwk_import failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+        free(pub_json);
+
+        cjose_header_t *hdr = cjose_header_new(&err);
+        ck_assert(cjose_header_set(hdr, CJOSE_HDR_ALG, algs[i], &err));
+
+        cjose_jws_t *jws1 = cjose_jws_sign(
+                jwk, hdr, PLAIN_COMMON, strlen(PLAIN_COMMON), &err);
+        ck_assert_msg(NULL != jws1, "cjose_jws_sign failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+
+        // the signature is R || S, not DER
+        ck_assert_msg(jws1->sig_len == sig_lens[i], 
+                "wrong signature length, expected: %lu, found: %lu",
+                sig_lens[i], jws1->sig_len);
+
+        const char *compact = NULL;
+        ck_assert(cjose_jws_export(jws1, &compact, &err));
+        cjose_jws_t *jws2 = cjose_jws_import(compact, strlen(compact), &err);
+        ck_assert(NULL != jws2);
+        ck_assert_msg(cjose_jws_verify(jws2, pub, &err), 
+                "cjose_jws_verify failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+        cjose_jws_release(jws2);
+
+        // a changed signature does not verify (verify releases the JWS
+        // on failure)
+        char *bad = strdup(compact);
+        char *last = bad + strlen(bad) - 2;
+        *last = ('A' == *last) ? 'B' : 'A';
+        jws2 = cjose_jws_import(bad, strlen(bad), &err);
+        ck_assert(NULL != jws2);
+        ck_assert_msg(!cjose_jws_verify(jws2, pub, &err), 
+                "cjose_jws_verify succeeded with a changed signature");
+        free(bad);
+
+        // nor does it with a key on another curve
+        cjose_jwk_t *other = cjose_jwk_create_EC_random(crvs[(i + 1) % 3], &err);
+        ck_assert(NULL != other);
+        jws2 = cjose_jws_import(compact, strlen(compact), &err);
+        ck_assert(NULL != jws2);
+        ck_assert_msg(!cjose_jws_verify(jws2, other, &err), 
+                "cjose_jws_verify succeeded with a key on another curve");
+        cjose_jwk_release(other);
+
+        cjose_jws_release(jws1);
+        cjose_header_release(hdr);
+        cjose_jwk_release(pub);
+        cjose_jwk_release(jwk);
+    }
+}
+END_TEST
+
+
+START_TEST(test_cjose_jws_sign_with_template)
+{
+    cjose_err err;
+
+    uint8_t key[32];
+    for (size_t i = 0; i < sizeof(key); ++i)
+    {
+        key[i] = (uint8_t)(i * 7);
+    }
+    cjose_jwk_t *jwk = cjose_jwk_create_oct_spec(key, sizeof(key), &err);
+    ck_assert_msg(NULL != jwk, "cjose_jwk_create_oct_spec failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    cjose_header_t *hdr = cjose_header_new(&err);
+    ck_assert_msg(
+            cjose_header_set(hdr, CJOSE_HDR_ALG, CJOSE_HDR_ALG_HS256, &err),
+            "cjose_header_set failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    cjose_jws_template_t *tmpl = cjose_jws_template_new(hdr, &err);
+    ck_assert_msg(NULL != tmpl, "cjose_jws_template_new failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    // an HMAC is deterministic, so signing with the template gives the same
+    // JWS as signing with the header
+    cjose_jws_t *jws1 = cjose_jws_sign(
+            jwk, hdr, PLAIN_COMMON, strlen(PLAIN_COMMON), &err);
+    ck_assert_msg(NULL != jws1, "cjose_jws_sign failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    const char *compact1 = NULL;
+    ck_assert(cjose_jws_export(jws1, &compact1, &err));
+
+    // the template is unaffected by later changes to the header
+    ck_assert(cjose_header_set(hdr, CJOSE_HDR_ALG, "Cayley-Purser", &err));
+
+    for (int i = 0; i < 2; ++i)
+    {
+        cjose_jws_t *jws2 = cjose_jws_sign_with_template(
+                jwk, tmpl, PLAIN_COMMON, strlen(PLAIN_COMMON), &err);
+        ck_assert_msg(NULL != jws2, "cjose_jws_sign_with_template failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+        const char *compact2 = NULL;
+        ck_assert(cjose_jws_export(jws2, &compact2, &err));
+        ck_assert_str_eq(compact1, compact2);
+
+        // a JWS signed with a template verifies as it is
+        ck_assert_msg(cjose_jws_verify(jws2, jwk, &err), 
+                "cjose_jws_verify failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+        cjose_jws_release(jws2);
+    }
+
+    // a header without a supported alg makes no template
+    ck_assert(NULL == cjose_jws_template_new(hdr, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+    ck_assert(NULL == cjose_jws_template_new(NULL, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+    ck_assert(NULL == cjose_jws_sign_with_template(
+            jwk, NULL, PLAIN_COMMON, strlen(PLAIN_COMMON), &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+
+    cjose_jws_release(jws1);
+    cjose_jws_template_release(tmpl);
+    cjose_header_release(hdr);
+    cjose_jwk_release(jwk);
+}
+END_TEST
+
+
+// appends the pieces of a serialization or payload returned by a stream
+static void _stream_append(
+        char **buf, size_t *buf_len, const void *piece, size_t piece_len)
+{
+    *buf = (char *)realloc(*buf, *buf_len + piece_len + 1);
+    memcpy(*buf + *buf_len, piece, piece_len);
+    *buf_len += piece_len;
+    (*buf)[*buf_len] = 0;
+}
+
+
+START_TEST(test_cjose_jws_sign_into)
+{
+    cjose_err err;
+
+    uint8_t key[32];
+    for (size_t i = 0; i < sizeof(key); ++i)
+    {
+        key[i] = (uint8_t)(i * 5);
+    }
+    cjose_jwk_t *jwk = cjose_jwk_create_oct_spec(key, sizeof(key), &err);
+    ck_assert(NULL != jwk);
+    cjose_header_t *hdr = cjose_header_new(&err);
+    ck_assert(cjose_header_set(hdr, CJOSE_HDR_ALG, CJOSE_HDR_ALG_HS256, &err));
+    cjose_jws_template_t *tmpl = cjose_jws_template_new(hdr, &err);
+    ck_assert(NULL != tmpl);
+
+    // sign payloads of several sizes into one JWS, with and without the
+    // template; an HMAC is deterministic, so each is the JWS cjose_jws_sign
+    // makes
+    size_t plain_len = strlen(PLAIN_COMMON);
+    const size_t lens[] = { plain_len, 10, plain_len, 0, 3 };
+    cjose_jws_t *jws = cjose_jws_new(&err);
+    ck_assert(NULL != jws);
+    char *dat_b64u = NULL;
+    for (size_t i = 0; i < 2 * sizeof(lens) / sizeof(lens[0]); ++i)
+    {
+        size_t len = lens[i / 2];
+        if (0 == i % 2)
+        {
+            ck_assert_msg(cjose_jws_sign_into(
+                    jws, jwk, hdr, (const uint8_t *)PLAIN_COMMON, len, &err),
+                    "cjose_jws_sign_into failed: "
+                    "%s, file: %s, function: %s, line: %ld", 
+                    err.message, err.file, err.function, err.line);
+        }
+        else
+        {
+            ck_assert(cjose_jws_sign_with_template_into(
+                    jws, jwk, tmpl, (const uint8_t *)PLAIN_COMMON, len, &err));
+        }
+
+        // the encoded payload buffer is kept once it is big enough
+        if (0 < i)
+        {
+            ck_assert(dat_b64u == jws->dat_b64u);
+        }
+        dat_b64u = jws->dat_b64u;
+
+        cjose_jws_t *expected = cjose_jws_sign(
+                jwk, hdr, (const uint8_t *)PLAIN_COMMON, len, &err);
+        ck_assert(NULL != expected);
+        const char *ser = NULL, *ser_expected = NULL;
+        ck_assert(cjose_jws_export(jws, &ser, &err));
+        ck_assert(cjose_jws_export(expected, &ser_expected, &err));
+        ck_assert_str_eq(ser_expected, ser);
+        cjose_jws_release(expected);
+
+        ck_assert(cjose_jws_verify(jws, jwk, &err));
+    }
+
+    // a reset JWS keeps its buffers, but has nothing to export
+    ck_assert(cjose_jws_sign_into(
+            jws, jwk, hdr, (const uint8_t *)PLAIN_COMMON, plain_len, &err));
+    cjose_jws_reset(jws);
+    const char *ser = NULL;
+    ck_assert(!cjose_jws_export(jws, &ser, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_STATE);
+    size_t ser_len = 0;
+    ck_assert(!cjose_jws_export_into(jws, NULL, 0, &ser_len, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_STATE);
+
+    // a JWS imported in place lets go of the caller's buffer when reused
+    char *cser = strdup(JWS_COMMON);
+    cjose_jws_t *view = cjose_jws_import_view(cser, strlen(cser), &err);
+    ck_assert(NULL != view);
+    ck_assert(cjose_jws_sign_into(
+            view, jwk, hdr, (const uint8_t *)PLAIN_COMMON, plain_len, &err));
+    ck_assert(cjose_jws_verify(view, jwk, &err));
+    ck_assert_str_eq(cser, JWS_COMMON);
+    free(cser);
+    cjose_jws_reset(view);
+    cjose_jws_release(view);
+
+    ck_assert(!cjose_jws_sign_into(
+            NULL, jwk, hdr, (const uint8_t *)PLAIN_COMMON, 1, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+
+    cjose_jws_release(jws);
+    cjose_jws_template_release(tmpl);
+    cjose_header_release(hdr);
+    cjose_jwk_release(jwk);
+}
+END_TEST
+
+
+START_TEST(test_cjose_jws_stream)
+{
+    cjose_err err;
+
+    uint8_t key[32];
+    for (size_t i = 0; i < sizeof(key); ++i)
+    {
+        key[i] = (uint8_t)(i * 11);
+    }
+    cjose_jwk_t *jwks[] = {
+        cjose_jwk_create_oct_spec(key, sizeof(key), &err),
+        cjose_jwk_import(JWK_COMMON, strlen(JWK_COMMON), &err)
+    };
+    const char *algs[] = { CJOSE_HDR_ALG_HS256, CJOSE_HDR_ALG_PS256 };
+    ck_assert(NULL != jwks[0] && NULL != jwks[1]);
+
+    // payloads of no, a few, and several blocks of octets
+    size_t big_len = 3 * CJOSE_JWS_DIG_BLOCK_LEN + 7;
+    char *big = (char *)malloc(big_len + 1);
+    for (size_t i = 0; i < big_len; ++i)
+    {
+        big[i] = (char)('a' + i % 26);
+    }
+    big[big_len] = 0;
+    const char *plains[] = { "", PLAIN_COMMON, big };
+    const size_t chunks[] = { 1, 7, 4096, 1 << 20 };
+
+    for (int a = 0; a < 2; ++a)
+    for (int p = 0; p < 3; ++p)
+    for (int c = 0; c < 4; ++c)
+    {
+        const char *plain = plains[p];
+        size_t plain_len = strlen(plain);
+        size_t chunk = chunks[c];
+
+        cjose_header_t *hdr = cjose_header_new(&err);
+        ck_assert(cjose_header_set(hdr, CJOSE_HDR_ALG, algs[a], &err));
+
+        // sign the payload a chunk at a time
+        cjose_jws_stream_t *stream = cjose_jws_sign_init(jwks[a], hdr, &err);
+        ck_assert_msg(NULL != stream, "cjose_jws_sign_init failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+        char *cser = NULL;
+        size_t cser_len = 0;
+        const char *ser = NULL;
+        size_t ser_len = 0;
+        for (size_t idx = 0; idx < plain_len; idx += chunk)
+        {
+            size_t len = (plain_len - idx < chunk) ? plain_len - idx : chunk;
+            ck_assert_msg(cjose_jws_sign_update(stream, 
+                    (const uint8_t *)plain + idx, len, &ser, &ser_len, &err),
+                    "cjose_jws_sign_update failed: "
+                    "%s, file: %s, function: %s, line: %ld", 
+                    err.message, err.file, err.function, err.line);
+            _stream_append(&cser, &cser_len, ser, ser_len);
+        }
+        ck_assert_msg(cjose_jws_sign_final(stream, &ser, &ser_len, &err),
+                "cjose_jws_sign_final failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+        _stream_append(&cser, &cser_len, ser, ser_len);
+        ck_assert(!cjose_jws_sign_update(
+                stream, (const uint8_t *)plain, 1, &ser, &ser_len, &err));
+        cjose_jws_stream_release(stream);
+
+        // an HMAC is deterministic, so it is the JWS cjose_jws_sign makes
+        if (0 == a)
+        {
+            cjose_jws_t *jws = cjose_jws_sign(
+                    jwks[a], hdr, plain, plain_len, &err);
+            ck_assert(NULL != jws);
+            const char *compact = NULL;
+            ck_assert(cjose_jws_export(jws, &compact, &err));
+            ck_assert_str_eq(compact, cser);
+            cjose_jws_release(jws);
+        }
+
+        // and it verifies as a whole
+        cjose_jws_t *jws = cjose_jws_import(cser, cser_len, &err);
+        ck_assert(NULL != jws);
+        ck_assert_msg(cjose_jws_verify(jws, jwks[a], &err), 
+                "cjose_jws_verify failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err.message, err.file, err.function, err.line);
+        cjose_jws_release(jws);
+
+        // verify it a chunk at a time, collecting the payload
+        for (int bad = 0; bad < 2; ++bad)
+        {
+            if (bad)
+            {
+                // change the last character of the payload, if any
+                char *dot = strrchr(cser, '.');
+                if ('.' == dot[-1])
+                {
+                    continue;
+                }
+                dot[-1] = ('A' == dot[-1]) ? 'Q' : 'A';
+            }
+
+            stream = cjose_jws_verify_init(jwks[a], &err);
+            ck_assert(NULL != stream);
+            char *dat = NULL;
+            size_t dat_len = 0;
+            const uint8_t *piece = NULL;
+            size_t piece_len = 0;
+            bool ok = true;
+            for (size_t idx = 0; ok && idx < cser_len; idx += chunk)
+            {
+                size_t len = 
+                        (cser_len - idx < chunk) ? cser_len - idx : chunk;
+                ok = cjose_jws_verify_update(stream, cser + idx, len, 
+                        &piece, &piece_len, &err);
+                if (ok)
+                {
+                    _stream_append(&dat, &dat_len, piece, piece_len);
+                }
+            }
+            ck_assert(ok || bad);
+            ok = ok && cjose_jws_verify_final(stream, &err);
+            ck_assert_msg(ok == !bad, "cjose_jws_verify_final: "
+                    "%s, file: %s, function: %s, line: %ld", 
+                    err.message, err.file, err.function, err.line);
+            if (!bad)
+            {
+                ck_assert(dat_len == plain_len);
+                ck_assert(0 == plain_len || 0 == memcmp(dat, plain, plain_len));
+            }
+            free(dat);
+            cjose_jws_stream_release(stream);
+        }
+
+        free(cser);
+        cjose_header_release(hdr);
+    }
+
+    // a serialization with too many parts, or too few, does not verify
+    const char *BAD_SER[] = { "e30.e30.e30.e30", "e30.e30" };
+    for (int i = 0; i < 2; ++i)
+    {
+        cjose_jws_stream_t *stream = cjose_jws_verify_init(jwks[0], &err);
+        const uint8_t *piece = NULL;
+        size_t piece_len = 0;
+        ck_assert(!cjose_jws_verify_update(stream, BAD_SER[i], 
+                strlen(BAD_SER[i]), &piece, &piece_len, &err) || 
+                !cjose_jws_verify_final(stream, &err));
+        ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+        cjose_jws_stream_release(stream);
+    }
+
+    free(big);
+    cjose_jwk_release(jwks[0]);
+    cjose_jwk_release(jwks[1]);
+}
+END_TEST
+
+
+// imports a JWS, supplies its detached payload (if any) and verifies it
+static bool _verify_detached(const char *compact, const cjose_jwk_t *jwk, 
+        const char *plain, cjose_err *err)
+{
+    cjose_jws_t *jws = cjose_jws_import(compact, strlen(compact), err);
+    ck_assert_msg(NULL != jws, "cjose_jws_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err->message, err->file, err->function, err->line);
+    if (NULL != plain)
+    {
+        ck_assert_msg(cjose_jws_set_detached_payload(
+                jws, (const uint8_t *)plain, strlen(plain), err),
+                "cjose_jws_set_detached_payload failed: "
+                "%s, file: %s, function: %s, line: %ld", 
+                err->message, err->file, err->function, err->line);
+    }
+
+    // cjose_jws_verify releases the JWS on failure
+    if (!cjose_jws_verify(jws, jwk, err))
+    {
+        return false;
+    }
+
+    uint8_t *plaintext = NULL;
+    size_t plaintext_len = 0;
+    ck_assert(cjose_jws_get_plaintext(jws, &plaintext, &plaintext_len, err));
+    ck_assert(plaintext_len == strlen(plain) && 
+            memcmp(plaintext, plain, plaintext_len) == 0);
+    cjose_jws_release(jws);
+    return true;
+}
+
+
+START_TEST(test_cjose_jws_unencoded)
+{
+    cjose_err err;
+
+    // the example of RFC 7797, section 4.2 (with the key of RFC 7515, A.1)
+    static const char *JWK_HS256 = 
+        "{ \"kty\": \"oct\", "
+        "\"k\": \"AyM1SysPpbyDfgZld3umj1qzKObwVMkoqQ-EstJQLr_T-1qS0gZH75aKtMN3Yj0iPS4hcgUuTwjAzZr1Z9CAow\" }";
+    static const char *JWS_B64_FALSE = 
+        "eyJhbGciOiJIUzI1NiIsImI2NCI6ZmFsc2UsImNyaXQiOlsiYjY0Il19."
+        "."
+        "A5dxf2s96_n5FLueVuW1Z_vh161FwXZC4YLPff6dmDY";
+    static const char *PLAIN_B64_FALSE = "$.02";
+
+    cjose_jwk_t *jwk = cjose_jwk_import(JWK_HS256, strlen(JWK_HS256), &err);
+    ck_assert_msg(NULL != jwk, "cjose_jwk_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    ck_assert(_verify_detached(JWS_B64_FALSE, jwk, PLAIN_B64_FALSE, &err));
+    ck_assert(!_verify_detached(JWS_B64_FALSE, jwk, "$.03", &err));
+
+    // the payload must be supplied, and cannot be attached
+    ck_assert(!_verify_detached(JWS_B64_FALSE, jwk, NULL, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+    static const char *JWS_ATTACHED = 
+        "eyJhbGciOiJIUzI1NiIsImI2NCI6ZmFsc2UsImNyaXQiOlsiYjY0Il19."
+        "$"
+        ".A5dxf2s96_n5FLueVuW1Z_vh161FwXZC4YLPff6dmDY";
+    ck_assert(NULL == cjose_jws_import(
+            JWS_ATTACHED, strlen(JWS_ATTACHED), &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+
+    // sign a payload unencoded, as a whole and as a stream
+    cjose_header_t *hdr = cjose_header_new(&err);
+    ck_assert(cjose_header_set(hdr, CJOSE_HDR_ALG, CJOSE_HDR_ALG_HS256, &err));
+    ck_assert(cjose_header_set_b64(hdr, false, &err));
+
+    cjose_jws_t *jws = cjose_jws_sign(
+            jwk, hdr, PLAIN_COMMON, strlen(PLAIN_COMMON), &err);
+    ck_assert_msg(NULL != jws, "cjose_jws_sign failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    const char *compact = NULL;
+    ck_assert(cjose_jws_export(jws, &compact, &err));
+    ck_assert(NULL != strstr(compact, ".."));
+    ck_assert(_verify_detached(compact, jwk, PLAIN_COMMON, &err));
+
+    cjose_jws_stream_t *stream = cjose_jws_sign_init(jwk, hdr, &err);
+    ck_assert(NULL != stream);
+    char *cser = NULL;
+    size_t cser_len = 0;
+    const char *ser = NULL;
+    size_t ser_len = 0;
+    for (size_t idx = 0; idx < strlen(PLAIN_COMMON); idx += 5)
+    {
+        ck_assert(cjose_jws_sign_update(stream, 
+                (const uint8_t *)PLAIN_COMMON + idx, 
+                (strlen(PLAIN_COMMON) - idx < 5) ? 
+                        strlen(PLAIN_COMMON) - idx : 5, 
+                &ser, &ser_len, &err));
+        _stream_append(&cser, &cser_len, ser, ser_len);
+    }
+    ck_assert(cjose_jws_sign_final(stream, &ser, &ser_len, &err));
+    _stream_append(&cser, &cser_len, ser, ser_len);
+    cjose_jws_stream_release(stream);
+    ck_assert_str_eq(compact, cser);
+
+    // and verify it as a stream, with and without the detached payload
+    for (int detached = 0; detached < 2; ++detached)
+    {
+        stream = cjose_jws_verify_init(jwk, &err);
+        const uint8_t *piece = NULL;
+        size_t piece_len = 0;
+        ck_assert(cjose_jws_verify_update(
+                stream, cser, cser_len, &piece, &piece_len, &err));
+        ck_assert(0 == piece_len);
+        if (detached)
+        {
+            ck_assert(cjose_jws_verify_update_detached(stream, 
+                    (const uint8_t *)PLAIN_COMMON, 10, &err));
+            ck_assert(cjose_jws_verify_update_detached(stream, 
+                    (const uint8_t *)PLAIN_COMMON + 10, 
+                    strlen(PLAIN_COMMON) - 10, &err));
+        }
+        ck_assert(detached == cjose_jws_verify_final(stream, &err));
+        cjose_jws_stream_release(stream);
+    }
+    free(cser);
+    cjose_jws_release(jws);
+
+    // b64 must be listed as critical
+    json_object_del(hdr, CJOSE_HDR_CRIT);
+    ck_assert(NULL == cjose_jws_sign(
+            jwk, hdr, PLAIN_COMMON, strlen(PLAIN_COMMON), &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+
+    // an encoded payload can be detached too (RFC 7515, appendix F)
+    ck_assert(cjose_header_set_b64(hdr, true, &err));
+    jws = cjose_jws_sign(jwk, hdr, PLAIN_COMMON, strlen(PLAIN_COMMON), &err);
+    ck_assert(NULL != jws);
+    ck_assert(cjose_jws_export(jws, &compact, &err));
+    char *stripped = (char *)malloc(strlen(compact) + 1);
+    const char *dot1 = strchr(compact, '.');
+    const char *dot2 = strrchr(compact, '.');
+    memcpy(stripped, compact, dot1 - compact + 1);
+    strcpy(stripped + (dot1 - compact + 1), dot2);
+    ck_assert(_verify_detached(stripped, jwk, PLAIN_COMMON, &err));
+    ck_assert(!_verify_detached(stripped, jwk, PLAIN_B64_FALSE, &err));
+
+    stream = cjose_jws_verify_init(jwk, &err);
+    const uint8_t *piece = NULL;
+    size_t piece_len = 0;
+    ck_assert(cjose_jws_verify_update(
+            stream, stripped, strlen(stripped), &piece, &piece_len, &err));
+    ck_assert(cjose_jws_verify_update_detached(stream, 
+            (const uint8_t *)PLAIN_COMMON, strlen(PLAIN_COMMON), &err));
+    ck_assert(cjose_jws_verify_final(stream, &err));
+    cjose_jws_stream_release(stream);
+
+    // but an attached payload cannot be replaced
+    cjose_jws_t *jws2 = cjose_jws_import(compact, strlen(compact), &err);
+    ck_assert(!cjose_jws_set_detached_payload(jws2, 
+            (const uint8_t *)PLAIN_COMMON, strlen(PLAIN_COMMON), &err));
+    cjose_jws_release(jws2);
+
+    free(stripped);
+    cjose_jws_release(jws);
+    cjose_header_release(hdr);
+    cjose_jwk_release(jwk);
+}
+END_TEST
+
+
+START_TEST(test_cjose_jws_multi)
+{
+    cjose_err err;
+
+    uint8_t key[32];
+    for (size_t i = 0; i < sizeof(key); ++i)
+    {
+        key[i] = (uint8_t)(i * 7);
+    }
+    const cjose_jwk_t *jwks[] = {
+        cjose_jwk_create_oct_spec(key, sizeof(key), &err),
+        cjose_jwk_create_EC_random(CJOSE_JWK_EC_P_256, &err),
+        cjose_jwk_import(JWK_COMMON, strlen(JWK_COMMON), &err)
+    };
+    const char *algs[] = { 
+        CJOSE_HDR_ALG_HS256, CJOSE_HDR_ALG_ES256, CJOSE_HDR_ALG_PS256 
+    };
+    const char *kids[] = { "a", "b", NULL };
+    cjose_header_t *hdrs[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        ck_assert(NULL != jwks[i]);
+        hdrs[i] = cjose_header_new(&err);
+        ck_assert(cjose_header_set(hdrs[i], CJOSE_HDR_ALG, algs[i], &err));
+        if (NULL != kids[i])
+        {
+            ck_assert(cjose_header_set(hdrs[i], CJOSE_HDR_KID, kids[i], &err));
+        }
+    }
+
+    // sign with each key at once, on the calling thread unless asked
+    // otherwise
+    ck_assert(1 == cjose_jws_get_sign_threads());
+    cjose_jws_set_sign_threads(0);
+    cjose_jws_multi_t *multi = cjose_jws_multi_sign(
+            jwks, hdrs, 3, (const uint8_t *)PLAIN_COMMON, 
+            strlen(PLAIN_COMMON), &err);
+    cjose_jws_set_sign_threads(1);
+    ck_assert_msg(NULL != multi, "cjose_jws_multi_sign failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    const char *ser = NULL;
+    ck_assert(!cjose_jws_multi_export(multi, true, &ser, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+    ck_assert(cjose_jws_multi_export(multi, false, &ser, &err));
+
+    // each signature verifies with its own key, picked out by kid
+    cjose_jws_multi_t *signed_multi = multi;
+    multi = cjose_jws_multi_import(ser, strlen(ser), &err);
+    ck_assert_msg(NULL != multi, "cjose_jws_multi_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    cjose_jws_multi_release(signed_multi);
+    ck_assert(cjose_jws_multi_verify(multi, jwks[0], "a", &err));
+    ck_assert(cjose_jws_multi_verify(multi, jwks[1], "b", &err));
+    ck_assert(cjose_jws_multi_verify(multi, jwks[2], NULL, &err));
+    ck_assert(!cjose_jws_multi_verify(multi, jwks[0], "b", &err));
+    ck_assert(!cjose_jws_multi_verify(multi, jwks[0], "c", &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+    uint8_t *plain = NULL;
+    size_t plain_len = 0;
+    ck_assert(cjose_jws_multi_get_plaintext(multi, &plain, &plain_len, &err));
+    ck_assert(plain_len == strlen(PLAIN_COMMON));
+    ck_assert(memcmp(plain, PLAIN_COMMON, plain_len) == 0);
+    cjose_jws_multi_release(multi);
+
+    // a single signature may be flattened, and carry its kid unprotected
+    static const char *JWS_FLAT_FMT = 
+        "{\"payload\":\"%s\",\"protected\":\"%s\","
+        "\"header\":{\"kid\":\"k\"},\"signature\":\"%s\"}";
+    cjose_header_t *hdr = cjose_header_new(&err);
+    ck_assert(cjose_header_set(hdr, CJOSE_HDR_ALG, CJOSE_HDR_ALG_HS256, &err));
+    cjose_jws_t *jws = cjose_jws_sign(
+            jwks[0], hdr, (const uint8_t *)PLAIN_COMMON, 
+            strlen(PLAIN_COMMON), &err);
+    ck_assert(NULL != jws);
+    cjose_header_release(hdr);
+    const char *cser = NULL;
+    ck_assert(cjose_jws_export(jws, &cser, &err));
+    char *parts = strdup(cser);
+    char *dat = strchr(parts, '.');
+    *dat++ = 0;
+    char *sig = strchr(dat, '.');
+    *sig++ = 0;
+    char flat[1024];
+    snprintf(flat, sizeof(flat), JWS_FLAT_FMT, dat, parts, sig);
+    multi = cjose_jws_multi_import(flat, strlen(flat), &err);
+    ck_assert(NULL != multi);
+    ck_assert(!cjose_jws_multi_verify(multi, jwks[0], "a", &err));
+    ck_assert(cjose_jws_multi_verify(multi, jwks[0], "k", &err));
+    ck_assert(cjose_jws_multi_export(multi, true, &ser, &err));
+    ck_assert(strstr(ser, "\"signatures\"") == NULL);
+    cjose_jws_multi_release(multi);
+
+    // and a tampered signature does not verify
+    sig[0] = ('A' == sig[0]) ? 'B' : 'A';
+    snprintf(flat, sizeof(flat), JWS_FLAT_FMT, dat, parts, sig);
+    multi = cjose_jws_multi_import(flat, strlen(flat), &err);
+    ck_assert(NULL != multi);
+    ck_assert(!cjose_jws_multi_verify(multi, jwks[0], NULL, &err));
+    cjose_jws_multi_release(multi);
+    free(parts);
+    cjose_jws_release(jws);
+
+    // nor does a serialization missing its parts import
+    static const char *BAD[] = {
+        "{}",
+        "{\"payload\":\"e30\",\"signatures\":[]}",
+        "{\"payload\":\"e30\",\"signatures\":[{\"signature\":\"e30\"}]}",
+        "{\"payload\":\"e30\",\"protected\":\"e30\"}",
+        "[1]"
+    };
+    for (size_t i = 0; i < sizeof(BAD) / sizeof(BAD[0]); ++i)
+    {
+        ck_assert(NULL == cjose_jws_multi_import(BAD[i], strlen(BAD[i]), &err));
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        cjose_header_release(hdrs[i]);
+        cjose_jwk_release((cjose_jwk_t *)jwks[i]);
+    }
+}
+END_TEST
+
+
 START_TEST(test_cjose_jws_sign_with_bad_header)
 {
     cjose_err err;
@@ -207,7 +1166,7 @@ START_TEST(test_cjose_jws_sign_with_bad_key)
         "\"n\": \"0a5nKJLjaB1xdebYWfhvlhYhgfzkw49HAUIjyvb6fNPKhwlBQMoAS5jM3kI17_OMGrHxL7ZP00OE-24__VWDCAhOQsSvlgCvw2XOOCtSWWLpb03dTrCMFeemqS4S9jrKd3NbUk3UJ2dVb_EIbQEC_BVjZStr_HcCrKsj4AluaQUn09H7TuK0yZFBzZMhJ1J8Yi3nAPkxzdGah0XuWhLObMAvANSVmHzRXwnTDw9Dh_bJ4G1xd1DE7W94uoUlcSDx59aSdzTpQzJh1l3lXc6JRUrXTESYgHpMv0O1n0gbIxX8X1ityBlMiccDjfZIKLnwz6hQObvRtRIpxEdq4SYS-w\", "
         "\"d\": \"B1vTivz8th6yaKzdUusBH4dPTbyOWr6gg07K6siYKeFU7kBI5fkw4XZPWk2AjxdBB37PNBl127g25owL-twRaSrBdF5quxzzDix4fEgo77Ik9x8IcUaI5AvpMW7Ig5O0n1SRE-ZfV7KssO0Imqq6bBZkEpzfgVC760tmSuqJ0W2on8eWzi36zuKru9qA5uo7L8w9I5rzqY7XEaak0PYFi5zB1BkpI83tN2bBP2jPsym9lMP4fbf-duHgu0s9H4mDeQFyb7OuI_P7AyH3V3qhUAvk37w-HNL-17g7OBYsZK5jMwa7LobO8Tw0ZdPk5u6dWKdmiWOUUScQVAqtaDjRIQ\" }",
 
-        // currently unsupported key type (EC)
+        // a key type (EC) that PS256 does not support
         "{ \"kty\": \"EC\", \"crv\": \"P-256\", "
         "\"x\": \"VoFkf6Wk5kDQ1ob6csBmiMPHU8jALwdtaap35Fsj20M\", "
         "\"y\": \"XymwN6u2PmsKbIPy5iij6qZ-mIyej5dvZWB_75lnRgQ\", "
@@ -317,6 +1276,18 @@ START_TEST(test_cjose_jws_import_export_compare)
             strncmp(JWS_COMMON, cser, strlen(JWS_COMMON)) == 0,
             "export of imported JWS doesn't match original");
 
+    // export into a buffer, after asking for its size
+    size_t len = 0;
+    ck_assert(cjose_jws_export_into(jws, NULL, 0, &len, &err));
+    ck_assert(len == strlen(JWS_COMMON));
+    char *buf = (char *)malloc(len);
+    ck_assert(!cjose_jws_export_into(jws, buf, len - 1, &len, &err));
+    ck_assert(err.code == CJOSE_ERR_INVALID_ARG);
+    ck_assert(len == strlen(JWS_COMMON));
+    ck_assert(cjose_jws_export_into(jws, buf, len, &len, &err));
+    ck_assert(memcmp(JWS_COMMON, buf, len) == 0);
+    free(buf);
+
     cjose_jwk_release(jwk);
     cjose_jws_release(jws);
 }
@@ -413,6 +1384,419 @@ START_TEST(test_cjose_jws_import_get_plain_after_verify)
 END_TEST
 
 
+START_TEST(test_cjose_jws_import_view)
+{
+    cjose_err err;
+
+    // import the common key
+    cjose_jwk_t *jwk = cjose_jwk_import(JWK_COMMON, strlen(JWK_COMMON), &err);
+    ck_assert_msg(NULL != jwk, "cjose_jwk_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    // import the (read-only) jws created with the common key
+    size_t len = strlen(JWS_COMMON);
+    cjose_jws_t *jws = cjose_jws_import_view(JWS_COMMON, len, &err);
+    ck_assert_msg(NULL != jws, "cjose_jws_import_view failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    // the encoded segments are not copied
+    ck_assert(jws->hdr_b64u == JWS_COMMON);
+    ck_assert(jws->dat_b64u == JWS_COMMON + jws->hdr_b64u_len + 1);
+    ck_assert(jws->sig_b64u + jws->sig_b64u_len == JWS_COMMON + len);
+
+    // verify the imported jws
+    ck_assert_msg(cjose_jws_verify(jws, jwk, &err), "cjose_jws_verify failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    // compare the verified plaintext to the expected value
+    uint8_t *plaintext = NULL;
+    size_t plaintext_len = 0;
+    ck_assert_msg(
+            cjose_jws_get_plaintext(jws, &plaintext, &plaintext_len, &err),
+            "cjose_jws_get_plaintext failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_msg(
+            plaintext_len == strlen(PLAIN_COMMON) &&
+            strncmp(PLAIN_COMMON, plaintext, plaintext_len) == 0,
+            "verified plaintext from JWS doesn't match the original");
+
+    // the re-export matches the original serialization
+    const char *cser = NULL;
+    ck_assert_msg(
+            cjose_jws_export(jws, &cser, &err),
+            "re-export of imported JWS failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_str_eq(JWS_COMMON, cser);
+
+    cjose_jws_release(jws);
+    cjose_jwk_release(jwk);
+}
+END_TEST
+
+
+START_TEST(test_cjose_jws_import_consume)
+{
+    cjose_err err;
+
+    // import the common key
+    cjose_jwk_t *jwk = cjose_jwk_import(JWK_COMMON, strlen(JWK_COMMON), &err);
+    ck_assert_msg(NULL != jwk, "cjose_jwk_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    // import a writable copy of the jws created with the common key
+    char *buf = strdup(JWS_COMMON);
+    cjose_jws_t *jws = cjose_jws_import_consume(buf, strlen(buf), &err);
+    ck_assert_msg(NULL != jws, "cjose_jws_import_consume failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    // verify the imported jws
+    ck_assert_msg(cjose_jws_verify(jws, jwk, &err), "cjose_jws_verify failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    // compare the verified plaintext to the expected value
+    uint8_t *plaintext = NULL;
+    size_t plaintext_len = 0;
+    ck_assert_msg(
+            cjose_jws_get_plaintext(jws, &plaintext, &plaintext_len, &err),
+            "cjose_jws_get_plaintext failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_msg(
+            plaintext_len == strlen(PLAIN_COMMON) &&
+            strncmp(PLAIN_COMMON, plaintext, plaintext_len) == 0,
+            "verified plaintext from JWS doesn't match the original");
+
+    // the re-export still matches the original serialization
+    const char *cser = NULL;
+    ck_assert_msg(
+            cjose_jws_export(jws, &cser, &err),
+            "re-export of imported JWS failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_str_eq(JWS_COMMON, cser);
+
+    cjose_jws_release(jws);
+    cjose_jwk_release(jwk);
+    free(buf);
+}
+END_TEST
+
+
+START_TEST(test_cjose_jws_import_lazy_plaintext)
+{
+    cjose_err err;
+
+    // import the jws created with the common key
+    cjose_jws_t *jws = cjose_jws_import(JWS_COMMON, strlen(JWS_COMMON), &err);
+    ck_assert_msg(NULL != jws, "cjose_jws_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    // the payload is not decoded on import
+    ck_assert(NULL == jws->dat);
+
+    // it is decoded on first request and the same buffer returned after
+    uint8_t *plaintext1 = NULL;
+    uint8_t *plaintext2 = NULL;
+    size_t plaintext_len = 0;
+    ck_assert_msg(
+            cjose_jws_get_plaintext(jws, &plaintext1, &plaintext_len, &err),
+            "cjose_jws_get_plaintext failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_msg(
+            plaintext_len == strlen(PLAIN_COMMON) &&
+            strncmp(PLAIN_COMMON, plaintext1, plaintext_len) == 0,
+            "plaintext from JWS doesn't match the original");
+    ck_assert_msg(
+            cjose_jws_get_plaintext(jws, &plaintext2, &plaintext_len, &err),
+            "cjose_jws_get_plaintext failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert(plaintext1 == plaintext2);
+    cjose_jws_release(jws);
+
+    // a payload that is not valid base64url is only rejected when requested
+    char *bad = strdup(JWS_COMMON);
+    char *dat = strchr(bad, '.') + 1;
+    dat[0] = '!';
+    jws = cjose_jws_import(bad, strlen(bad), &err);
+    ck_assert_msg(NULL != jws, "cjose_jws_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_msg(
+            !cjose_jws_get_plaintext(jws, &plaintext1, &plaintext_len, &err),
+            "cjose_jws_get_plaintext succeeded with bad payload");
+    cjose_jws_release(jws);
+    free(bad);
+}
+END_TEST
+
+
+START_TEST(test_cjose_jws_verify_compact)
+{
+    cjose_err err;
+
+    // the HS256 example of RFC 7515, appendix A.1
+    static const char *JWK_HS256 = 
+        "{ \"kty\": \"oct\", "
+        "\"k\": \"AyM1SysPpbyDfgZld3umj1qzKObwVMkoqQ-EstJQLr_T-1qS0gZH75aKtMN3Yj0iPS4hcgUuTwjAzZr1Z9CAow\" }";
+    static const char *JWS_HS256 = 
+        "eyJ0eXAiOiJKV1QiLA0KICJhbGciOiJIUzI1NiJ9."
+        "eyJpc3MiOiJqb2UiLA0KICJleHAiOjEzMDA4MTkzODAsDQogImh0dHA6Ly9leGFtcGxlLmNvbS9pc19yb290Ijp0cnVlfQ."
+        "dBjftJeZ4CVP-mB92K27uhbUJU1p1r_wW1gFWFOEjXk";
+    static const char *PLAIN_HS256 = 
+        "{\"iss\":\"joe\",\r\n \"exp\":1300819380,\r\n "
+        "\"http://example.com/is_root\":true}";
+
+    cjose_jwk_t *jwk = cjose_jwk_import(JWK_HS256, strlen(JWK_HS256), &err);
+    ck_assert_msg(NULL != jwk, "cjose_jwk_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+
+    // verify only, learning the size of the payload
+    size_t plain_len = 0;
+    ck_assert_msg(cjose_jws_verify_compact(JWS_HS256, strlen(JWS_HS256), 
+            jwk, NULL, &plain_len, &err), "cjose_jws_verify_compact failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_int_eq(strlen(PLAIN_HS256), plain_len);
+
+    // a buffer too small is rejected, and given the size needed
+    uint8_t plain[256];
+    size_t len = plain_len - 1;
+    ck_assert(!cjose_jws_verify_compact(JWS_HS256, strlen(JWS_HS256), 
+            jwk, plain, &len, &err));
+    ck_assert_int_eq(CJOSE_ERR_INVALID_ARG, err.code);
+    ck_assert_int_eq(plain_len, len);
+
+    // verify and decode the payload
+    len = sizeof(plain);
+    ck_assert_msg(cjose_jws_verify_compact(JWS_HS256, strlen(JWS_HS256), 
+            jwk, plain, &len, &err), "cjose_jws_verify_compact failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_msg(
+            len == strlen(PLAIN_HS256) &&
+            strncmp(PLAIN_HS256, plain, len) == 0,
+            "verified plaintext from JWS doesn't match the original");
+
+    // a tampered signature fails, and the payload is not decoded
+    char *bad = strdup(JWS_HS256);
+    bad[strlen(bad) - 2] = ('A' == bad[strlen(bad) - 2]) ? 'B' : 'A';
+    memset(plain, 0, sizeof(plain));
+    len = sizeof(plain);
+    ck_assert(!cjose_jws_verify_compact(bad, strlen(bad), 
+            jwk, plain, &len, &err));
+    ck_assert_int_eq(0, plain[0]);
+    free(bad);
+
+    // a serialization without both dots is rejected
+    len = sizeof(plain);
+    ck_assert(!cjose_jws_verify_compact(JWS_HS256, 40, 
+            jwk, plain, &len, &err));
+    ck_assert_int_eq(CJOSE_ERR_INVALID_ARG, err.code);
+
+    cjose_jwk_release(jwk);
+
+    // the common key and jws (PS256) verify the same way
+    jwk = cjose_jwk_import(JWK_COMMON, strlen(JWK_COMMON), &err);
+    ck_assert_msg(NULL != jwk, "cjose_jwk_import failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    len = sizeof(plain);
+    ck_assert_msg(cjose_jws_verify_compact(JWS_COMMON, strlen(JWS_COMMON), 
+            jwk, plain, &len, &err), "cjose_jws_verify_compact failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert_msg(
+            len == strlen(PLAIN_COMMON) &&
+            strncmp(PLAIN_COMMON, plain, len) == 0,
+            "verified plaintext from JWS doesn't match the original");
+
+    cjose_jwk_release(jwk);
+}
+END_TEST
+
+
+START_TEST(test_cjose_jws_verify_batch)
+{
+    cjose_err err;
+
+    // a batch that mixes algorithms, valid and invalid signatures, and a
+    // missing key
+    static const size_t N = 24;
+    cjose_jws_t *jws[24];
+    const cjose_jwk_t *keys[24];
+    bool results[24];
+    bool expected[24];
+    cjose_err errs[24];
+
+    cjose_jwk_t *rsa = cjose_jwk_import(JWK_COMMON, strlen(JWK_COMMON), &err);
+    ck_assert(NULL != rsa);
+    cjose_jwk_t *oct = cjose_jwk_create_oct_random(256, &err);
+    ck_assert(NULL != oct);
+    cjose_jwk_t *other = cjose_jwk_create_oct_random(256, &err);
+    ck_assert(NULL != other);
+
+    cjose_header_t *hdr = cjose_header_new(&err);
+    ck_assert(cjose_header_set(hdr, CJOSE_HDR_ALG, CJOSE_HDR_ALG_HS256, &err));
+    cjose_jws_t *signed_hs = cjose_jws_sign(
+            oct, hdr, PLAIN_COMMON, strlen(PLAIN_COMMON), &err);
+    ck_assert(NULL != signed_hs);
+    const char *cser_hs = NULL;
+    ck_assert(cjose_jws_export(signed_hs, &cser_hs, &err));
+
+    size_t threads[] = { 1, 3, 0 };
+    for (int t = 0; t < 3; ++t)
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            switch (i % 4)
+            {
+                case 0:
+                    jws[i] = cjose_jws_import(
+                            JWS_COMMON, strlen(JWS_COMMON), &err);
+                    keys[i] = rsa;
+                    expected[i] = true;
+                    break;
+                case 1:
+                    jws[i] = cjose_jws_import(
+                            cser_hs, strlen(cser_hs), &err);
+                    keys[i] = oct;
+                    expected[i] = true;
+                    break;
+                case 2:
+                    jws[i] = cjose_jws_import(
+                            cser_hs, strlen(cser_hs), &err);
+                    keys[i] = other;
+                    expected[i] = false;
+                    break;
+                case 3:
+                    jws[i] = cjose_jws_import(
+                            cser_hs, strlen(cser_hs), &err);
+                    keys[i] = NULL;
+                    expected[i] = false;
+                    break;
+            }
+            ck_assert(NULL != jws[i]);
+            results[i] = !expected[i];
+        }
+
+        cjose_jws_set_batch_threads(threads[t]);
+        ck_assert(!cjose_jws_verify_batch(jws, keys, N, results, errs));
+        for (size_t i = 0; i < N; ++i)
+        {
+            ck_assert_msg(results[i] == expected[i], 
+                    "wrong result for JWS %lu of batch", i);
+            if (!expected[i])
+            {
+                ck_assert(CJOSE_ERR_NONE != errs[i].code);
+            }
+        }
+
+        // the JWS objects are still the caller's, failed or not
+        for (size_t i = 0; i < N; ++i)
+        {
+            cjose_jws_release(jws[i]);
+        }
+    }
+    cjose_jws_set_batch_threads(0);
+
+    // an empty batch verifies
+    ck_assert(cjose_jws_verify_batch(NULL, NULL, 0, NULL, NULL));
+
+    cjose_jws_release(signed_hs);
+    cjose_header_release(hdr);
+    cjose_jwk_release(other);
+    cjose_jwk_release(oct);
+    cjose_jwk_release(rsa);
+}
+END_TEST
+
+
+START_TEST(test_cjose_jws_verify_cache)
+{
+    cjose_err err;
+    uint8_t key[CJOSE_CACHE_KEY_LEN];
+
+    ck_assert(cjose_jws_set_verify_cache(100, &err));
+    ck_assert(_cjose_cache_enabled());
+
+    cjose_jwk_t *jwk = cjose_jwk_import(JWK_COMMON, strlen(JWK_COMMON), &err);
+    ck_assert(NULL != jwk);
+
+    // a verified signature is cached for the key it verified with
+    cjose_jws_t *jws = cjose_jws_import(JWS_COMMON, strlen(JWS_COMMON), &err);
+    ck_assert(NULL != jws);
+    ck_assert_msg(cjose_jws_verify(jws, jwk, &err), "cjose_jws_verify failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    ck_assert(_cjose_cache_key(
+            jws->dig, jws->dig_len, jws->sig, jws->sig_len, key, &err));
+    ck_assert(_cjose_cache_lookup(key, jwk));
+    ck_assert(jwk->cached);
+    cjose_jws_release(jws);
+
+    // and a resent token verifies from the cache
+    jws = cjose_jws_import(JWS_COMMON, strlen(JWS_COMMON), &err);
+    ck_assert(NULL != jws);
+    ck_assert_msg(cjose_jws_verify(jws, jwk, &err), "cjose_jws_verify failed: "
+            "%s, file: %s, function: %s, line: %ld", 
+            err.message, err.file, err.function, err.line);
+    cjose_jws_release(jws);
+
+    // a changed signature is not found (and does not verify)
+    char *bad = strdup(JWS_COMMON);
+    char *last = bad + strlen(bad) - 2;
+    *last = ('A' == *last) ? 'B' : 'A';
+    jws = cjose_jws_import(bad, strlen(bad), &err);
+    ck_assert(NULL != jws);
+    ck_assert_msg(!cjose_jws_verify(jws, jwk, &err), 
+            "cjose_jws_verify succeeded with a changed signature");
+    free(bad);
+
+    // the entry is dropped when its key is released
+    const cjose_jwk_t *released = jwk;
+    cjose_jwk_release(jwk);
+    ck_assert(!_cjose_cache_lookup(key, released));
+
+    // the cache holds no more than its size (rounded up to whole sets)
+    size_t capacity = CJOSE_CACHE_SHARDS * CJOSE_CACHE_WAYS * 
+            (1 + (100 - 1) / (CJOSE_CACHE_SHARDS * CJOSE_CACHE_WAYS));
+    cjose_jwk_t *oct = cjose_jwk_create_oct_random(256, &err);
+    ck_assert(NULL != oct);
+    for (int i = 0; i < 1000; ++i)
+    {
+        ck_assert(_cjose_cache_key(
+                (const uint8_t *)&i, sizeof(i), NULL, 0, key, &err));
+        _cjose_cache_insert(key, oct);
+    }
+    size_t found = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        ck_assert(_cjose_cache_key(
+                (const uint8_t *)&i, sizeof(i), NULL, 0, key, &err));
+        found += _cjose_cache_lookup(key, oct) ? 1 : 0;
+    }
+    ck_assert_msg(0 < found && found <= capacity, 
+            "cache holds %lu entries, capacity %lu", found, capacity);
+    cjose_jwk_release(oct);
+
+    ck_assert(cjose_jws_set_verify_cache(0, &err));
+    ck_assert(!_cjose_cache_enabled());
+}
+END_TEST
+
+
 START_TEST(test_cjose_jws_verify_bad_params)
 {
     cjose_err err;
@@ -426,7 +1810,7 @@ START_TEST(test_cjose_jws_verify_bad_params)
         "\"n\": \"0a5nKJLjaB1xdebYWfhvlhYhgfzkw49HAUIjyvb6fNPKhwlBQMoAS5jM3kI17_OMGrHxL7ZP00OE-24__VWDCAhOQsSvlgCvw2XOOCtSWWLpb03dTrCMFeemqS4S9jrKd3NbUk3UJ2dVb_EIbQEC_BVjZStr_HcCrKsj4AluaQUn09H7TuK0yZFBzZMhJ1J8Yi3nAPkxzdGah0XuWhLObMAvANSVmHzRXwnTDw9Dh_bJ4G1xd1DE7W94uoUlcSDx59aSdzTpQzJh1l3lXc6JRUrXTESYgHpMv0O1n0gbIxX8X1ityBlMiccDjfZIKLnwz6hQObvRtRIpxEdq4SYS-w\", "
         "\"kid\": \"9ebf9edb-3a24-48b4-b2cb-21f0cf747ea7\" }",
 
-        // currently unsupported key type (EC)
+        // a key type (EC) that PS256 does not support
         "{ \"kty\": \"EC\", \"crv\": \"P-256\", "
         "\"x\": \"VoFkf6Wk5kDQ1ob6csBmiMPHU8jALwdtaap35Fsj20M\", "
         "\"y\": \"XymwN6u2PmsKbIPy5iij6qZ-mIyej5dvZWB_75lnRgQ\", "
@@ -486,6 +1870,16 @@ Suite *cjose_jws_suite()
     tcase_add_test(tc_jws, test_cjose_jws_self_sign_self_verify_short);
     tcase_add_test(tc_jws, test_cjose_jws_self_sign_self_verify_empty);
     tcase_add_test(tc_jws, test_cjose_jws_self_sign_self_verify_many);
+    tcase_add_test(tc_jws, test_cjose_jws_self_sign_self_verify_blocks);
+    tcase_add_test(tc_jws, test_cjose_jws_hmac_rfc7515);
+    tcase_add_test(tc_jws, test_cjose_jws_hmac_self_sign_self_verify);
+    tcase_add_test(tc_jws, test_cjose_jws_ecdsa_rfc7515);
+    tcase_add_test(tc_jws, test_cjose_jws_ecdsa_self_sign_self_verify);
+    tcase_add_test(tc_jws, test_cjose_jws_sign_with_template);
+    tcase_add_test(tc_jws, test_cjose_jws_sign_into);
+    tcase_add_test(tc_jws, test_cjose_jws_stream);
+    tcase_add_test(tc_jws, test_cjose_jws_unencoded);
+    tcase_add_test(tc_jws, test_cjose_jws_multi);
     tcase_add_test(tc_jws, test_cjose_jws_sign_with_bad_header);
     tcase_add_test(tc_jws, test_cjose_jws_sign_with_bad_key);
     tcase_add_test(tc_jws, test_cjose_jws_sign_with_bad_content);
@@ -493,7 +1887,13 @@ Suite *cjose_jws_suite()
     tcase_add_test(tc_jws, test_cjose_jws_import_invalid_serialization);
     tcase_add_test(tc_jws, test_cjose_jws_import_get_plain_before_verify);
     tcase_add_test(tc_jws, test_cjose_jws_import_get_plain_after_verify);
+    tcase_add_test(tc_jws, test_cjose_jws_import_view);
+    tcase_add_test(tc_jws, test_cjose_jws_import_consume);
+    tcase_add_test(tc_jws, test_cjose_jws_import_lazy_plaintext);
     tcase_add_test(tc_jws, test_cjose_jws_verify_bad_params);
+    tcase_add_test(tc_jws, test_cjose_jws_verify_compact);
+    tcase_add_test(tc_jws, test_cjose_jws_verify_batch);
+    tcase_add_test(tc_jws, test_cjose_jws_verify_cache);
     suite_add_tcase(suite, tc_jws);
 
     return suite;